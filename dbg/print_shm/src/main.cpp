@@ -26,6 +26,7 @@ void print_segments(const IpcSegmentInfo &seg)
 	std::cout << "Index:     " << seg.idx << std::endl;
 	std::cout << "Bot ID:    " << seg.bot_id << std::endl;
 	std::cout << "Is self:   " << seg.is_self << std::endl;
+	std::cout << "Bot slot:  " << seg.bot_slot << std::endl;
 	std::cout << std::endl;
 }
 
@@ -38,10 +38,13 @@ int main(void)
 	SHOW_OFFSET(IpcSharedMemory, segmentInfo);
 	SHOW_OFFSET(IpcSharedMemory, colorCount);
 	SHOW_OFFSET(IpcSharedMemory, colors);
-	SHOW_OFFSET(IpcSharedMemory, logData);
+	SHOW_OFFSET(IpcSharedMemory, logRing);
 	SHOW_OFFSET(IpcSharedMemory, faceID);
 	SHOW_OFFSET(IpcSharedMemory, dogTagID);
 	SHOW_OFFSET(IpcSharedMemory, persistentData);
+	SHOW_OFFSET(IpcSharedMemory, foodTable);
+	SHOW_OFFSET(IpcSharedMemory, botTableCount);
+	SHOW_OFFSET(IpcSharedMemory, botTable);
 
 	std::cout << "\n### IpcServerConfig ###\n" << std::endl;
 	std::cout << "Total Structure size: " << std::dec << sizeof(struct IpcServerConfig) << " byte.\n" << std::endl;
@@ -117,6 +120,7 @@ int main(void)
 	SHOW_OFFSET(IpcSegmentInfo, idx);
 	SHOW_OFFSET(IpcSegmentInfo, bot_id);
 	SHOW_OFFSET(IpcSegmentInfo, is_self);
+	SHOW_OFFSET(IpcSegmentInfo, bot_slot);
 
 	std::cout << "\n### IpcColor ###\n" << std::endl;
 	std::cout << "Total Structure size: " << std::dec << sizeof(struct IpcColor) << " byte.\n" << std::endl;
@@ -129,4 +133,27 @@ int main(void)
 	SHOW_OFFSET(IpcColor, r);
 	SHOW_OFFSET(IpcColor, g);
 	SHOW_OFFSET(IpcColor, b);
+
+	std::cout << "\n### IpcFoodTable ###\n" << std::endl;
+	std::cout << "Total Structure size: " << std::dec << sizeof(struct IpcFoodTable) << " byte.\n" << std::endl;
+
+	SHOW_OFFSET(IpcFoodTable, enabled);
+	SHOW_OFFSET(IpcFoodTable, world_size_x);
+	SHOW_OFFSET(IpcFoodTable, world_size_y);
+	SHOW_OFFSET(IpcFoodTable, head_x);
+	SHOW_OFFSET(IpcFoodTable, head_y);
+	SHOW_OFFSET(IpcFoodTable, heading);
+	SHOW_OFFSET(IpcFoodTable, slotCount);
+	SHOW_OFFSET(IpcFoodTable, changeCount);
+	SHOW_OFFSET(IpcFoodTable, changes);
+	SHOW_OFFSET(IpcFoodTable, slots);
+
+	std::cout << "\n### IpcFoodSlot ###\n" << std::endl;
+	std::cout << "Total Structure size: " << std::dec << sizeof(struct IpcFoodSlot) << " byte.\n" << std::endl;
+
+	SHOW_OFFSET(IpcFoodSlot, x);
+	SHOW_OFFSET(IpcFoodSlot, y);
+	SHOW_OFFSET(IpcFoodSlot, val);
+	SHOW_OFFSET(IpcFoodSlot, frame);
+	SHOW_OFFSET(IpcFoodSlot, valid);
 }
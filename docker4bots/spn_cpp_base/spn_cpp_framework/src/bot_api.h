@@ -1,6 +1,10 @@
 #pragma once
 
 #include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
 
 #include "ipc_format.h"
 
@@ -36,6 +40,7 @@ class Api
 			: angle(0)
 			, boost(false)
 			, m_shm(shm)
+			, m_useFoodTable(false)
 		{}
 
 		/*!
@@ -68,16 +73,92 @@ class Api
 		 *
 		 * The length of the list can be determined using getFoodCount().
 		 *
-		 * \returns    A pointer to the Food information in the shared memory.
+		 * If the food table is enabled (see enableFoodTable()), the list is
+		 * rebuilt from the table by the framework before each step.
+		 *
+		 * \returns    A pointer to the Food information.
 		 */
-		const IpcFoodInfo* getFood(void)      { return m_shm->foodInfo; }
+		const IpcFoodInfo* getFood(void)
+		{
+			return m_useFoodTable ? m_food.data() : m_shm->foodInfo;
+		}
 
 		/*!
 		 * \brief Get the length of the Food list.
 		 *
 		 * \returns    The length of the array returned by getFood().
 		 */
-		size_t             getFoodCount(void) { return m_shm->foodCount; }
+		size_t getFoodCount(void)
+		{
+			return m_useFoodTable ? m_food.size() : m_shm->foodCount;
+		}
+
+		/*!
+		 * \brief Switch to the incremental food table.
+		 *
+		 * Instead of the full Food list, the gameserver then only sends the
+		 * changes of the visible Food in world coordinates (see IpcFoodTable in
+		 * ipc_format.h). This saves a lot of work on both sides when many Food
+		 * items are in sight. getFood() and getFoodCount() keep working as
+		 * before.
+		 *
+		 * This must be called during your bot's initialization. It cannot be
+		 * changed afterwards.
+		 */
+		void enableFoodTable(void)
+		{
+			m_shm->foodTable.enabled = 1;
+			m_useFoodTable = true;
+		}
+
+		/*!
+		 * \brief Get a pointer to the food table.
+		 *
+		 * Only valid if enableFoodTable() was called. Use this if you want to
+		 * keep your own world model up to date using the change list.
+		 *
+		 * \returns    A pointer to the food table in the shared memory.
+		 */
+		const IpcFoodTable* getFoodTable(void) { return &(m_shm->foodTable); }
+
+		/*!
+		 * \brief Rebuild the Food list from the food table.
+		 *
+		 * This is called by the framework before each step. No need to call this
+		 * from the bot code.
+		 */
+		void updateFood(void)
+		{
+			if(!m_useFoodTable) {
+				return;
+			}
+
+			const IpcFoodTable &table = m_shm->foodTable;
+			uint32_t frame = m_shm->selfInfo.current_frame;
+			ipc_real_t decay = m_shm->serverConfig.food_decay_step;
+
+			m_food.clear();
+
+			for(uint32_t i = 0; (i < table.slotCount) && (i < IPC_FOOD_TABLE_MAX_COUNT); i++) {
+				const IpcFoodSlot &slot = table.slots[i];
+
+				if(!slot.valid) {
+					continue;
+				}
+
+				IpcFoodInfo info;
+				info.x = unwrap(slot.x - table.head_x, table.world_size_x);
+				info.y = unwrap(slot.y - table.head_y, table.world_size_y);
+				info.val = slot.val - decay * (frame - slot.frame);
+				info.dist = sqrtf(info.x*info.x + info.y*info.y);
+				info.dir = unwrap(atan2f(info.y, info.x) - table.heading, 2*M_PI);
+
+				m_food.push_back(info);
+			}
+
+			std::sort(m_food.begin(), m_food.end(),
+					[](const IpcFoodInfo &a, const IpcFoodInfo &b) { return a.dist < b.dist; });
+		}
 
 		/*!
 		 * \brief Get a pointer to the Segment list.
@@ -113,6 +194,40 @@ class Api
 		 */
 		size_t            getBotCount(void) { return m_shm->botCount; }
 
+		/*!
+		 * \brief Get a pointer to the Bot table.
+		 *
+		 * The table is indexed by IpcSegmentInfo::bot_slot, so the bot of a
+		 * segment can be looked up directly (see getSegmentBot()). Entries not
+		 * referenced by any segment in the current frame may be outdated.
+		 *
+		 * The length of the table can be determined using getBotTableCount().
+		 *
+		 * \returns    A pointer to the Bot table in the shared memory.
+		 */
+		const IpcBotInfo* getBotTable(void)      { return m_shm->botTable; }
+
+		/*!
+		 * \brief Get the length of the Bot table.
+		 *
+		 * \returns    The length of the array returned by getBotTable().
+		 */
+		size_t            getBotTableCount(void) { return m_shm->botTableCount; }
+
+		/*!
+		 * \brief Get the Bot information for a segment.
+		 *
+		 * \returns    A pointer to the Bot information or NULL if the bot is not listed.
+		 */
+		const IpcBotInfo* getSegmentBot(const IpcSegmentInfo *segment)
+		{
+			if(segment->bot_slot >= m_shm->botTableCount) {
+				return NULL;
+			}
+
+			return &(m_shm->botTable[segment->bot_slot]);
+		}
+
 		/*!
 		 * \brief Clear the color list.
 		 *
@@ -174,26 +289,48 @@ class Api
 		 * Rate limiting is enforced by the gameserver, so messages are dropped
 		 * when you send too many of them.
 		 *
+		 * Messages longer than IPC_LOG_MAX_MESSAGE_BYTES are truncated. If the
+		 * log ring buffer is full, the message is dropped.
+		 *
 		 * \param msg    Pointer to the null-terminated message string.
 		 */
 		void log(const char *msg)
 		{
-			size_t len = strlen(m_shm->logData);
+			IpcLogRing &ring = m_shm->logRing;
 
-			if(len >= IPC_COLOR_MAX_COUNT-2) {
-				return;
-			}
+			size_t len = strnlen(msg, IPC_LOG_MAX_MESSAGE_BYTES);
 
-			size_t n = IPC_LOG_MAX_BYTES - len - 1;
+			uint32_t head = ring.head;
+			uint32_t tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
 
-			if(len != 0) {
-				m_shm->logData[len] = '\n';
-				m_shm->logData[len+1] = '\0';
+			if(sizeof(uint16_t) + len > IPC_LOG_RING_BYTES - (head - tail)) {
+				return; // ring is full
 			}
 
-			strncat(m_shm->logData, msg, n);
+			uint16_t len16 = len;
+			writeLogRing(head, &len16, sizeof(len16));
+			writeLogRing(head + sizeof(len16), msg, len);
+
+			__atomic_store_n(&ring.head, head + sizeof(len16) + len, __ATOMIC_RELEASE);
 		}
 
 	private:
 		IpcSharedMemory *m_shm;
+
+		bool m_useFoodTable;
+		std::vector<IpcFoodInfo> m_food;
+
+		void writeLogRing(uint32_t pos, const void *src, size_t len)
+		{
+			size_t offset = pos % IPC_LOG_RING_BYTES;
+			size_t first = std::min(len, IPC_LOG_RING_BYTES - offset);
+
+			memcpy(m_shm->logRing.data + offset, src, first);
+			memcpy(m_shm->logRing.data, static_cast<const char*>(src) + first, len - first);
+		}
+
+		static ipc_real_t unwrap(ipc_real_t v, ipc_real_t size)
+		{
+			return v - size * roundf(v / size);
+		}
 };
@@ -93,6 +93,7 @@ struct ALIGNED IpcSegmentInfo {
 	uint32_t   idx;     //!< Segment number starting from head (idx == 0)
 	ipc_guid_t bot_id;  //!< Bot ID
 	bool       is_self; //!< True if this segment belongs to ones own snake
+	uint32_t   bot_slot; //!< Index of the bot in botTable (IPC_BOT_SLOT_NONE if not listed)
 };
 
 /*!
@@ -104,11 +105,44 @@ struct ALIGNED IpcColor {
 	uint8_t b; //!< Blue channel (0-255)
 };
 
+/*!
+ * IPC representation of a food particle in the food table (protocol version 2).
+ *
+ * In contrast to IpcFoodInfo, the position is given in world coordinates, so
+ * an entry stays valid as long as the food is visible.
+ */
+struct ALIGNED IpcFoodSlot {
+	ipc_real_t x;     //!< Absolute position X in world coordinates
+	ipc_real_t y;     //!< Absolute position Y in world coordinates
+	ipc_real_t val;   //!< Food value in frame `frame`. Decays by food_decay_step every frame.
+	uint32_t   frame; //!< Frame number in which `val` was written
+	uint32_t   valid; //!< Non-zero if this slot contains a visible food particle
+};
+
+/*!
+ * Type of a change in the food table.
+ */
+enum IpcFoodChangeType {
+	FOOD_SPAWNED   = 0, //!< Food became visible: it spawned or moved into your sight radius
+	FOOD_CONSUMED  = 1, //!< Food was eaten by any snake
+	FOOD_DECAYED   = 2, //!< Food decayed (or became too small to be seen)
+	FOOD_LEFT_VIEW = 3  //!< Food left your sight radius
+};
+
+/*!
+ * A change in the food table (protocol version 2).
+ */
+struct ALIGNED IpcFoodChange {
+	uint32_t slot; //!< Index of the changed slot in IpcFoodTable::slots
+	uint32_t type; //!< Type of the change (see IpcFoodChangeType)
+};
+
 const size_t IPC_FOOD_MAX_BYTES = 1 * 1024*1024;
 const size_t IPC_FOOD_MAX_COUNT = IPC_FOOD_MAX_BYTES / sizeof(struct IpcFoodInfo);
 
 const size_t IPC_BOT_MAX_COUNT = 1024;
 const size_t IPC_BOT_MAX_BYTES = IPC_BOT_MAX_COUNT * sizeof(struct IpcBotInfo);
+const uint32_t IPC_BOT_SLOT_NONE = 0xFFFFFFFF;
 
 const size_t IPC_SEGMENT_MAX_BYTES = 1 * 1024*1024;
 const size_t IPC_SEGMENT_MAX_COUNT = IPC_SEGMENT_MAX_BYTES / sizeof(struct IpcSegmentInfo);
@@ -116,10 +150,59 @@ const size_t IPC_SEGMENT_MAX_COUNT = IPC_SEGMENT_MAX_BYTES / sizeof(struct IpcSe
 const size_t IPC_COLOR_MAX_COUNT = 1024;
 const size_t IPC_COLOR_MAX_BYTES = IPC_COLOR_MAX_COUNT * sizeof(struct IpcColor);
 
-const size_t IPC_LOG_MAX_BYTES = 1024;
+const size_t IPC_LOG_RING_BYTES = 4096;        //!< Size of the log ring buffer (power of two)
+const size_t IPC_LOG_MAX_MESSAGE_BYTES = 1024; //!< Longer log messages are truncated by the framework
 
 const size_t IPC_PERSISTENT_MAX_BYTES = 4096; //!< Space for persistent data (in bytes)
 
+/*!
+ * Single-producer/single-consumer ring buffer for log messages.
+ *
+ * The bot appends records consisting of a 16-bit message length (native byte
+ * order) followed by the message bytes (no terminator). Records may wrap
+ * around the end of `data`. `head` and `tail` are free-running byte counters,
+ * so `head - tail` is the number of used bytes.
+ *
+ * Only the bot writes `head` (with release semantics after the record is
+ * complete) and only the gameserver writes `tail`. Messages are dropped if the
+ * ring is full.
+ */
+struct IpcLogRing {
+	uint32_t head;                  //!< Write position. Written by the bot only.
+	uint32_t tail;                  //!< Read position. Written by the gameserver only.
+	char data[IPC_LOG_RING_BYTES];  //!< Record storage
+};
+
+const size_t IPC_FOOD_TABLE_MAX_COUNT = IPC_FOOD_MAX_COUNT;
+const size_t IPC_FOOD_CHANGE_MAX_COUNT = 2 * IPC_FOOD_TABLE_MAX_COUNT; //!< Every slot can be freed and reused in one frame
+
+/*!
+ * Incremental food table (protocol version 2).
+ *
+ * Instead of rewriting the full list of visible food every frame, the
+ * gameserver keeps a persistent table of visible food in world coordinates.
+ * Only changes are written each frame and listed in `changes` (removals
+ * first, then new entries).
+ *
+ * The table is disabled by default. Set `enabled` to a non-zero value during
+ * init() to switch from foodInfo to the food table.
+ */
+struct IpcFoodTable {
+	uint32_t   enabled;      //!< Set by the bot during init() to use the food table.
+
+	ipc_real_t world_size_x; //!< Width of the (torus-shaped) world
+	ipc_real_t world_size_y; //!< Height of the (torus-shaped) world
+	ipc_real_t head_x;       //!< Absolute position X of your snake's head
+	ipc_real_t head_y;       //!< Absolute position Y of your snake's head
+	ipc_real_t heading;      //!< Heading of your snake in world orientation (radians)
+
+	uint32_t slotCount;   //!< Number of slots that may be in use (check IpcFoodSlot::valid).
+	uint32_t changeCount; //!< Number of items used in changes.
+
+	struct IpcFoodChange changes[IPC_FOOD_CHANGE_MAX_COUNT]; //!< Changes since the last frame.
+	struct IpcFoodSlot slots[IPC_FOOD_TABLE_MAX_COUNT];      //!< The food table.
+};
+
 /*!
  * Shared memory structure.
  *
@@ -143,12 +226,17 @@ struct IpcSharedMemory {
 	uint32_t colorCount;                         //!< Number of items used in colors.
 	struct IpcColor colors[IPC_COLOR_MAX_COUNT]; //!< Colors to set for this snake.
 
-	char logData[IPC_LOG_MAX_BYTES]; //!< Log data for the current frame. May contain multiple lines.
+	struct IpcLogRing logRing; //!< Log messages sent by the bot.
 
 	uint32_t faceID;   //!< Select a face for your snake (not used yet).
 	uint32_t dogTagID; //!< Select a dog tag for your snake (not used yet).
 
 	uint8_t persistentData[IPC_PERSISTENT_MAX_BYTES]; //!< Persistent data: will be saved after your snake dies and restored when it respawns
+
+	struct IpcFoodTable foodTable; //!< Incremental food table (protocol version 2, opt-in).
+
+	uint32_t botTableCount;                        //!< Number of slots used in botTable.
+	struct IpcBotInfo botTable[IPC_BOT_MAX_COUNT]; //!< Bot table indexed by IpcSegmentInfo::bot_slot. Contains all bots related to segments in segmentInfo; other entries may be outdated.
 };
 
 const size_t IPC_SHARED_MEMORY_BYTES = sizeof(struct IpcSharedMemory);
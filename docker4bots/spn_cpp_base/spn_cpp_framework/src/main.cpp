@@ -101,6 +101,7 @@ int mainloop(struct IpcSharedMemory *shm, int sock_fd)
 				break;
 
 			case REQ_STEP:
+				api.updateFood();
 				result = step(&api);
 				break;
 
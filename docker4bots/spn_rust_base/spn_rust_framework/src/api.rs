@@ -5,6 +5,7 @@ extern crate memmap2;
 use std::fs::OpenOptions;
 use std::mem::{size_of, transmute};
 use std::result::Result;
+use std::sync::atomic::Ordering;
 
 use memmap2::MmapRaw;
 
@@ -25,6 +26,22 @@ pub struct Api<'a> {
     #[allow(dead_code)]
     mmap: MmapRaw,
     ipcdata: &'a mut IpcSharedMemory,
+    use_food_table: bool,
+    food: Vec<ipc::IpcFoodInfo>,
+}
+
+/// Copy data into the log ring at the given (free-running) position, wrapping at the end.
+fn write_log_ring(data: &mut [u8; ipc::IPC_LOG_RING_BYTES], pos: u32, src: &[u8]) {
+    let offset = pos as usize % ipc::IPC_LOG_RING_BYTES;
+    let first = src.len().min(ipc::IPC_LOG_RING_BYTES - offset);
+
+    data[offset..offset + first].copy_from_slice(&src[..first]);
+    data[..src.len() - first].copy_from_slice(&src[first..]);
+}
+
+/// Unwrap a coordinate difference on the torus (or an angle with size = 2π).
+fn unwrap(v: f32, size: f32) -> f32 {
+    v - size * (v / size).round()
 }
 
 impl<'i> Api<'i> {
@@ -58,7 +75,12 @@ impl<'i> Api<'i> {
         let ipcdata =
             unsafe { &mut *transmute::<*mut u8, *mut ipc::IpcSharedMemory>(mmap.as_mut_ptr()) };
 
-        Ok(Api { mmap, ipcdata })
+        Ok(Api {
+            mmap,
+            ipcdata,
+            use_food_table: false,
+            food: Vec::new(),
+        })
     }
 
     /**
@@ -87,10 +109,74 @@ impl<'i> Api<'i> {
      * The items are sorted by the distance from your snake’s head, so the first entry is the
      * closest item.
      *
-     * Only the valid entries in the shared memory are returned.
+     * Only the valid entries in the shared memory are returned. If the food table is enabled (see
+     * [`Api::enable_food_table()`]), the list is rebuilt from the table by the framework before
+     * each step.
      */
     pub fn get_food(&self) -> &[ipc::IpcFoodInfo] {
-        &self.ipcdata.food_info[0..self.ipcdata.food_count as usize]
+        if self.use_food_table {
+            &self.food
+        } else {
+            &self.ipcdata.food_info[0..self.ipcdata.food_count as usize]
+        }
+    }
+
+    /**
+     * Switch to the incremental food table.
+     *
+     * Instead of the full food list, the gameserver then only sends the changes of the visible
+     * food in world coordinates (see [`ipc::IpcFoodTable`]). This saves a lot of work on both
+     * sides when many food items are in sight. [`Api::get_food()`] keeps working as before.
+     *
+     * This must be called in your [`crate::usercode::init()`] function. It cannot be changed
+     * afterwards.
+     */
+    pub fn enable_food_table(&mut self) {
+        self.ipcdata.food_table.enabled = 1;
+        self.use_food_table = true;
+    }
+
+    /**
+     * Get a reference to the food table.
+     *
+     * Only valid if [`Api::enable_food_table()`] was called. Use this if you want to keep your own
+     * world model up to date using the change list.
+     */
+    pub fn get_food_table(&self) -> &ipc::IpcFoodTable {
+        &self.ipcdata.food_table
+    }
+
+    /**
+     * Rebuild the food list from the food table.
+     *
+     * This function is used internally by the bot framework. Do not worry about it.
+     */
+    pub fn update_food(&mut self) {
+        if !self.use_food_table {
+            return;
+        }
+
+        let table = &self.ipcdata.food_table;
+        let frame = self.ipcdata.self_info.current_frame;
+        let decay = self.ipcdata.server_config.food_decay_step;
+        let count = std::cmp::min(table.slot_count as usize, ipc::IPC_FOOD_TABLE_MAX_COUNT);
+
+        self.food.clear();
+
+        for slot in table.slots[0..count].iter().filter(|s| s.valid != 0) {
+            let x = unwrap(slot.x - table.head_x, table.world_size_x);
+            let y = unwrap(slot.y - table.head_y, table.world_size_y);
+
+            self.food.push(ipc::IpcFoodInfo {
+                x,
+                y,
+                val: slot.val - decay * frame.wrapping_sub(slot.frame) as f32,
+                dir: unwrap(y.atan2(x) - table.heading, 2.0 * std::f32::consts::PI),
+                dist: (x * x + y * y).sqrt(),
+            });
+        }
+
+        self.food.sort_by(|a, b| a.dist.total_cmp(&b.dist));
     }
 
     /**
@@ -114,6 +200,26 @@ impl<'i> Api<'i> {
         &self.ipcdata.bot_info[0..self.ipcdata.bot_count as usize]
     }
 
+    /**
+     * Get a reference to the bot table.
+     *
+     * Only the valid entries in the shared memory are returned. The array is indexed by
+     * [`ipc::IpcSegmentInfo::bot_slot`]. Entries not referenced by any segment in the current
+     * frame may be outdated.
+     */
+    pub fn get_bot_table(&self) -> &[ipc::IpcBotInfo] {
+        &self.ipcdata.bot_table[0..self.ipcdata.bot_table_count as usize]
+    }
+
+    /**
+     * Get the bot information for a segment.
+     *
+     * Returns None if the bot is not listed in the bot table.
+     */
+    pub fn get_segment_bot(&self, segment: &ipc::IpcSegmentInfo) -> Option<&ipc::IpcBotInfo> {
+        self.get_bot_table().get(segment.bot_slot as usize)
+    }
+
     /**
      * Remove all color entries from the shared memory.
      *
@@ -158,23 +264,30 @@ impl<'i> Api<'i> {
      *
      * Rate limiting is enforced by the gameserver, so messages are dropped
      * when you send too many of them.
+     *
+     * Messages longer than [`ipc::IPC_LOG_MAX_MESSAGE_BYTES`] are truncated. If the log ring
+     * buffer is full, an error is returned and the message is dropped.
      */
     pub fn log(&mut self, text: &str) -> Result<(), String> {
-        // determine length of stored data
-        let startpos = self
-            .ipcdata
-            .log_data
-            .iter()
-            .position(|&b| b == b'\0')
-            .ok_or_else(|| "Log memory is not properly initialized or corrupt".to_string())?;
-
-        if startpos + text.len() + 2 > self.ipcdata.log_data.len() {
-            return Err("Log memory too full to append the log message".to_owned());
+        let ring = &mut self.ipcdata.log_ring;
+        let bytes = &text.as_bytes()[..text.len().min(ipc::IPC_LOG_MAX_MESSAGE_BYTES)];
+
+        let head = ring.head.load(Ordering::Relaxed);
+        let tail = ring.tail.load(Ordering::Acquire);
+        let free = ipc::IPC_LOG_RING_BYTES.saturating_sub(head.wrapping_sub(tail) as usize);
+
+        if size_of::<u16>() + bytes.len() > free {
+            return Err("Log ring buffer is full, message dropped".to_owned());
         }
 
-        self.ipcdata.log_data[startpos..startpos + text.len()].copy_from_slice(text.as_bytes());
-        self.ipcdata.log_data[startpos + text.len()] = b'\n';
-        self.ipcdata.log_data[startpos + text.len() + 1] = b'\0';
+        let len = (bytes.len() as u16).to_ne_bytes();
+        write_log_ring(&mut ring.data, head, &len);
+        write_log_ring(&mut ring.data, head.wrapping_add(len.len() as u32), bytes);
+
+        ring.head.store(
+            head.wrapping_add((len.len() + bytes.len()) as u32),
+            Ordering::Release,
+        );
 
         Ok(())
     }
@@ -1,6 +1,7 @@
 // vim: noet
 
 use std::mem::size_of;
+use std::sync::atomic::AtomicU32;
 
 type IpcReal = f32;
 type IpcGuid = u64;
@@ -135,6 +136,8 @@ pub struct IpcSegmentInfo {
     pub bot_id: IpcGuid,
     /// True if this segment belongs to ones own snake
     pub is_self: bool,
+    /// Index of the bot in bot_table ([`IPC_BOT_SLOT_NONE`] if not listed)
+    pub bot_slot: u32,
 }
 
 /**
@@ -151,11 +154,62 @@ pub struct IpcColor {
     pub b: u8,
 }
 
+/**
+ * IPC representation of a food particle in the food table (protocol version 2).
+ *
+ * In contrast to [`IpcFoodInfo`], the position is given in world coordinates, so an entry stays
+ * valid as long as the food is visible.
+ */
+#[repr(C)]
+#[repr(align(4))]
+pub struct IpcFoodSlot {
+    /// Absolute position X in world coordinates
+    pub x: IpcReal,
+    /// Absolute position Y in world coordinates
+    pub y: IpcReal,
+    /// Food value in frame `frame`. Decays by food_decay_step every frame.
+    pub val: IpcReal,
+    /// Frame number in which `val` was written
+    pub frame: u32,
+    /// Non-zero if this slot contains a visible food particle
+    pub valid: u32,
+}
+
+/**
+ * Type of a change in the food table.
+ */
+#[repr(C)]
+#[repr(align(4))]
+#[derive(FromPrimitive, ToPrimitive)]
+pub enum IpcFoodChangeType {
+    /// Food became visible: it spawned or moved into your sight radius
+    Spawned = 0,
+    /// Food was eaten by any snake
+    Consumed = 1,
+    /// Food decayed (or became too small to be seen)
+    Decayed = 2,
+    /// Food left your sight radius
+    LeftView = 3,
+}
+
+/**
+ * A change in the food table (protocol version 2).
+ */
+#[repr(C)]
+#[repr(align(4))]
+pub struct IpcFoodChange {
+    /// Index of the changed slot in [`IpcFoodTable::slots`]
+    pub slot: u32,
+    /// Type of the change (see [`IpcFoodChangeType`])
+    pub change_type: u32,
+}
+
 pub const IPC_FOOD_MAX_BYTES: usize = 1024 * 1024;
 pub const IPC_FOOD_MAX_COUNT: usize = IPC_FOOD_MAX_BYTES / size_of::<IpcFoodInfo>();
 
 pub const IPC_BOT_MAX_COUNT: usize = 1024;
 pub const IPC_BOT_MAX_BYTES: usize = IPC_BOT_MAX_COUNT * size_of::<IpcBotInfo>();
+pub const IPC_BOT_SLOT_NONE: u32 = 0xFFFFFFFF;
 
 pub const IPC_SEGMENT_MAX_BYTES: usize = 1024 * 1024;
 pub const IPC_SEGMENT_MAX_COUNT: usize = IPC_SEGMENT_MAX_BYTES / size_of::<IpcSegmentInfo>();
@@ -163,11 +217,77 @@ pub const IPC_SEGMENT_MAX_COUNT: usize = IPC_SEGMENT_MAX_BYTES / size_of::<IpcSe
 pub const IPC_COLOR_MAX_COUNT: usize = 1024;
 pub const IPC_COLOR_MAX_BYTES: usize = IPC_COLOR_MAX_COUNT * size_of::<IpcColor>();
 
-pub const IPC_LOG_MAX_BYTES: usize = 1024;
+/// Size of the log ring buffer (power of two)
+pub const IPC_LOG_RING_BYTES: usize = 4096;
+/// Longer log messages are truncated by the framework
+pub const IPC_LOG_MAX_MESSAGE_BYTES: usize = 1024;
 
 /// Space for persistent data (in bytes)
 pub const IPC_PERSISTENT_MAX_BYTES: usize = 4096;
 
+/**
+ * Single-producer/single-consumer ring buffer for log messages.
+ *
+ * The bot appends records consisting of a 16-bit message length (native byte order) followed by
+ * the message bytes (no terminator). Records may wrap around the end of `data`. `head` and `tail`
+ * are free-running byte counters, so `head - tail` is the number of used bytes.
+ *
+ * Only the bot writes `head` (with release semantics after the record is complete) and only the
+ * gameserver writes `tail`. Messages are dropped if the ring is full.
+ */
+#[repr(C)]
+#[repr(align(4))]
+pub struct IpcLogRing {
+    /// Write position. Written by the bot only.
+    pub head: AtomicU32,
+    /// Read position. Written by the gameserver only.
+    pub tail: AtomicU32,
+    /// Record storage
+    pub data: [u8; IPC_LOG_RING_BYTES],
+}
+
+pub const IPC_FOOD_TABLE_MAX_COUNT: usize = IPC_FOOD_MAX_COUNT;
+/// Every slot can be freed and reused in one frame
+pub const IPC_FOOD_CHANGE_MAX_COUNT: usize = 2 * IPC_FOOD_TABLE_MAX_COUNT;
+
+/**
+ * Incremental food table (protocol version 2).
+ *
+ * Instead of rewriting the full list of visible food every frame, the gameserver keeps a
+ * persistent table of visible food in world coordinates. Only changes are written each frame and
+ * listed in `changes` (removals first, then new entries).
+ *
+ * The table is disabled by default. Set `enabled` to a non-zero value during init() to switch
+ * from food_info to the food table.
+ */
+#[repr(C)]
+#[repr(align(4))]
+pub struct IpcFoodTable {
+    /// Set by the bot during init() to use the food table.
+    pub enabled: u32,
+
+    /// Width of the (torus-shaped) world
+    pub world_size_x: IpcReal,
+    /// Height of the (torus-shaped) world
+    pub world_size_y: IpcReal,
+    /// Absolute position X of your snake's head
+    pub head_x: IpcReal,
+    /// Absolute position Y of your snake's head
+    pub head_y: IpcReal,
+    /// Heading of your snake in world orientation (radians)
+    pub heading: IpcReal,
+
+    /// Number of slots that may be in use (check IpcFoodSlot::valid).
+    pub slot_count: u32,
+    /// Number of items used in changes.
+    pub change_count: u32,
+
+    /// Changes since the last frame.
+    pub changes: [IpcFoodChange; IPC_FOOD_CHANGE_MAX_COUNT],
+    /// The food table.
+    pub slots: [IpcFoodSlot; IPC_FOOD_TABLE_MAX_COUNT],
+}
+
 /**
  * Shared memory structure.
  *
@@ -203,8 +323,8 @@ pub struct IpcSharedMemory {
     /// Colors to set for this snake.
     pub colors: [IpcColor; IPC_COLOR_MAX_COUNT],
 
-    /// Log data for the current frame. May contain multiple lines.
-    pub log_data: [u8; IPC_LOG_MAX_BYTES],
+    /// Log messages sent by the bot.
+    pub log_ring: IpcLogRing,
 
     /// Select a face for your snake (not used yet).
     pub face_id: u32,
@@ -213,6 +333,15 @@ pub struct IpcSharedMemory {
 
     /// Persistent data: will be saved after your snake dies and restored when it respawns
     pub persistent_data: [u8; IPC_PERSISTENT_MAX_BYTES],
+
+    /// Incremental food table (protocol version 2, opt-in).
+    pub food_table: IpcFoodTable,
+
+    /// Number of slots used in bot_table.
+    pub bot_table_count: u32,
+    /// Bot table indexed by IpcSegmentInfo::bot_slot. Contains all bots related to segments in
+    /// segment_info; other entries may be outdated.
+    pub bot_table: [IpcBotInfo; IPC_BOT_MAX_COUNT],
 }
 
 pub const IPC_SHARED_MEMORY_BYTES: usize = size_of::<IpcSharedMemory>();
@@ -83,6 +83,8 @@ fn mainloop(mut api: api::Api, socket: UnixSeqpacketConn) -> Result<(), String>
                 boost = false;
             }
             IpcRequestType::Step => {
+                api.update_food();
+
                 // unfortunately, destructuring is not stable yet.
                 let (tmp_running, tmp_angle, tmp_boost) = step(&mut api);
                 running = tmp_running;
@@ -0,0 +1,233 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "Bot.h"
+
+#include "AggregatingUpdateTracker.h"
+
+/* Private methods */
+
+bool AggregatingUpdateTracker::removeSpawnedFood(const Food &food)
+{
+	auto it = m_spawnedFoodIndex.find(food.getGUID());
+	if(it == m_spawnedFoodIndex.end()) {
+		return false;
+	}
+
+	m_spawnedFood[it->second].removed = true;
+	m_spawnedFoodIndex.erase(it);
+	return true;
+}
+
+/* Public methods */
+
+void AggregatingUpdateTracker::foodConsumed(const Food &food,
+		const std::shared_ptr<Bot> &by_bot)
+{
+	if(!removeSpawnedFood(food)) {
+		m_consumedFood.emplace_back(food, by_bot);
+	}
+}
+
+void AggregatingUpdateTracker::foodDecayed(const Food &food)
+{
+	if(!removeSpawnedFood(food)) {
+		m_decayedFood.push_back(food);
+	}
+}
+
+void AggregatingUpdateTracker::foodSpawned(const Food &food)
+{
+	m_spawnedFoodIndex[food.getGUID()] = m_spawnedFood.size();
+	m_spawnedFood.push_back({food, false});
+}
+
+void AggregatingUpdateTracker::botSpawned(const std::shared_ptr<Bot> &bot)
+{
+	m_spawnedBots.push_back(bot);
+}
+
+void AggregatingUpdateTracker::botKilled(const std::shared_ptr<Bot> &killer,
+		const std::shared_ptr<Bot> &victim)
+{
+	auto spawned = std::find(m_spawnedBots.begin(), m_spawnedBots.end(), victim);
+	if(spawned != m_spawnedBots.end()) {
+		// the viewer never saw this bot
+		m_spawnedBots.erase(spawned);
+	} else {
+		m_kills.push_back({killer, victim});
+	}
+
+	auto move = m_moveIndex.find(victim->getGUID());
+	if(move != m_moveIndex.end()) {
+		m_moves[move->second].bot.reset();
+		m_moveIndex.erase(move);
+	}
+
+	auto stats = m_statsIndex.find(victim->getGUID());
+	if(stats != m_statsIndex.end()) {
+		m_stats[stats->second].reset();
+		m_statsIndex.erase(stats);
+	}
+}
+
+void AggregatingUpdateTracker::botMoved(const std::shared_ptr<Bot> &bot, std::size_t)
+{
+	const Snake::PositionList &headPositions = bot->getSnake()->getHeadPositionsDuringLastMove();
+
+	auto it = m_moveIndex.find(bot->getGUID());
+	if(it == m_moveIndex.end()) {
+		it = m_moveIndex.emplace(bot->getGUID(), m_moves.size()).first;
+		m_moves.push_back({bot, Snake::PositionList()});
+	}
+
+	Snake::PositionList &merged = m_moves[it->second].headPositions;
+	merged.insert(merged.end(), headPositions.begin(), headPositions.end());
+}
+
+void AggregatingUpdateTracker::botLogMessage(uint64_t viewerKey, const std::string &message)
+{
+	m_output.botLogMessage(viewerKey, message);
+}
+
+void AggregatingUpdateTracker::botLogMessage(uint64_t viewerKey, const char *message, std::size_t length)
+{
+	m_output.botLogMessage(viewerKey, message, length);
+}
+
+void AggregatingUpdateTracker::worldState(Field &field)
+{
+	m_output.worldState(field);
+}
+
+void AggregatingUpdateTracker::worldState(const WorldSnapshot &snapshot)
+{
+	m_output.worldState(snapshot);
+}
+
+void AggregatingUpdateTracker::tick(uint64_t frame_id)
+{
+	m_hasTick = true;
+	m_lastTick = frame_id;
+}
+
+void AggregatingUpdateTracker::botStats(const std::shared_ptr<Bot> &bot)
+{
+	// the statistics are read when serializing, so one entry per bot suffices
+	if(m_statsIndex.find(bot->getGUID()) == m_statsIndex.end()) {
+		m_statsIndex[bot->getGUID()] = m_stats.size();
+		m_stats.push_back(bot);
+	}
+}
+
+UpdateTracker::FrameSet AggregatingUpdateTracker::serialize(void)
+{
+	for(auto &bot: m_spawnedBots) {
+		// sent with its current state, which includes all moves so far
+		m_output.botSpawned(bot);
+	}
+
+	for(auto &kill: m_kills) {
+		m_output.botKilled(kill.killer, kill.victim);
+	}
+
+	if(m_hasTick) {
+		m_output.tick(m_lastTick);
+	}
+
+	for(auto &food: m_decayedFood) {
+		m_output.foodDecayed(food);
+	}
+
+	for(auto &spawned: m_spawnedFood) {
+		if(!spawned.removed) {
+			m_output.foodSpawned(spawned.food);
+		}
+	}
+
+	for(auto &consumed: m_consumedFood) {
+		m_output.foodConsumed(consumed.first, consumed.second);
+	}
+
+	for(auto &move: m_moves) {
+		if(!move.bot || (std::find(m_spawnedBots.begin(), m_spawnedBots.end(), move.bot) != m_spawnedBots.end())) {
+			continue;
+		}
+
+		// every move transmits the whole snake, so the current one replaces the earlier ones
+		std::size_t steps = move.bot->getSnake()->getSegments().size();
+		m_output.botMoved(move.bot, steps, move.headPositions);
+	}
+
+	for(auto &bot: m_stats) {
+		if(bot) {
+			m_output.botStats(bot);
+		}
+	}
+
+	FrameSet frames = m_output.serialize();
+	reset();
+	return frames;
+}
+
+void AggregatingUpdateTracker::reset(void)
+{
+	m_output.reset();
+
+	m_spawnedFood.clear();
+	m_spawnedFoodIndex.clear();
+	m_consumedFood.clear();
+	m_decayedFood.clear();
+
+	m_spawnedBots.clear();
+	m_kills.clear();
+
+	m_moves.clear();
+	m_moveIndex.clear();
+
+	m_stats.clear();
+	m_statsIndex.clear();
+
+	m_hasTick = false;
+}
+
+void AggregatingUpdateTracker::beginParallelEvents(std::size_t workerCount)
+{
+	m_parallelEvents.begin(workerCount);
+}
+
+void AggregatingUpdateTracker::botMovedParallel(std::size_t worker,
+		const std::shared_ptr<Bot> &bot, std::size_t steps)
+{
+	m_parallelEvents.botMoved(worker, bot, steps);
+}
+
+void AggregatingUpdateTracker::foodConsumedParallel(std::size_t worker,
+		const Food &food, const std::shared_ptr<Bot> &by_bot)
+{
+	m_parallelEvents.foodConsumed(worker, food, by_bot);
+}
+
+void AggregatingUpdateTracker::endParallelEvents(void)
+{
+	m_parallelEvents.merge();
+	m_parallelEvents.replay(*this);
+}
@@ -0,0 +1,142 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+#include "Food.h"
+#include "MsgPackUpdateTracker.h"
+#include "Snake.h"
+#include "UpdateEventBuffer.h"
+
+/*!
+ * \brief UpdateTracker that merges the events of several frames into one
+ * update.
+ *
+ * \details
+ * Events are collected until serialize() is called and merged on the way:
+ *
+ * - Food that spawned and was consumed or decayed in the meantime is not
+ *   sent at all.
+ * - Bots that spawned in the meantime are sent with their current state,
+ *   without further moves. Bots that spawned and were killed are not sent.
+ * - All moves of a bot become one move with the current segments and the
+ *   concatenated head positions.
+ * - Only the latest statistics of each bot and the latest tick are sent.
+ *
+ * The merged events are serialized by an internal MsgPackUpdateTracker, so
+ * the result is a regular frame in all UpdateTracker::Stream formats.
+ *
+ * Events from parallel jobs are buffered per worker and merged by
+ * endParallelEvents().
+ */
+class AggregatingUpdateTracker : public UpdateTracker
+{
+	private:
+		struct SpawnedFood {
+			Food food;
+			bool removed; //!< Consumed or decayed before it was sent
+		};
+
+		struct MergedMove {
+			std::shared_ptr<Bot> bot;
+			Snake::PositionList  headPositions;
+		};
+
+		struct Kill {
+			std::shared_ptr<Bot> killer;
+			std::shared_ptr<Bot> victim;
+		};
+
+		MsgPackUpdateTracker m_output;
+
+		std::vector<SpawnedFood> m_spawnedFood;
+		std::unordered_map<guid_t, std::size_t> m_spawnedFoodIndex;
+		std::vector<std::pair<Food, std::shared_ptr<Bot>>> m_consumedFood;
+		std::vector<Food> m_decayedFood;
+
+		std::vector<std::shared_ptr<Bot>> m_spawnedBots;
+		std::vector<Kill> m_kills;
+
+		std::vector<MergedMove> m_moves;
+		std::unordered_map<guid_t, std::size_t> m_moveIndex;
+
+		std::vector<std::shared_ptr<Bot>> m_stats;
+		std::unordered_map<guid_t, std::size_t> m_statsIndex;
+
+		bool     m_hasTick = false;
+		uint64_t m_lastTick = 0;
+
+		UpdateEventBuffer m_parallelEvents;
+
+		/*!
+		 * Remove food that was spawned since the last update.
+		 *
+		 * \returns   Whether the food was found, i.e. the viewer never saw it.
+		 */
+		bool removeSpawnedFood(const Food &food);
+
+	public:
+		void foodConsumed(
+				const Food &food,
+				const std::shared_ptr<Bot> &by_bot) override;
+
+		void foodDecayed(const Food &food) override;
+
+		void foodSpawned(const Food &food) override;
+
+		void botSpawned(const std::shared_ptr<Bot> &bot) override;
+
+		void botKilled(
+				const std::shared_ptr<Bot> &killer,
+				const std::shared_ptr<Bot> &victim) override;
+
+		void botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps) override;
+
+		void botLogMessage(uint64_t viewerKey, const std::string &message) override;
+		void botLogMessage(uint64_t viewerKey, const char *message, std::size_t length) override;
+
+		void worldState(Field &field) override;
+		void worldState(const WorldSnapshot &snapshot) override;
+
+		void tick(uint64_t frame_id) override;
+
+		void botStats(const std::shared_ptr<Bot> &bot) override;
+
+		FrameSet serialize(void) override;
+
+		const LogFrameList& getLogFrames(void) const override { return m_output.getLogFrames(); }
+
+		void reset(void) override;
+
+		void beginParallelEvents(std::size_t workerCount) override;
+
+		void botMovedParallel(std::size_t worker,
+				const std::shared_ptr<Bot> &bot, std::size_t steps) override;
+
+		void foodConsumedParallel(std::size_t worker,
+				const Food &food, const std::shared_ptr<Bot> &by_bot) override;
+
+		void endParallelEvents(void) override;
+};
@@ -0,0 +1,267 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "Bot.h"
+#include "Field.h"
+#include "Food.h"
+
+#include "config.h"
+
+#include "AreaOfInterest.h"
+
+void AreaOfInterest::setArea(const Vector2D &topLeft, const Vector2D &size)
+{
+	m_followBot = false;
+	m_topLeft = topLeft;
+
+	// larger areas would contain tiles twice
+	m_size = size.cwiseMin(Vector2D(config::FIELD_SIZE_X, config::FIELD_SIZE_Y)).cwiseMax(Vector2D(0, 0));
+}
+
+void AreaOfInterest::setFollowedBot(uint32_t botId, const Vector2D &size)
+{
+	setArea(m_topLeft, size);
+
+	m_followBot = true;
+	m_followedBotId = botId;
+}
+
+void AreaOfInterest::reset(void)
+{
+	m_initialized = false;
+	m_visibleBots.clear();
+	m_visibleFood.clear();
+}
+
+void AreaOfInterest::trackMoves(void)
+{
+	for(auto &visibleBot: m_visibleBots) {
+		std::shared_ptr<Bot> bot = visibleBot.bot.lock();
+		if(!bot) {
+			continue;
+		}
+
+		const Snake::PositionList &headPositions = bot->getSnake()->getHeadPositionsDuringLastMove();
+		visibleBot.headPositions.insert(visibleBot.headPositions.end(), headPositions.begin(), headPositions.end());
+	}
+}
+
+void AreaOfInterest::collectCurrent(Field &field)
+{
+	const Field::BotSet &bots = field.getBots();
+
+	if(m_followBot) {
+		for(auto &bot: bots) {
+			if(static_cast<uint32_t>(bot->getGUID()) == m_followedBotId) {
+				m_topLeft = bot->getSnake()->getHeadPosition() - m_size / 2;
+				break;
+			}
+		}
+	}
+
+	// The segment map is rebuilt at the end of Field::moveAllBots(), after
+	// this frame's moves and kills, and no phase before SendUpdate moves or
+	// kills bots, so it matches the current state. Bots started by the Limbo
+	// phase are not in it yet and enter the area with the next update. A bot
+	// appears once per segment in the area. Removing bots that are no longer
+	// in the bot set only guards against calls at another point of the frame.
+	m_currentBots.clear();
+	for(auto &segmentInfo: field.getSegmentInfoMap().getRectRegion(m_topLeft, m_size)) {
+		m_currentBots.push_back(segmentInfo.bot);
+	}
+
+	auto byGUID = [](const std::shared_ptr<Bot> &a, const std::shared_ptr<Bot> &b) {
+		return a->getGUID() < b->getGUID();
+	};
+
+	std::sort(m_currentBots.begin(), m_currentBots.end(), byGUID);
+	m_currentBots.erase(std::unique(m_currentBots.begin(), m_currentBots.end()), m_currentBots.end());
+	m_currentBots.erase(
+			std::remove_if(m_currentBots.begin(), m_currentBots.end(),
+				[&bots](const std::shared_ptr<Bot> &bot) { return bots.count(bot) == 0; }),
+			m_currentBots.end());
+
+	m_currentFood.clear();
+	for(auto &food: field.getFoodMap().getRectRegion(m_topLeft, m_size)) {
+		m_currentFood.push_back(&food);
+	}
+
+	std::sort(m_currentFood.begin(), m_currentFood.end(),
+			[](const Food *a, const Food *b) { return a->getGUID() < b->getGUID(); });
+	m_currentFood.erase(std::unique(m_currentFood.begin(), m_currentFood.end()), m_currentFood.end());
+}
+
+UpdateTracker::Frame AreaOfInterest::update(Field &field, MsgPackProtocol::MoveEncoding moveEncoding)
+{
+	collectCurrent(field);
+
+	// the previous frame is reused if the server has sent it already
+	if(!m_output || (m_output.use_count() != 1)) {
+		m_output = std::make_shared<std::string>();
+	}
+
+	MsgPackBuffer frame;
+	frame.data.swap(*m_output);
+	frame.data.clear();
+
+	MsgPackV2::beginFrame(frame);
+	uint32_t messageCount = 0;
+
+	MsgPackV2::Packer packer(frame);
+
+	m_nextVisibleBots.clear();
+	m_nextVisibleFood.clear();
+
+	if(!m_initialized) {
+		// initial state of the area
+		MsgPackV2::packGameInfo(packer);
+
+		packer.pack_array(3);
+		packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_WORLD_UPDATE));
+
+		packer.pack_array(m_currentBots.size());
+		for(auto &bot: m_currentBots) {
+			MsgPackV2::packBot(packer, bot);
+			m_nextVisibleBots.push_back({bot->getGUID(), MsgPackV2::toFixedPoint(bot->getSnake()->getHeadPosition()),
+					bot, Snake::PositionList()});
+		}
+
+		packer.pack_array(m_currentFood.size());
+		for(auto food: m_currentFood) {
+			MsgPackV2::packFood(packer, *food);
+			m_nextVisibleFood.push_back(food->getGUID());
+		}
+
+		messageCount += 2;
+		m_initialized = true;
+	} else {
+		packer.pack_array(2);
+		packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_TICK));
+		packer.pack(static_cast<uint64_t>(field.getCurrentFrame()));
+		messageCount++;
+
+		int moveType = (moveEncoding == MsgPackProtocol::MOVE_ENCODING_MOVE)
+			? MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE
+			: MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE_HEAD;
+
+		m_moveItems.data.clear();
+		m_botLeaveItems.data.clear();
+		m_foodSpawnItems.data.clear();
+		m_foodLeaveItems.data.clear();
+
+		uint32_t moveCount = 0;
+		uint32_t botLeaveCount = 0;
+		uint32_t foodSpawnCount = 0;
+		uint32_t foodLeaveCount = 0;
+
+		MsgPackV2::Packer movePacker(m_moveItems);
+		MsgPackV2::Packer botLeavePacker(m_botLeaveItems);
+		MsgPackV2::Packer foodSpawnPacker(m_foodSpawnItems);
+		MsgPackV2::Packer foodLeavePacker(m_foodLeaveItems);
+
+		// bots: both lists are sorted by GUID
+		auto previous = m_visibleBots.begin();
+		auto current = m_currentBots.begin();
+
+		while((previous != m_visibleBots.end()) || (current != m_currentBots.end())) {
+			if((current == m_currentBots.end())
+					|| ((previous != m_visibleBots.end()) && (previous->guid < (*current)->getGUID()))) {
+				// left the area or died
+				botLeavePacker.pack(static_cast<uint32_t>(previous->guid));
+				botLeaveCount++;
+				previous++;
+				continue;
+			}
+
+			const std::shared_ptr<Bot> &bot = *current;
+			MsgPackV2::FixedPoint head = MsgPackV2::toFixedPoint(bot->getSnake()->getHeadPosition());
+
+			// keeps the capacity of the collected head positions
+			Snake::PositionList headPositions;
+
+			if((previous == m_visibleBots.end()) || ((*current)->getGUID() < previous->guid)) {
+				// entered the area
+				packer.pack_array(2);
+				packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_BOT_SPAWN));
+				MsgPackV2::packBot(packer, bot);
+				messageCount++;
+			} else {
+				// still visible
+				if(moveEncoding == MsgPackProtocol::MOVE_ENCODING_MOVE) {
+					// only the segments at the head for the steps moved since the
+					// last update, not the whole snake
+					std::size_t steps = std::min(previous->headPositions.size(),
+							bot->getSnake()->getSegments().size());
+					MsgPackV2::packMoveItem(movePacker, bot, steps, previous->head);
+				} else {
+					MsgPackV2::packMoveHeadItem(movePacker, bot, previous->headPositions, previous->head);
+				}
+
+				moveCount++;
+
+				headPositions.swap(previous->headPositions);
+				headPositions.clear();
+				previous++;
+			}
+
+			m_nextVisibleBots.push_back({bot->getGUID(), head, bot, std::move(headPositions)});
+			current++;
+		}
+
+		// food: both lists are sorted by GUID
+		auto previousFood = m_visibleFood.begin();
+		auto currentFood = m_currentFood.begin();
+
+		while((previousFood != m_visibleFood.end()) || (currentFood != m_currentFood.end())) {
+			if((currentFood == m_currentFood.end())
+					|| ((previousFood != m_visibleFood.end()) && (*previousFood < (*currentFood)->getGUID()))) {
+				// left the area, eaten or decayed
+				foodLeavePacker.pack(static_cast<uint32_t>(*previousFood));
+				foodLeaveCount++;
+				previousFood++;
+				continue;
+			}
+
+			if((previousFood == m_visibleFood.end()) || ((*currentFood)->getGUID() < *previousFood)) {
+				// entered the area
+				MsgPackV2::packFood(foodSpawnPacker, **currentFood);
+				foodSpawnCount++;
+			} else {
+				previousFood++;
+			}
+
+			m_nextVisibleFood.push_back((*currentFood)->getGUID());
+			currentFood++;
+		}
+
+		messageCount += MsgPackV2::appendItemMessage(frame, MsgPackProtocol::MESSAGE_TYPE_BOT_LEAVE, m_botLeaveItems, botLeaveCount);
+		messageCount += MsgPackV2::appendItemMessage(frame, moveType, m_moveItems, moveCount);
+		messageCount += MsgPackV2::appendItemMessage(frame, MsgPackProtocol::MESSAGE_TYPE_FOOD_LEAVE, m_foodLeaveItems, foodLeaveCount);
+		messageCount += MsgPackV2::appendItemMessage(frame, MsgPackProtocol::MESSAGE_TYPE_FOOD_SPAWN, m_foodSpawnItems, foodSpawnCount);
+	}
+
+	m_visibleBots.swap(m_nextVisibleBots);
+	m_visibleFood.swap(m_nextVisibleFood);
+
+	MsgPackV2::endFrame(frame, messageCount);
+
+	m_output->swap(frame.data);
+	return m_output;
+}
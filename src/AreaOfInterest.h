@@ -0,0 +1,125 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+
+#include "MsgPackProtocol.h"
+#include "MsgPackV2.h"
+#include "Snake.h"
+#include "UpdateTracker.h"
+
+class Bot;
+class Field;
+class Food;
+
+/*!
+ * \brief Part of the world a viewer has subscribed to.
+ *
+ * \details
+ * Instead of the shared event stream, the viewer gets a frame built from the
+ * difference between the entities visible in the last and in the current
+ * frame (protocol version 2, see MsgPackProtocol). Visibility is determined
+ * on the tile level of the Field's spatial maps, so the area is slightly
+ * enlarged to tile borders.
+ *
+ * The area is either a fixed rectangle or centered on a followed bot.
+ *
+ * At lower update rates, the moves of the visible bots are collected every
+ * frame by trackMoves(), so an update contains the head positions of all
+ * frames since the previous one, like the shared aggregated streams.
+ */
+class AreaOfInterest
+{
+	public:
+		/*!
+		 * Subscribe to a fixed rectangle.
+		 */
+		void setArea(const Vector2D &topLeft, const Vector2D &size);
+
+		/*!
+		 * Subscribe to a rectangle centered on the head of the bot with the
+		 * given (32 bit) id. If the bot dies, the area stays where it was.
+		 */
+		void setFollowedBot(uint32_t botId, const Vector2D &size);
+
+		/*!
+		 * Forget what the viewer knows. The next frame starts with GameInfo and
+		 * a WorldUpdate of the area.
+		 */
+		void reset(void);
+
+		/*!
+		 * Collect the head positions of the last move of the bots known to
+		 * the viewer. Must be called in every frame, after the bots have
+		 * moved and before update().
+		 */
+		void trackMoves(void);
+
+		/*!
+		 * Build the frame for the current world state.
+		 *
+		 * \param field         The Field, after all updates of this frame.
+		 * \param moveEncoding  Selects BotMove or BotMoveHead messages.
+		 */
+		UpdateTracker::Frame update(Field &field, MsgPackProtocol::MoveEncoding moveEncoding);
+
+	private:
+		struct VisibleBot {
+			guid_t                guid;
+			MsgPackV2::FixedPoint head; //!< Head position known to the viewer
+			std::weak_ptr<Bot>    bot;
+
+			//! Head positions of all moves since the last update, one per step
+			Snake::PositionList   headPositions;
+		};
+
+		Vector2D m_topLeft{0, 0};
+		Vector2D m_size{0, 0};
+
+		bool     m_followBot = false;
+		uint32_t m_followedBotId = 0;
+
+		bool m_initialized = false; //!< Viewer has received the initial state
+
+		std::vector<VisibleBot> m_visibleBots; //!< Sorted by GUID
+		std::vector<guid_t>     m_visibleFood; //!< Sorted
+
+		// reused between frames
+		std::vector<std::shared_ptr<Bot>> m_currentBots;
+		std::vector<const Food*>          m_currentFood;
+		std::vector<VisibleBot>           m_nextVisibleBots;
+		std::vector<guid_t>               m_nextVisibleFood;
+
+		MsgPackBuffer m_moveItems;
+		MsgPackBuffer m_botLeaveItems;
+		MsgPackBuffer m_foodSpawnItems;
+		MsgPackBuffer m_foodLeaveItems;
+
+		std::shared_ptr<std::string> m_output;
+
+		/*!
+		 * Collect the bots and food currently in the area.
+		 */
+		void collectCurrent(Field &field);
+};
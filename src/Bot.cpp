@@ -16,6 +16,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
@@ -23,6 +24,8 @@
 
 #include "Field.h"
 #include "DockerBot.h"
+#include "MsgPackV2.h"
+#include "UpdateTracker.h"
 
 Bot::Bot(Field *field, uint32_t startFrame, std::unique_ptr<db::BotScript> dbData, const Vector2D &startPos, real_t startHeading)
 	: m_field(field)
@@ -59,7 +62,16 @@ void Bot::internalShutdown(void)
 
 bool Bot::init(std::string& initErrorMessage)
 {
-	return m_docker_bot->init(initErrorMessage);
+	if(!m_docker_bot->init(initErrorMessage)) {
+		return false;
+	}
+
+	MsgPackBuffer info;
+	MsgPackV2::Packer packer(info);
+	MsgPackV2::packBotInfo(packer, getName(), getDatabaseVersionId(), getFace(), getDogTag(), getColors());
+	m_packedInfo = std::move(info.data);
+
+	return true;
 }
 
 std::size_t Bot::move(void)
@@ -106,34 +118,121 @@ std::size_t Bot::move(void)
 
 std::shared_ptr<Bot> Bot::checkCollision(void) const
 {
-	real_t maxCollisionDistance =
-		m_snake->getSegmentRadius() + m_field->getMaxSegmentRadius();
+	if(config::COLLISION_USE_CAPSULES) {
+		return checkCapsuleCollision();
+	}
+
+	return checkSegmentCollision();
+}
+
+std::shared_ptr<Bot> Bot::checkSegmentCollision(void) const
+{
+	real_t ownRadius = m_snake->getSegmentRadius();
+	real_t maxCollisionDistance = ownRadius + m_field->getMaxSegmentRadius();
 
 	Vector2D headPos = m_snake->getHeadPosition();
 
+	// segments of a bot are stored consecutively, so the bounds check of
+	// the last seen bot is cached
+	const Bot *lastBot = this;
+	bool lastBotInReach = false;
+
 	std::shared_ptr<Bot> retval = nullptr;
-	for (auto &fi: m_field->getSegmentInfoMap().getRegion(headPos, maxCollisionDistance))
-	{
-		if(fi.bot->getGUID() == this->getGUID())
-		{
-			// prevent self-collision
-			continue;
-		}
-
-		// get actual distance to segment
-		real_t dist = (headPos - fi.pos()).squaredNorm();
-
-		// get maximum distance for collision detection
-		real_t collisionDist =
-			m_snake->getSegmentRadius() + fi.bot->getSnake()->getSegmentRadius();
-		collisionDist *= collisionDist; // square it
-
-		if(dist < collisionDist) {
-			// collision detected!
-			retval = fi.bot;
-			break;
-		}
-	}
+	m_field->getSegmentInfoMap().visitTilesInReach(headPos, maxCollisionDistance,
+		[this, ownRadius](std::size_t tileIndex) {
+			// only tiles with segments that may reach the head
+			return ownRadius + m_field->getSegmentTileMaxReach(tileIndex);
+		},
+		[&](Field::SegmentInfoMap::TileVector &tile) {
+			for (auto &fi: tile)
+			{
+				if(fi.bot.get() != lastBot)
+				{
+					// prevent self-collision: never in reach
+					lastBot = fi.bot.get();
+					lastBotInReach = (lastBot != this) && m_field->isInSegmentReach(*lastBot, headPos, ownRadius);
+				}
+
+				if(!lastBotInReach)
+				{
+					continue;
+				}
+
+				// get actual distance to segment
+				real_t dist = (headPos - fi.pos()).squaredNorm();
+
+				// get maximum distance for collision detection
+				real_t collisionDist =
+					ownRadius + fi.bot->getSnake()->getSegmentRadius();
+				collisionDist *= collisionDist; // square it
+
+				if(dist < collisionDist) {
+					// collision detected!
+					retval = fi.bot;
+					return false;
+				}
+			}
+
+			return true;
+		});
+
+	return retval;
+}
+
+std::shared_ptr<Bot> Bot::checkCapsuleCollision(void) const
+{
+	real_t ownRadius = m_snake->getSegmentRadius();
+	real_t maxCollisionDistance = ownRadius + m_field->getMaxCapsuleReach();
+
+	Vector2D headPos = m_snake->getHeadPosition();
+
+	// see checkSegmentCollision()
+	const Bot *lastBot = this;
+	bool lastBotInReach = false;
+
+	std::shared_ptr<Bot> retval = nullptr;
+	m_field->getCapsuleInfoMap().visitTilesInReach(headPos, maxCollisionDistance,
+		[this, ownRadius](std::size_t tileIndex) {
+			return ownRadius + m_field->getCapsuleTileMaxReach(tileIndex);
+		},
+		[&](Field::CapsuleInfoMap::TileVector &tile) {
+			for (auto &ci: tile)
+			{
+				if(ci.bot.get() != lastBot)
+				{
+					lastBot = ci.bot.get();
+					lastBotInReach = (lastBot != this) && m_field->isInCapsuleReach(*lastBot, headPos, ownRadius);
+				}
+
+				if(!lastBotInReach)
+				{
+					continue;
+				}
+
+				// closest point on the capsule axis
+				Vector2D relPos = m_field->unwrapRelativeCoords(headPos - ci.center);
+				real_t axisLengthSquared = ci.halfAxis.squaredNorm();
+
+				real_t t = 0;
+				if(axisLengthSquared > 0) {
+					t = relPos.dot(ci.halfAxis) / axisLengthSquared;
+					t = std::min(std::max(t, real_t(-1)), real_t(1));
+				}
+
+				real_t dist = (relPos - t * ci.halfAxis).squaredNorm();
+
+				real_t collisionDist =
+					ownRadius + ci.bot->getSnake()->getSegmentRadius();
+				collisionDist *= collisionDist; // square it
+
+				if(dist < collisionDist) {
+					retval = ci.bot;
+					return false;
+				}
+			}
+
+			return true;
+		});
 
 	return retval;
 }
@@ -173,7 +272,20 @@ bool Bot::appendLogMessage(const std::string& data, bool checkCredit)
 	return true;
 }
 
-std::vector<uint32_t> Bot::getColors()
+void Bot::sendLogMessages(UpdateTracker &tracker)
+{
+	m_docker_bot->drainLogRing(
+		[this, &tracker] (const char *message, std::size_t length)
+		{
+			if (m_logCredit<1) { return; }
+			m_logCredit -= 1;
+
+			tracker.botLogMessage(getViewerKey(), message,
+					std::min(length, config::LOG_MAX_MESSAGE_SIZE));
+		});
+}
+
+const std::vector<uint32_t>& Bot::getColors()
 {
 	return m_docker_bot->getColors();
 }
@@ -32,6 +32,7 @@
 
 class Field;
 class GlobalView;
+class UpdateTracker;
 
 /*!
  * A bot playing this game.
@@ -51,12 +52,16 @@ class Bot : public IdentifyableObject
 		real_t m_consumedFoodHuntedByOthers = 0;
 		real_t m_consumedNaturalFood = 0;
 
+		uint32_t m_slot = 0; //!< Dense index among the living bots, see getSlot()
+
 		uint32_t m_stepErrors = 0; //!< incremented on each failed step() call, reset on successful calls
 
 		Stopwatch m_swMove;
 
 		bool m_hasFatalError = false;
 
+		std::string m_packedInfo; //!< See getPackedInfo()
+
 	public:
 		/*!
 		 * Creates a new bot identified by the given name on the given playing
@@ -100,6 +105,18 @@ class Bot : public IdentifyableObject
 		 */
 		std::shared_ptr<Bot> checkCollision(void) const;
 
+		/*!
+		 * Collision check against the individual segments of the other
+		 * Snakes, the default model.
+		 */
+		std::shared_ptr<Bot> checkSegmentCollision(void) const;
+
+		/*!
+		 * Collision check against the capsules of the other Snakes' collision
+		 * skeletons, see config::COLLISION_USE_CAPSULES.
+		 */
+		std::shared_ptr<Bot> checkCapsuleCollision(void) const;
+
 		/*!
 		 * \brief increase log credit every frame, until config::LOG_MAX_CREDITS is reached
 		 */
@@ -121,16 +138,46 @@ class Bot : public IdentifyableObject
 
 		uint64_t getViewerKey() { return m_dbData->viewer_key; }
 
+		/*!
+		 * \brief Dense index of this bot among the living bots.
+		 *
+		 * Assigned by the Field when the bot enters the game (the lowest free
+		 * index is used) and released when it is killed. Use it to index per-bot
+		 * tables instead of looking up the GUID.
+		 */
+		uint32_t getSlot(void) const { return m_slot; }
+		void setSlot(uint32_t slot) { m_slot = slot; }
+
 		bool appendLogMessage(const std::string &data, bool checkCredit);
 		real_t getLogCredit() { return m_logCredit; }
 		std::vector<std::string> &getLogMessages() { return m_logMessages; }
 		void clearLogMessages() { m_logMessages.clear(); }
 
-		std::vector<uint32_t> getColors();
+		/*!
+		 * \brief Pass the log messages written by the bot to the tracker.
+		 *
+		 * The messages are read directly from the shared memory log ring. Each
+		 * message costs one log credit, messages without credit are dropped.
+		 */
+		void sendLogMessages(UpdateTracker &tracker);
+
+		const std::vector<uint32_t>& getColors();
 		real_t getSightRadius() const;
 		uint32_t getFace();
 		uint32_t getDogTag();
 
+		/*!
+		 * \brief MsgPack encoding of the properties that do not change after
+		 * init().
+		 *
+		 * These are the fields following the GUID of a Bot object in the
+		 * BotSpawn and WorldUpdate messages (name, database version, face, dog
+		 * tag and colors), identical in both protocol versions. They are
+		 * encoded once by init() and copied into every message; the GUID is
+		 * packed per message with the width of the protocol version.
+		 */
+		const std::string& getPackedInfo(void) const { return m_packedInfo; }
+
 		long getLastMoveTimeNs() { return m_swMove.GetThreadTimeNs(); }
 		long getApiTimeNs();
 
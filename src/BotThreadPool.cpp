@@ -20,6 +20,7 @@
 #include <sstream>
 
 #include "Bot.h"
+#include "Field.h"
 
 #include "config.h"
 
@@ -32,7 +33,7 @@ BotThreadPool::BotThreadPool(std::size_t num_threads)
 	int threadnum = 0;
 	for(auto &thread : m_threads) {
 		thread = std::thread(
-					[this] ()
+					[this, threadnum] ()
 					{
 						while(true) {
 							m_workAvailSemaphore.wait();
@@ -61,6 +62,8 @@ BotThreadPool::BotThreadPool(std::size_t num_threads)
 							}
 
 							if(currentJob) {
+								currentJob->worker = threadnum;
+
 								switch(currentJob->jobType) {
 									case Move:
 										currentJob->steps = currentJob->bot->move();
@@ -69,6 +72,18 @@ BotThreadPool::BotThreadPool(std::size_t num_threads)
 									case CollisionCheck:
 										currentJob->killer = currentJob->bot->checkCollision();
 										break;
+
+									case FinishMove:
+										currentJob->bot->getField()->finishMove(*currentJob);
+										break;
+
+									case CollectFood:
+										currentJob->bot->getField()->collectConsumableFood(*currentJob);
+										break;
+
+									case ConsumeFood:
+										currentJob->bot->getField()->consumeCollectedFood(*currentJob);
+										break;
 								}
 
 								std::lock_guard<std::mutex> processedQueueGuard(m_processedQueueMutex);
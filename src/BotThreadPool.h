@@ -36,7 +36,10 @@ class BotThreadPool
 	public:
 		enum JobType {
 			Move,
-			CollisionCheck
+			CollisionCheck,
+			FinishMove,     //!< Track the move of a surviving bot, see Field::finishMove()
+			CollectFood,    //!< See Field::collectConsumableFood()
+			ConsumeFood     //!< See Field::consumeCollectedFood()
 		};
 
 		struct Job {
@@ -51,6 +54,9 @@ class BotThreadPool
 			// for jobType == CollisionCheck
 			std::shared_ptr<Bot> killer;
 
+			// index of the worker thread that processed the job
+			std::size_t worker = 0;
+
 			Job(JobType type, const std::shared_ptr<Bot> myBot)
 				: jobType(type), bot(myBot)
 			{}
@@ -96,6 +102,14 @@ class BotThreadPool
 		 */
 		void waitForCompletion(void);
 
+		/*!
+		 * \brief Number of worker threads.
+		 *
+		 * Jobs report the index of the thread that processed them (0 to
+		 * getThreadCount() - 1) in Job::worker.
+		 */
+		std::size_t getThreadCount(void) const { return m_threads.size(); }
+
 		/*!
 		 * \brief Get next processed job.
 		 * \returns The next queue entry (which is removed from the queue) or
@@ -20,6 +20,8 @@
 #include <iostream>
 #include <regex>
 #include <cstring>
+#include <cstddef>
+#include <limits>
 
 #include <sys/mman.h>
 #include <sys/socket.h>
@@ -40,10 +42,14 @@
 
 #include "DockerBot.h"
 
+// marks bot table entries not written yet
+static const guid_t NO_BOT = std::numeric_limits<guid_t>::max();
+
 DockerBot::DockerBot(Bot &bot, std::string imageName)
 	: m_bot(bot)
 	, m_imageName(imageName)
 	, m_swAPI("api")
+	, m_polar(bot.getField()->getSize().x(), bot.getField()->getSize().y())
 	, m_shm(NULL)
 	, m_listenSocket(-1)
 	, m_botSocket(-1)
@@ -96,30 +102,27 @@ void DockerBot::createSharedMemory(void)
 		throw std::runtime_error("Failed to set up bot directory.");
 	}
 
-	int shm_fd = open(shm_path.c_str(), O_RDWR | O_CREAT, 0666);
-	if(shm_fd == -1) {
-		std::cerr << logPrefix() << "shm_open() failed: " << strerror(errno) << std::endl;
-		throw std::runtime_error("Failed to set up shared memory.");
-	}
-
-	ret = ftruncate(shm_fd, IPC_SHARED_MEMORY_BYTES);
-	if(ret == -1) {
-		std::cerr << logPrefix() << "ftruncate() failed: " << strerror(errno) << std::endl;
-		throw std::runtime_error("Failed to set up shared memory.");
-	}
-
-	void *shared_mem = mmap(NULL, IPC_SHARED_MEMORY_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-	if(shared_mem == (void*)-1) {
-		std::cerr << logPrefix() << "mmap() failed: " << strerror(errno) << std::endl;
-		close(shm_fd);
-		throw std::runtime_error("Failed to set up shared memory.");
-	}
-
-	m_shm = reinterpret_cast<struct IpcSharedMemory*>(shared_mem);
-	m_shmFd = shm_fd;
+	m_shmRegion = SharedMemoryPool::instance().acquire(shm_path, IPC_SHARED_MEMORY_BYTES);
+	m_shm = reinterpret_cast<struct IpcSharedMemory*>(m_shmRegion.addr);
 
 	std::cerr << logPrefix() << "Set up shared memory at address " << std::hex << m_shm
-		<< " with size of " << std::dec << IPC_SHARED_MEMORY_BYTES << " bytes." << std::endl;
+		<< " with size of " << std::dec << m_shmRegion.size << " bytes"
+		<< (m_shmRegion.reused ? " (reused)." : ".") << std::endl;
+
+	if(m_shmRegion.reused) {
+		// the region still contains the data of this bot's previous life
+		m_shm->foodCount = 0;
+		m_shm->botCount = 0;
+		m_shm->botTableCount = 0;
+		m_shm->segmentCount = 0;
+		m_shm->faceID = 0;
+		m_shm->dogTagID = 0;
+		m_shm->foodTable.enabled = 0;
+		m_shm->foodTable.slotCount = 0;
+		m_shm->foodTable.changeCount = 0;
+	} else {
+		prefaultSharedMemory();
+	}
 
 	// set default color
 	m_shm->colorCount = 1;
@@ -137,16 +140,45 @@ void DockerBot::destroySharedMemory(void)
 		return;
 	}
 
-	int ret = munmap(m_shm, IPC_SHARED_MEMORY_BYTES);
-	if(ret == -1) {
-		std::cerr << logPrefix() << "munmap() failed: " << strerror(errno) << std::endl;
-	}
-
-	close(m_shmFd);
+	SharedMemoryPool::instance().release(m_shmRegion);
 
 	m_shm = NULL;
 }
 
+void DockerBot::prefaultSharedMemory(void)
+{
+	uint8_t *base = reinterpret_cast<uint8_t*>(m_shm);
+
+	// everything up to the food list
+	SharedMemoryPool::prefault(base,
+			offsetof(IpcSharedMemory, foodInfo) + config::BOT_SHM_PREFAULT_FOOD_COUNT * sizeof(IpcFoodInfo));
+
+	SharedMemoryPool::prefault(base + offsetof(IpcSharedMemory, botCount),
+			offsetof(IpcSharedMemory, botInfo) - offsetof(IpcSharedMemory, botCount)
+			+ config::BOT_SHM_PREFAULT_BOT_COUNT * sizeof(IpcBotInfo));
+
+	SharedMemoryPool::prefault(base + offsetof(IpcSharedMemory, segmentCount),
+			offsetof(IpcSharedMemory, segmentInfo) - offsetof(IpcSharedMemory, segmentCount)
+			+ config::BOT_SHM_PREFAULT_SEGMENT_COUNT * sizeof(IpcSegmentInfo));
+
+	// colors, log, persistent data and the food table header
+	SharedMemoryPool::prefault(base + offsetof(IpcSharedMemory, colorCount),
+			offsetof(IpcSharedMemory, foodTable) - offsetof(IpcSharedMemory, colorCount)
+			+ offsetof(IpcFoodTable, changes));
+
+	SharedMemoryPool::prefault(base + offsetof(IpcSharedMemory, botTableCount),
+			offsetof(IpcSharedMemory, botTable) - offsetof(IpcSharedMemory, botTableCount)
+			+ config::BOT_SHM_PREFAULT_BOT_COUNT * sizeof(IpcBotInfo));
+}
+
+void DockerBot::prefaultFoodTable(void)
+{
+	IpcFoodTable &table = m_shm->foodTable;
+
+	SharedMemoryPool::prefault(table.changes, config::BOT_SHM_PREFAULT_FOOD_COUNT * sizeof(IpcFoodChange));
+	SharedMemoryPool::prefault(table.slots, config::BOT_SHM_PREFAULT_FOOD_COUNT * sizeof(IpcFoodSlot));
+}
+
 void DockerBot::prepareSharedMemory(void)
 {
 	m_shm->serverConfig.snake_boost_steps               = config::SNAKE_BOOST_STEPS;
@@ -203,76 +235,100 @@ void DockerBot::fillSharedMemory(void)
 
 	auto field = m_bot.getField();
 
-	size_t idx = 0;
-	for (auto &food: field->getFoodMap().getRegion(head_pos, radius))
-	{
-		if(idx >= IPC_FOOD_MAX_COUNT) {
-			// maximum amount of food written
-			break;
+	if(m_useFoodTable) {
+		fillFoodTable(head_pos, heading, radius, min_size);
+		m_shm->foodCount = 0;
+	} else {
+		m_polar.clear();
+		m_foodCandidates.clear();
+
+		for (auto &food: field->getFoodMap().getRegion(head_pos, radius))
+		{
+			if (food.getValue()>=min_size)
+			{
+				m_polar.add(food.pos() - head_pos);
+				m_foodCandidates.push_back(&food);
+			}
 		}
 
-		if (food.getValue()>=min_size)
+		m_polar.run(heading);
+
+		size_t idx = 0;
+		for (size_t i = 0; i < m_polar.size(); i++)
 		{
-			Vector2D relPos = field->unwrapRelativeCoords(food.pos() - head_pos);
-			real_t direction = static_cast<real_t>(atan2(relPos.y(), relPos.x())) - heading;
-			while (direction < -M_PI) { direction += 2*M_PI; }
-			while (direction >  M_PI) { direction -= 2*M_PI; }
-			auto distance = relPos.norm();
-			if (distance>radius) { continue; }
-
-			m_shm->foodInfo[idx].x = relPos.x();
-			m_shm->foodInfo[idx].y = relPos.y();
-			m_shm->foodInfo[idx].val = food.getValue();
-			m_shm->foodInfo[idx].dir = direction;
-			m_shm->foodInfo[idx].dist = distance;
+			if(idx >= IPC_FOOD_MAX_COUNT) {
+				// maximum amount of food written
+				break;
+			}
+
+			if (m_polar.dist(i)>radius) { continue; }
+
+			m_shm->foodInfo[idx].x = m_polar.x(i);
+			m_shm->foodInfo[idx].y = m_polar.y(i);
+			m_shm->foodInfo[idx].val = m_foodCandidates[i]->getValue();
+			m_shm->foodInfo[idx].dir = m_polar.dir(i);
+			m_shm->foodInfo[idx].dist = m_polar.dist(i);
 
 			idx++;
 		}
-	}
 
-	m_shm->foodCount = idx;
+		m_shm->foodCount = idx;
 
-	std::sort(
-		std::begin(m_shm->foodInfo),
-		std::begin(m_shm->foodInfo) + m_shm->foodCount,
-		[](const IpcFoodInfo& a, const IpcFoodInfo& b) { return a.dist < b.dist; }
-	);
+		std::sort(
+			std::begin(m_shm->foodInfo),
+			std::begin(m_shm->foodInfo) + m_shm->foodCount,
+			[](const IpcFoodInfo& a, const IpcFoodInfo& b) { return a.dist < b.dist; }
+		);
+	}
 
 	// Step 3: segments
 
 	auto self_id = m_bot.getGUID();
 
-	std::set< std::shared_ptr<Bot> > usedBots;
+	// bot list and table entries are only written once per frame and only if
+	// the entry's bot has changed since the last frame
+	std::fill(m_visitedBotSlots.begin(), m_visitedBotSlots.end(), 0);
+	uint32_t botCount = 0;
+
+	m_polar.clear();
+	m_segmentCandidates.clear();
+	m_segmentCandidateBots.clear();
 
-	idx = 0;
 	for (auto &segmentInfo: field->getSegmentInfoMap().getRegion(head_pos, radius + m_bot.getField()->getMaxSegmentRadius()))
+	{
+		m_polar.add(segmentInfo.pos() - head_pos);
+		m_segmentCandidates.push_back(&segmentInfo.segment);
+		m_segmentCandidateBots.push_back(&segmentInfo.bot);
+	}
+
+	m_polar.run(heading);
+
+	size_t idx = 0;
+	for (size_t i = 0; i < m_polar.size(); i++)
 	{
 		if(idx >= IPC_SEGMENT_MAX_COUNT) {
 			// maximum number of segments written
 			break;
 		}
 
-		guid_t segmentBotID = segmentInfo.bot->getGUID();
+		const std::shared_ptr<Bot> &segmentBot = *m_segmentCandidateBots[i];
 
-		real_t segmentRadius = segmentInfo.bot->getSnake()->getSegmentRadius();
-		Vector2D relPos = field->unwrapRelativeCoords(segmentInfo.pos() - head_pos);
-		real_t distance = relPos.norm();
-		if (distance > (radius+segmentRadius)) { continue; }
+		guid_t segmentBotID = segmentBot->getGUID();
 
-		real_t direction = atan2(relPos.y(), relPos.x()) - heading;
-		if (direction < -M_PI) { direction += 2*M_PI; }
-		if (direction >  M_PI) { direction -= 2*M_PI; }
+		real_t segmentRadius = segmentBot->getSnake()->getSegmentRadius();
+		real_t distance = m_polar.dist(i);
+		if (distance > (radius+segmentRadius)) { continue; }
 
-		m_shm->segmentInfo[idx].x = relPos.x();
-		m_shm->segmentInfo[idx].y = relPos.y();
+		m_shm->segmentInfo[idx].x = m_polar.x(i);
+		m_shm->segmentInfo[idx].y = m_polar.y(i);
 		m_shm->segmentInfo[idx].r = segmentRadius;
-		m_shm->segmentInfo[idx].dir = direction;
+		m_shm->segmentInfo[idx].dir = m_polar.dir(i);
 		m_shm->segmentInfo[idx].dist = distance;
 		m_shm->segmentInfo[idx].bot_id = segmentBotID;
-		m_shm->segmentInfo[idx].idx = segmentInfo.segment.index;
+		m_shm->segmentInfo[idx].idx = m_segmentCandidates[i]->index;
 		m_shm->segmentInfo[idx].is_self = (segmentBotID == self_id);
 
-		usedBots.insert(segmentInfo.bot);
+		m_shm->segmentInfo[idx].bot_slot = addBotInfo(*segmentBot, botCount);
 
 		idx++;
 	}
@@ -287,22 +343,182 @@ void DockerBot::fillSharedMemory(void)
 
 	// Step 4: bots
 
-	idx = 0;
-	for(auto bot: usedBots) {
-		if(idx >= IPC_BOT_MAX_COUNT) {
-			// maximum number of bots written
-			break;
+	m_shm->botCount = botCount;
+	m_shm->botTableCount = m_botTableGuids.size();
+}
+
+uint32_t DockerBot::addBotInfo(const Bot &bot, uint32_t &botCount)
+{
+	uint32_t slot = bot.getSlot();
+
+	if(slot >= IPC_BOT_MAX_COUNT) {
+		// not in the table; this needs more than IPC_BOT_MAX_COUNT living bots,
+		// so a linear search for duplicates in the list is fine
+		for(uint32_t i = 0; i < botCount; i++) {
+			if(m_botInfoGuids[i] == bot.getGUID()) {
+				return IPC_BOT_SLOT_NONE;
+			}
 		}
 
-		m_shm->botInfo[idx].bot_id = bot->getGUID();
-		strncpy(m_shm->botInfo[idx].bot_name, bot->getName().c_str(), sizeof(m_shm->botInfo[idx].bot_name));
+		if(botCount < IPC_BOT_MAX_COUNT) {
+			updateBotListEntry(botCount++, bot);
+		}
 
-		idx++;
+		return IPC_BOT_SLOT_NONE;
 	}
 
-	m_shm->botCount = idx;
+	uint64_t &visited = m_visitedBotSlots[slot / 64];
+	uint64_t mask = 1ULL << (slot % 64);
+
+	if(visited & mask) {
+		return slot;
+	}
 
-	m_shm->logData[0] = '\0';
+	visited |= mask;
+
+	if(botCount < IPC_BOT_MAX_COUNT) {
+		updateBotListEntry(botCount++, bot);
+	}
+
+	if(slot >= m_botTableGuids.size()) {
+		// clear skipped entries, they may contain data from a previous life
+		for(size_t i = m_botTableGuids.size(); i < slot; i++) {
+			m_shm->botTable[i].bot_id = 0;
+			m_shm->botTable[i].bot_name[0] = '\0';
+		}
+
+		m_botTableGuids.resize(slot + 1, NO_BOT);
+	} else if(m_botTableGuids[slot] == bot.getGUID()) {
+		return slot;
+	}
+
+	m_botTableGuids[slot] = bot.getGUID();
+
+	m_shm->botTable[slot].bot_id = bot.getGUID();
+	strncpy(m_shm->botTable[slot].bot_name, bot.getName().c_str(), sizeof(m_shm->botTable[slot].bot_name));
+
+	return slot;
+}
+
+void DockerBot::updateBotListEntry(uint32_t index, const Bot &bot)
+{
+	if(index >= m_botInfoGuids.size()) {
+		m_botInfoGuids.resize(index + 1, NO_BOT);
+	} else if(m_botInfoGuids[index] == bot.getGUID()) {
+		return;
+	}
+
+	m_botInfoGuids[index] = bot.getGUID();
+
+	m_shm->botInfo[index].bot_id = bot.getGUID();
+	strncpy(m_shm->botInfo[index].bot_name, bot.getName().c_str(), sizeof(m_shm->botInfo[index].bot_name));
+}
+
+void DockerBot::fillFoodTable(const Vector2D &headPos, real_t heading, real_t radius, real_t minSize)
+{
+	IpcFoodTable &table = m_shm->foodTable;
+
+	auto field = m_bot.getField();
+	uint32_t frame = field->getCurrentFrame();
+
+	table.world_size_x = field->getSize().x();
+	table.world_size_y = field->getSize().y();
+	table.head_x = headPos.x();
+	table.head_y = headPos.y();
+	table.heading = heading;
+	table.changeCount = 0;
+
+	// Pass 1: mark visible food that is already in the table and collect new food
+	m_polar.clear();
+	m_foodCandidates.clear();
+
+	for (auto &food: field->getFoodMap().getRegion(headPos, radius))
+	{
+		if (food.getValue()>=minSize)
+		{
+			m_polar.add(food.pos() - headPos);
+			m_foodCandidates.push_back(&food);
+		}
+	}
+
+	m_polar.run(heading);
+
+	m_newFood.clear();
+	for (size_t i = 0; i < m_polar.size(); i++)
+	{
+		if (m_polar.dist(i)>radius) { continue; }
+
+		auto it = m_foodTableSlots.find(m_foodCandidates[i]->getGUID());
+		if(it != m_foodTableSlots.end()) {
+			m_foodSlotStates[it->second].seenFrame = frame;
+		} else {
+			m_newFood.push_back(m_foodCandidates[i]);
+		}
+	}
+
+	// Pass 2: remove food that is no longer visible
+	for(uint32_t slot = 0; slot < m_foodSlotStates.size(); slot++) {
+		FoodSlotState &state = m_foodSlotStates[slot];
+
+		if(!state.used || (state.seenFrame == frame)) {
+			continue;
+		}
+
+		real_t value = state.value - config::FOOD_DECAY_STEP * (frame - state.valueFrame);
+		real_t distance = field->unwrapRelativeCoords(state.pos - headPos).norm();
+
+		uint32_t type;
+		if(value < minSize) {
+			type = FOOD_DECAYED;
+		} else if(distance <= radius) {
+			// still in sight but gone: must have been eaten
+			type = FOOD_CONSUMED;
+		} else {
+			type = FOOD_LEFT_VIEW;
+		}
+
+		table.slots[slot].valid = 0;
+		table.changes[table.changeCount++] = {slot, type};
+
+		m_foodTableSlots.erase(state.guid);
+		m_freeFoodSlots.push_back(slot);
+		state.used = false;
+	}
+
+	// Pass 3: add new food
+	for(auto *food: m_newFood) {
+		uint32_t slot;
+
+		if(!m_freeFoodSlots.empty()) {
+			slot = m_freeFoodSlots.back();
+			m_freeFoodSlots.pop_back();
+		} else if(m_foodSlotStates.size() < IPC_FOOD_TABLE_MAX_COUNT) {
+			slot = m_foodSlotStates.size();
+			m_foodSlotStates.emplace_back();
+		} else {
+			// table is full
+			break;
+		}
+
+		FoodSlotState &state = m_foodSlotStates[slot];
+		state.used = true;
+		state.guid = food->getGUID();
+		state.seenFrame = frame;
+		state.pos = food->pos();
+		state.value = food->getValue();
+		state.valueFrame = frame;
+
+		table.slots[slot].x = state.pos.x();
+		table.slots[slot].y = state.pos.y();
+		table.slots[slot].val = state.value;
+		table.slots[slot].frame = frame;
+		table.slots[slot].valid = 1;
+		table.changes[table.changeCount++] = {slot, FOOD_SPAWNED};
+
+		m_foodTableSlots[state.guid] = slot;
+	}
+
+	table.slotCount = m_foodSlotStates.size();
 }
 
 void DockerBot::createSocket(void)
@@ -583,8 +799,10 @@ bool DockerBot::init(std::string &initErrorMessage)
 		return false;
 	}
 
-	// reset log data
-	m_shm->logData[0] = '\0';
+	// reset log ring
+	m_shm->logRing.head = 0;
+	m_shm->logRing.tail = 0;
+	m_logTail = 0;
 
 	IpcRequest request = {REQ_INIT};
 
@@ -596,13 +814,10 @@ bool DockerBot::init(std::string &initErrorMessage)
 	IpcResponse response;
 
 	if(!readMessageFromBot(&response, sizeof(response), config::BOT_INIT_TIMEOUT)) {
-		handleLogMessages();
 		initErrorMessage = "Bot is not responding.";
 		return false;
 	}
 
-	handleLogMessages();
-
 	if(response.type != RES_OK) {
 		initErrorMessage = "Bot could not initialize successfully.";
 		return false;
@@ -613,6 +828,13 @@ bool DockerBot::init(std::string &initErrorMessage)
 		return false;
 	}
 
+	// the food table can only be enabled during init()
+	m_useFoodTable = (m_shm->foodTable.enabled != 0);
+
+	if(m_useFoodTable) {
+		prefaultFoodTable();
+	}
+
 	if(m_shm->colorCount == 0) {
 		m_colors.resize(1);
 		m_colors[0] = 0x00EC25A2; // a nice pink for those who do not set any colors
@@ -677,8 +899,6 @@ bool DockerBot::step(float &directionChange, bool &boost)
 
 	m_swAPI.Stop();
 
-	handleLogMessages();
-
 	if(response.type != RES_OK) {
 		m_errorStream << "Bot responded to step() with an error status: " << response.type << std::endl;
 
@@ -704,24 +924,55 @@ std::string DockerBot::getPersistentData(void)
 			IPC_PERSISTENT_MAX_BYTES);
 }
 
-void DockerBot::handleLogMessages(void)
+void DockerBot::drainLogRing(const std::function<void(const char*, std::size_t)> &handler)
 {
-	// check for updated log data
-	if(m_shm->logData[0] != '\0') {
-		char *startPtr = m_shm->logData;
-		char *endPtr = startPtr;
-		bool moreMessages = true;
-
-		while(moreMessages && ((size_t)(endPtr - m_shm->logData) < IPC_LOG_MAX_BYTES)) {
-			if(*endPtr == '\n' || *endPtr == '\0') {
-				moreMessages = *endPtr == '\n';
-				*endPtr = '\0';
-
-				m_bot.appendLogMessage(startPtr, true);
-				startPtr = endPtr + 1;
-			}
+	if(!m_shm) {
+		return;
+	}
+
+	IpcLogRing &ring = m_shm->logRing;
+
+	uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+	uint32_t tail = m_logTail;
+
+	if(head - tail > IPC_LOG_RING_BYTES) {
+		// head was corrupted by the bot: drop everything
+		tail = head;
+	}
 
-			endPtr++;
+	while(head - tail >= sizeof(uint16_t)) {
+		uint16_t length;
+		readLogRing(tail, &length, sizeof(length));
+
+		if(length > head - tail - sizeof(length)) {
+			// incomplete or corrupt record: drop everything
+			tail = head;
+			break;
 		}
+
+		uint32_t start = tail + sizeof(length);
+		size_t offset = start % IPC_LOG_RING_BYTES;
+
+		if(offset + length <= IPC_LOG_RING_BYTES) {
+			// contiguous record: pass it directly from the shared memory
+			handler(ring.data + offset, length);
+		} else {
+			readLogRing(start, m_logScratch, length);
+			handler(m_logScratch, length);
+		}
+
+		tail = start + length;
 	}
+
+	m_logTail = tail;
+	__atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+}
+
+void DockerBot::readLogRing(uint32_t pos, void *dest, std::size_t len)
+{
+	size_t offset = pos % IPC_LOG_RING_BYTES;
+	size_t first = std::min(len, IPC_LOG_RING_BYTES - offset);
+
+	memcpy(dest, m_shm->logRing.data + offset, first);
+	memcpy(static_cast<char*>(dest) + first, m_shm->logRing.data, len - first);
 }
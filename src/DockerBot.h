@@ -20,12 +20,19 @@
 
 #include <ipc_format.h>
 
+#include <array>
+#include <functional>
 #include <sstream>
+#include <unordered_map>
 
 #include "config.h"
+#include "PolarTransform.h"
+#include "SharedMemoryPool.h"
+#include "Snake.h"
 #include "Stopwatch.h"
 
 class Bot;
+class Food;
 class DockerBot
 {
 	public:
@@ -63,6 +70,18 @@ class DockerBot
 		 */
 		std::string getPersistentData(void);
 
+		/*!
+		 * \brief Read all log messages the bot wrote to the log ring.
+		 *
+		 * The handler is called once per message. The message is not
+		 * null-terminated and the pointer is only valid during the call (it
+		 * usually points directly into the shared memory).
+		 *
+		 * Must not be called while the bot is executing init() or step() on
+		 * the server side.
+		 */
+		void drainLogRing(const std::function<void(const char*, std::size_t)> &handler);
+
 	private:
 		Bot&        m_bot;
 		std::string m_cleanName;
@@ -70,14 +89,44 @@ class DockerBot
 
 		Stopwatch   m_swAPI;
 
+		PolarTransform m_polar; //!< Reused every frame to convert vision candidates
+		std::vector<const Food*> m_foodCandidates;
+		std::vector<const Snake::Segment*> m_segmentCandidates;
+		std::vector<const std::shared_ptr<Bot>*> m_segmentCandidateBots;
+
+		/*!
+		 * Server-side state of a slot in the shared memory food table.
+		 */
+		struct FoodSlotState {
+			bool     used = false;
+			guid_t   guid = 0;
+			uint32_t seenFrame = 0;  //!< Last frame the food was visible
+			Vector2D pos;            //!< Position as written to the table
+			real_t   value = 0;      //!< Value as written to the table
+			uint32_t valueFrame = 0; //!< Frame in which value was written
+		};
+
+		std::vector<guid_t> m_botInfoGuids;  //!< GUIDs written to the bot list, indexed by list position
+		std::vector<guid_t> m_botTableGuids; //!< GUIDs written to the bot table, indexed by slot
+		std::array<uint64_t, (IPC_BOT_MAX_COUNT + 63) / 64> m_visitedBotSlots; //!< Bot table entries handled in this frame
+
+		bool m_useFoodTable = false; //!< Bot requested the food table during init()
+		std::unordered_map<guid_t, uint32_t> m_foodTableSlots; //!< Food GUID -> table slot
+		std::vector<FoodSlotState> m_foodSlotStates;
+		std::vector<uint32_t> m_freeFoodSlots;
+		std::vector<const Food*> m_newFood;
+
 		IpcSharedMemory *m_shm;
-		int              m_shmFd;
+		SharedMemoryPool::Region m_shmRegion;
 		int              m_dockerPID;
 		std::string      m_dockerContainerName;
 		int              m_listenSocket;
 		std::string      m_listenSockPath;
 		int              m_botSocket;
 
+		uint32_t m_logTail = 0; //!< Read position in the log ring (the shared copy is not trusted)
+		char     m_logScratch[IPC_LOG_RING_BYTES]; //!< Buffer for records wrapping around the ring end
+
 		std::ostringstream m_errorStream;
 
 		bool m_lastErrorWasFatal = false;
@@ -89,6 +138,14 @@ class DockerBot
 		void createSharedMemory(void);
 		void destroySharedMemory(void);
 
+		/*!
+		 * Fault in the parts of the shared memory that are written every frame
+		 * (up to the configured capacities), so this does not happen in the
+		 * worker threads.
+		 */
+		void prefaultSharedMemory(void);
+		void prefaultFoodTable(void);
+
 		/*!
 		 * Write static values to shared memory.
 		 */
@@ -99,6 +156,11 @@ class DockerBot
 		 */
 		void fillSharedMemory(void);
 
+		/*!
+		 * Write changes of the visible food to the food table (protocol v2).
+		 */
+		void fillFoodTable(const Vector2D &headPos, real_t heading, real_t radius, real_t minSize);
+
 		void createSocket(void);
 		void destroySocket(void);
 
@@ -111,5 +173,21 @@ class DockerBot
 		bool sendMessageToBot(void *data, size_t length);
 		bool readMessageFromBot(void *data, size_t length, real_t timeout);
 
-		void handleLogMessages(void);
+		/*!
+		 * Add the given bot to the bot list and the bot table if it was not
+		 * handled in this frame yet. Entries are only written if they hold a
+		 * different bot than in the previous frame.
+		 *
+		 * \param botCount  Number of bots listed in this frame so far, updated.
+		 * \returns         The bot's slot in the bot table or IPC_BOT_SLOT_NONE.
+		 */
+		uint32_t addBotInfo(const Bot &bot, uint32_t &botCount);
+
+		/*!
+		 * Write the bot list entry at the given position if it holds a
+		 * different bot.
+		 */
+		void updateBotListEntry(uint32_t index, const Bot &bot);
+
+		void readLogRing(uint32_t pos, void *dest, std::size_t len);
 };
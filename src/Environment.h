@@ -34,6 +34,34 @@ class Environment
 		static constexpr const char* ENV_MYSQL_DB = "MYSQL_DB";
 		static constexpr const char* ENV_MYSQL_DB_DEFAULT = "gameserver";
 
+		// record the viewer stream into a new subdirectory of this directory
+		static constexpr const char* ENV_RECORD_DIRECTORY = "SPN_RECORD_DIRECTORY";
+		static constexpr const char* ENV_RECORD_DIRECTORY_DEFAULT = "";
+
+		// serve a recording instead of running the game
+		static constexpr const char* ENV_REPLAY_DIRECTORY = "SPN_REPLAY_DIRECTORY";
+		static constexpr const char* ENV_REPLAY_DIRECTORY_DEFAULT = "";
+
+		static constexpr const char* ENV_REPLAY_SPEED = "SPN_REPLAY_SPEED";
+		static constexpr const char* ENV_REPLAY_SPEED_DEFAULT = "1.0";
+
+		static constexpr const char* ENV_REPLAY_START_FRAME = "SPN_REPLAY_START_FRAME";
+		static constexpr const char* ENV_REPLAY_START_FRAME_DEFAULT = "0";
+
+		// relay the viewer stream of another server instead of running the game
+		static constexpr const char* ENV_RELAY_UPSTREAM_HOST = "SPN_RELAY_UPSTREAM_HOST";
+		static constexpr const char* ENV_RELAY_UPSTREAM_HOST_DEFAULT = "";
+
+		static constexpr const char* ENV_RELAY_UPSTREAM_PORT = "SPN_RELAY_UPSTREAM_PORT";
+		static constexpr const char* ENV_RELAY_UPSTREAM_PORT_DEFAULT = "9010";
+
+		// viewer ports of the relay
+		static constexpr const char* ENV_RELAY_PORT = "SPN_RELAY_PORT";
+		static constexpr const char* ENV_RELAY_PORT_DEFAULT = "9010";
+
+		static constexpr const char* ENV_RELAY_WEBSOCKET_PORT = "SPN_RELAY_WEBSOCKET_PORT";
+		static constexpr const char* ENV_RELAY_WEBSOCKET_PORT_DEFAULT = "9011";
+
 		static const char* GetDefault(const char* env, const char* defaultValue)
 		{
 			const char* value = std::getenv(env);
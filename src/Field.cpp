@@ -19,6 +19,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 
 #include "Field.h"
 #include "Stopwatch.h"
@@ -26,9 +27,12 @@
 Field::Field(real_t w, real_t h, std::size_t food_parts, std::unique_ptr<UpdateTracker> update_tracker)
 	: m_width(w)
 	, m_height(h)
+	, m_torus(w, h)
 	, m_updateTracker(std::move(update_tracker))
 	, m_foodMap(static_cast<size_t>(w), static_cast<size_t>(h), config::SPATIAL_MAP_RESERVE_COUNT)
 	, m_segmentInfoMap(static_cast<size_t>(w), static_cast<size_t>(h), config::SPATIAL_MAP_RESERVE_COUNT)
+	, m_capsuleInfoMap(static_cast<size_t>(w), static_cast<size_t>(h),
+			config::COLLISION_USE_CAPSULES ? config::SPATIAL_MAP_RESERVE_COUNT : 0)
 	, m_threadPool(config::NTHREADS_BOT_THREAD_POOL)
 {
 	setupRandomness();
@@ -72,11 +76,167 @@ void Field::setupRandomness(void)
 void Field::updateSnakeSegmentMap()
 {
 	m_segmentInfoMap.clear();
+	m_segmentTileMaxReach.assign(SegmentInfoMap::getTileCount(), 0);
+	m_segmentReachGrowth = 0;
+
+	if(m_snakeBounds.size() < m_usedBotSlots.size()) {
+		m_snakeBounds.resize(m_usedBotSlots.size());
+	}
+
 	for (auto &b : m_bots)
 	{
-		for(auto &s : b->getSnake()->getSegments())
+		const Snake::SegmentList &segments = b->getSnake()->getSegments();
+		SnakeBounds &bounds = m_snakeBounds[b->getSlot()];
+
+		bounds.botGUID = b->getGUID();
+		bounds.min = segments[0].pos();
+		bounds.max = bounds.min;
+
+		real_t maxSegmentDistanceSquared = 0;
+		for(std::size_t i = 1; i < segments.size(); i++)
+		{
+			const Vector2D &pos = segments[i].pos();
+
+			bounds.min = bounds.min.cwiseMin(pos);
+			bounds.max = bounds.max.cwiseMax(pos);
+
+			maxSegmentDistanceSquared = std::max(maxSegmentDistanceSquared,
+					unwrapRelativeCoords(pos - segments[i-1].pos()).squaredNorm());
+		}
+
+		bounds.maxSegmentDistance = std::sqrt(maxSegmentDistanceSquared);
+		bounds.reach = getSegmentReach(*b->getSnake(), bounds.maxSegmentDistance);
+
+		for(auto &s : segments)
 		{
 			m_segmentInfoMap.addElement({s, b});
+
+			real_t &tileMaxReach = m_segmentTileMaxReach[m_segmentInfoMap.getTileIndex(s.pos())];
+			tileMaxReach = std::max(tileMaxReach, bounds.reach);
+		}
+	}
+}
+
+real_t Field::getSegmentReach(const Snake &snake, real_t maxSegmentDistance)
+{
+	// The move shifts the head by up to SNAKE_BOOST_STEPS steps and the
+	// other segments by a fraction of their spacing (pull-together). The
+	// storage of the old head may be reused by the first new segment, which
+	// is placed one segment distance ahead of the old second segment.
+	real_t spacing = std::max(maxSegmentDistance, snake.getTargetSegmentDistance());
+
+	return snake.getSegmentRadius()
+		+ config::SNAKE_BOOST_STEPS * config::SNAKE_DISTANCE_PER_STEP
+		+ (2 + config::SNAKE_PULL_FACTOR) * spacing;
+}
+
+void Field::updateSegmentReachGrowth(void)
+{
+	// Snakes may have grown by consuming food since the map update
+	m_segmentReachGrowth = 0;
+
+	for(auto &b : m_bots) {
+		uint32_t slot = b->getSlot();
+
+		if(slot >= m_snakeBounds.size() || m_snakeBounds[slot].botGUID != b->getGUID()) {
+			// not in the segment map
+			continue;
+		}
+
+		const SnakeBounds &bounds = m_snakeBounds[slot];
+		real_t reach = getSegmentReach(*b->getSnake(), bounds.maxSegmentDistance);
+
+		m_segmentReachGrowth = std::max(m_segmentReachGrowth, reach - bounds.reach);
+	}
+}
+
+bool Field::isInSegmentReach(const Bot &bot, const Vector2D &pos, real_t radius) const
+{
+	uint32_t slot = bot.getSlot();
+
+	if(slot >= m_snakeBounds.size() || m_snakeBounds[slot].botGUID != bot.getGUID()) {
+		return true;
+	}
+
+	const SnakeBounds &bounds = m_snakeBounds[slot];
+	real_t reach = std::max(bounds.reach, getSegmentReach(*bot.getSnake(), bounds.maxSegmentDistance));
+
+	return isInBounds(bounds, pos, radius + reach);
+}
+
+bool Field::isInCapsuleReach(const Bot &bot, const Vector2D &pos, real_t radius) const
+{
+	uint32_t slot = bot.getSlot();
+
+	if(slot >= m_capsuleBounds.size() || m_capsuleBounds[slot].botGUID != bot.getGUID()) {
+		return true;
+	}
+
+	// the capsule map is built right before the collision check
+	const SnakeBounds &bounds = m_capsuleBounds[slot];
+	return isInBounds(bounds, pos, radius + bounds.reach);
+}
+
+bool Field::isInBounds(const SnakeBounds &bounds, const Vector2D &pos, real_t margin) const
+{
+	// segments may have been wrapped to the other side of the field since
+	// the bounds were recorded, so the check is done on the torus
+	Vector2D halfSize = (bounds.max - bounds.min) / 2;
+	Vector2D relPos = unwrapRelativeCoords(pos - (bounds.min + halfSize));
+
+	return (std::fabs(relPos.x()) <= halfSize.x() + margin) &&
+	       (std::fabs(relPos.y()) <= halfSize.y() + margin);
+}
+
+void Field::updateSnakeCapsuleMap()
+{
+	m_capsuleInfoMap.clear();
+	m_capsuleTileMaxReach.assign(CapsuleInfoMap::getTileCount(), 0);
+	m_maxCapsuleReach = 0;
+
+	if(m_capsuleBounds.size() < m_usedBotSlots.size()) {
+		m_capsuleBounds.resize(m_usedBotSlots.size());
+	}
+
+	for (auto &b : m_bots)
+	{
+		const Snake &snake = *b->getSnake();
+		const Snake::SegmentList &segments = snake.getSegments();
+		real_t radius = snake.getSegmentRadius();
+
+		// the skeleton consists of every step-th segment and the last one
+		std::size_t step = static_cast<std::size_t>(
+				config::COLLISION_CAPSULE_LENGTH_FACTOR * radius / snake.getTargetSegmentDistance());
+		step = std::max<std::size_t>(step, 1);
+
+		SnakeBounds &bounds = m_capsuleBounds[b->getSlot()];
+
+		bounds.botGUID = b->getGUID();
+		bounds.min = segments[0].pos();
+		bounds.max = bounds.min;
+		bounds.maxSegmentDistance = 0;
+		bounds.reach = radius;
+
+		std::size_t last = segments.size() - 1;
+		for(std::size_t i = 0; i < last; i += step)
+		{
+			const Vector2D &start = segments[i].pos();
+			const Vector2D &end = segments[std::min(i + step, last)].pos();
+
+			Vector2D halfAxis = unwrapRelativeCoords(end - start) / 2;
+			Vector2D center = wrapCoords(start + halfAxis);
+
+			m_capsuleInfoMap.addElement({center, halfAxis, b});
+
+			real_t reach = radius + halfAxis.norm();
+			real_t &tileMaxReach = m_capsuleTileMaxReach[m_capsuleInfoMap.getTileIndex(center)];
+			tileMaxReach = std::max(tileMaxReach, reach);
+			m_maxCapsuleReach = std::max(m_maxCapsuleReach, reach);
+
+			// a capsule crossing the field border has ends on both sides, so
+			// the bounds of the ends span the field like those of the segments
+			bounds.min = bounds.min.cwiseMin(end);
+			bounds.max = bounds.max.cwiseMax(end);
 		}
 	}
 }
@@ -172,6 +332,7 @@ void Field::updateLimbo(void)
 			if (bot->init(initErrorMessage))
 			{
 				m_updateTracker->botLogMessage(bot->getViewerKey(), "starting bot");
+				bot->setSlot(allocateBotSlot());
 				m_updateTracker->botSpawned(bot);
 				m_bots.insert(bot);
 			}
@@ -229,31 +390,94 @@ void Field::removeFood()
 
 void Field::consumeFood(void)
 {
+	if(m_consumeCandidates.size() < m_usedBotSlots.size()) {
+		m_consumeCandidates.resize(m_usedBotSlots.size());
+	}
+
+	// first round: find the food in range of each bot
+	for(auto &b : m_bots) {
+		std::unique_ptr<BotThreadPool::Job> job(new BotThreadPool::Job(BotThreadPool::CollectFood, b));
+		m_threadPool.addJob(std::move(job));
+	}
+
+	m_threadPool.waitForCompletion();
+
+	std::vector< std::unique_ptr<BotThreadPool::Job> > tmpJobs;
+	tmpJobs.reserve(m_bots.size());
+
+	getProcessedJobsBySlot(tmpJobs);
+
+	// assign each food item to the first bot reaching it in slot order
 	size_t newStaticFood = 0;
-	for (auto &b: m_bots) {
-		auto headPos = b->getSnake()->getHeadPosition();
-		auto radius = b->getSnake()->getSegmentRadius() * config::SNAKE_CONSUME_RANGE;
+	for(auto &j : tmpJobs) {
+		std::vector<Food*> &candidates = m_consumeCandidates[j->bot->getSlot()];
+		std::size_t assigned = 0;
 
-		for (auto& fi: m_foodMap.getRegion(headPos, radius))
-		{
-			if (!fi.shallBeRemoved() && b->getSnake()->tryConsume(fi))
-			{
-				b->updateConsumeStats(fi);
-				m_updateTracker->foodConsumed(fi, b);
-				fi.markForRemove();
-				if (fi.shallRegenerate())
-				{
-					newStaticFood++;
-				}
+		for(Food *food : candidates) {
+			if(food->shallBeRemoved()) {
+				continue;
+			}
+
+			food->markForRemove();
+			if(food->shallRegenerate()) {
+				newStaticFood++;
 			}
+
+			candidates[assigned++] = food;
 		}
 
-		b->getSnake()->ensureSizeMatchesMass();
+		candidates.resize(assigned);
+	}
+
+	// second round: consume the assigned food
+	m_updateTracker->beginParallelEvents(m_threadPool.getThreadCount());
+
+	for(auto &j : tmpJobs) {
+		j->jobType = BotThreadPool::ConsumeFood;
+		m_threadPool.addJob(std::move(j));
 	}
+
+	m_threadPool.waitForCompletion();
+	m_updateTracker->endParallelEvents();
+
+	getProcessedJobsBySlot(tmpJobs);
+
 	createStaticFood(newStaticFood);
 	updateMaxSegmentRadius();
 }
 
+void Field::collectConsumableFood(BotThreadPool::Job &job)
+{
+	std::shared_ptr<Snake> snake = job.bot->getSnake();
+	std::vector<Food*> &candidates = m_consumeCandidates[job.bot->getSlot()];
+
+	candidates.clear();
+
+	auto headPos = snake->getHeadPosition();
+	auto radius = snake->getSegmentRadius() * config::SNAKE_CONSUME_RANGE;
+
+	for (auto& fi: m_foodMap.getRegion(headPos, radius))
+	{
+		if (!fi.shallBeRemoved() && snake->canConsume(fi))
+		{
+			candidates.push_back(&fi);
+		}
+	}
+}
+
+void Field::consumeCollectedFood(BotThreadPool::Job &job)
+{
+	std::shared_ptr<Snake> snake = job.bot->getSnake();
+
+	for(Food *food : m_consumeCandidates[job.bot->getSlot()]) {
+		snake->consume(*food);
+		job.bot->updateConsumeStats(*food);
+		m_updateTracker->foodConsumedParallel(job.worker, *food, job.bot);
+	}
+
+	snake->ensureSizeMatchesMass();
+}
+
 void Field::moveAllBots(void)
 {
 	Stopwatch swAll("all");
@@ -267,6 +491,21 @@ void Field::moveAllBots(void)
 	m_threadPool.waitForCompletion();
 	swMove.Stop();
 
+	// The segment map from the end of the last frame is used for the
+	// collision check. Its pruning data allows for the changes since then.
+	Stopwatch swMoveCollisionMap("move collision map");
+	if(config::COLLISION_USE_CAPSULES) {
+		// the capsules store copies of the positions, so their map is
+		// built after the move
+		updateSnakeCapsuleMap();
+#if DEBUG_COLLISION_MODEL
+		updateSegmentReachGrowth();
+#endif
+	} else {
+		updateSegmentReachGrowth();
+	}
+	swMoveCollisionMap.Stop();
+
 	// FIXME: make this work without temporary vector
 	std::vector< std::unique_ptr<BotThreadPool::Job> > tmpJobs;
 	tmpJobs.reserve(m_bots.size());
@@ -286,43 +525,74 @@ void Field::moveAllBots(void)
 	m_threadPool.waitForCompletion();
 	swCollisionCheck.Stop();
 
+	// process the results in slot order, independent of the thread timing
+	getProcessedJobsBySlot(tmpJobs);
 
-	// collision check for all bots
-	while((job = m_threadPool.getProcessedJob()) != NULL) {
-		std::shared_ptr<Bot> victim = job->bot;
-		std::size_t steps = job->steps;
+#if DEBUG_COLLISION_MODEL
+	if(config::COLLISION_USE_CAPSULES) {
+		printCollisionModelDeltas(tmpJobs);
+	}
+#endif
+
+	Stopwatch swFinishMove("finish move");
+	// third round: track the moves of the surviving bots
+	std::vector< std::pair<std::shared_ptr<Bot>, std::shared_ptr<Bot>> > kills;
 
-		std::shared_ptr<Bot> killer = job->killer;
+	m_updateTracker->beginParallelEvents(m_threadPool.getThreadCount());
+
+	for(auto &j : tmpJobs) {
+		std::shared_ptr<Bot> killer = j->killer;
 
 		if (killer) {
 			// size check on killer
 			double killerMass = killer->getSnake()->getMass();
-			double victimMass = victim->getSnake()->getMass();
+			double victimMass = j->bot->getSnake()->getMass();
 
 			if(killerMass > (victimMass * config::KILLER_MIN_MASS_RATIO)) {
 				// collision detected and killer is large enough
-				// -> convert the colliding bot to food
-				killBot(victim, killer);
+				kills.emplace_back(j->bot, killer);
+				continue;
 			}
-		} else {
-			// no collision, bot still alive
-			m_updateTracker->botMoved(victim, steps);
 
-			if(victim->getSnake()->boostedLastMove()) {
-				real_t lossValue =
-					config::SNAKE_BOOST_LOSS_FACTOR * victim->getSnake()->getMass();
+			// otherwise the bot survived and moved: viewers need the update,
+			// as protocol v2 encodes positions relative to the previous head
+		}
 
-				victim->getSnake()->dropFood(lossValue);
+		j->jobType = BotThreadPool::FinishMove;
+		m_threadPool.addJob(std::move(j));
+	}
 
-				if(victim->getSnake()->getMass() < config::SNAKE_SELF_KILL_MASS_THRESHOLD) {
-					// Bot is now too small, so it dies
-					killBot(victim, victim);
-				}
-			}
+	m_threadPool.waitForCompletion();
+	m_updateTracker->endParallelEvents();
+	swFinishMove.Stop();
 
-			// adjust size to new mass
-			victim->getSnake()->ensureSizeMatchesMass();
+	// convert the colliding bots to food
+	for(auto &kill : kills) {
+		killBot(kill.first, kill.second);
+	}
+
+	getProcessedJobsBySlot(tmpJobs);
+
+	// boosting bots without collision lose mass, which creates food
+	for(auto &j : tmpJobs) {
+		std::shared_ptr<Bot> victim = j->bot;
+
+		if(j->killer || !victim->getSnake()->boostedLastMove()) {
+			continue;
+		}
+
+		real_t lossValue =
+			config::SNAKE_BOOST_LOSS_FACTOR * victim->getSnake()->getMass();
+
+		victim->getSnake()->dropFood(lossValue);
+
+		if(victim->getSnake()->getMass() < config::SNAKE_SELF_KILL_MASS_THRESHOLD) {
+			// Bot is now too small, so it dies
+			killBot(victim, victim);
 		}
+
+		// adjust size to new mass
+		victim->getSnake()->ensureSizeMatchesMass();
 	}
 
 	// check for bots with excessive step errors and kill them
@@ -346,7 +616,9 @@ void Field::moveAllBots(void)
 #if DEBUG_TIMINGS
 	std::cout << std::endl << "Field::moveAllBots() timings:" << std::endl;
 	swMove.Print();
+	swMoveCollisionMap.Print();
 	swCollisionCheck.Print();
+	swFinishMove.Print();
 	swSegmentMap.Print();
 	swAll.Print();
 
@@ -364,6 +636,19 @@ void Field::moveAllBots(void)
 #endif
 }
 
+void Field::finishMove(BotThreadPool::Job &job)
+{
+	m_updateTracker->botMovedParallel(job.worker, job.bot, job.steps);
+
+	std::shared_ptr<Snake> snake = job.bot->getSnake();
+
+	// without collision, the size follows the mass; boosting bots adjust it
+	// after dropping food, which is done serially in moveAllBots()
+	if(!job.killer && !snake->boostedLastMove()) {
+		snake->ensureSizeMatchesMass();
+	}
+}
+
 void Field::sendAllLogMessages(const std::shared_ptr<Bot> &b)
 {
 	for (auto &msg: b->getLogMessages())
@@ -371,6 +656,8 @@ void Field::sendAllLogMessages(const std::shared_ptr<Bot> &b)
 		m_updateTracker->botLogMessage(b->getViewerKey(), msg);
 	}
 	b->clearLogMessages();
+
+	b->sendLogMessages(*m_updateTracker);
 }
 
 void Field::processLog()
@@ -454,65 +741,6 @@ void Field::createDynamicFood(real_t totalValue, const Vector2D &center, real_t
 	}
 }
 
-Vector2D Field::wrapCoords(const Vector2D &v) const
-{
-	real_t x = v.x();
-	real_t y = v.y();
-
-	while(x < 0) {
-		x += m_width;
-	}
-
-	while(x > m_width) {
-		x -= m_width;
-	}
-
-	while(y < 0) {
-		y += m_height;
-	}
-
-	while(y > m_height) {
-		y -= m_height;
-	}
-
-	return {x, y};
-}
-
-Vector2D Field::unwrapCoords(const Vector2D &v, const Vector2D &ref) const
-{
-	real_t x = v.x();
-	real_t y = v.y();
-
-	while((x - ref.x()) < -m_width/2) {
-		x += m_width;
-	}
-
-	while((x - ref.x()) > m_width/2) {
-		x -= m_width;
-	}
-
-	while((y - ref.y()) < -m_height/2) {
-		y += m_height;
-	}
-
-	while((y - ref.y()) > m_height/2) {
-		y -= m_height;
-	}
-
-	return {x, y};
-}
-
-Vector2D Field::unwrapRelativeCoords(const Vector2D& relativeCoords) const
-{
-	real_t x = fmod(relativeCoords.x(), m_width);
-	real_t y = fmod(relativeCoords.y(), m_height);
-	if (x > m_width/2) { x -= m_width; }
-	if (x < (-(int)m_width/2)) { x += m_width; }
-	if (y > m_height/2) { y -= m_height; }
-	if (y < (-(int)m_height/2)) { y += m_height; }
-	return Vector2D { x, y };
-}
-
 void Field::debugVisualization(void)
 {
 	size_t intW = static_cast<size_t>(m_width);
@@ -562,6 +790,68 @@ real_t Field::getMaxSegmentRadius(void) const
 	return m_maxSegmentRadius;
 }
 
+uint32_t Field::allocateBotSlot(void)
+{
+	for(uint32_t slot = 0; slot < m_usedBotSlots.size(); slot++) {
+		if(!m_usedBotSlots[slot]) {
+			m_usedBotSlots[slot] = true;
+			return slot;
+		}
+	}
+
+	m_usedBotSlots.push_back(true);
+	return m_usedBotSlots.size() - 1;
+}
+
+void Field::releaseBotSlot(uint32_t slot)
+{
+	m_usedBotSlots[slot] = false;
+}
+
+void Field::getProcessedJobsBySlot(std::vector< std::unique_ptr<BotThreadPool::Job> > &jobs)
+{
+	jobs.clear();
+
+	std::unique_ptr<BotThreadPool::Job> job;
+	while((job = m_threadPool.getProcessedJob()) != NULL) {
+		jobs.push_back(std::move(job));
+	}
+
+	std::sort(jobs.begin(), jobs.end(),
+		[](const std::unique_ptr<BotThreadPool::Job> &a, const std::unique_ptr<BotThreadPool::Job> &b) {
+			return a->bot->getSlot() < b->bot->getSlot();
+		});
+}
+
+void Field::printCollisionModelDeltas(const std::vector< std::unique_ptr<BotThreadPool::Job> > &jobs)
+{
+	std::size_t missed = 0;
+	std::size_t additional = 0;
+	std::size_t otherKiller = 0;
+
+	for(auto &job : jobs) {
+		std::shared_ptr<Bot> exactKiller = job->bot->checkSegmentCollision();
+
+		if(exactKiller == job->killer) {
+			continue;
+		}
+
+		if(!job->killer) {
+			missed++;
+		} else if(!exactKiller) {
+			additional++;
+		} else {
+			otherKiller++;
+		}
+	}
+
+	if(missed || additional || otherKiller) {
+		std::cout << "collision model deltas in frame " << m_currentFrame << ": "
+			<< missed << " missed, " << additional << " additional, "
+			<< otherKiller << " with a different killer" << std::endl;
+	}
+}
+
 void Field::addBotKilledCallback(Field::BotKilledCallback callback)
 {
 	m_botKilledCallbacks.push_back(callback);
@@ -571,6 +861,7 @@ void Field::killBot(std::shared_ptr<Bot> victim, std::shared_ptr<Bot> killer)
 {
 	victim->getSnake()->convertToFood(killer);
 	m_bots.erase(victim);
+	releaseBotSlot(victim->getSlot());
 	m_updateTracker->botKilled(killer, victim);
 
 	// send final log messages to viewer
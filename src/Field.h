@@ -19,6 +19,7 @@
 #pragma once
 
 #include <set>
+#include <limits>
 #include <memory>
 #include <random>
 
@@ -29,6 +30,7 @@
 #include "Bot.h"
 #include "UpdateTracker.h"
 #include "SpatialMap.h"
+#include "Torus.h"
 #include "BotThreadPool.h"
 #include "BotUpDownThread.h"
 
@@ -58,15 +60,44 @@ class Field
 		};
 		typedef SpatialMap<SnakeSegmentInfo, config::SPATIAL_MAP_TILES_X, config::SPATIAL_MAP_TILES_Y> SegmentInfoMap;
 
+		/*!
+		 * Capsule between two segments of a Snake's collision skeleton, see
+		 * config::COLLISION_USE_CAPSULES. The capsule radius is the segment
+		 * radius of the Snake.
+		 */
+		struct SnakeCapsuleInfo {
+			Vector2D center;   //!< Center of the axis, wrapped into the field
+			Vector2D halfAxis; //!< Vector from the center to the end of the axis
+			std::shared_ptr<Bot> bot; //!< The bot this capsule belongs to
+
+			const Vector2D& pos() const { return center; }
+		};
+		typedef SpatialMap<SnakeCapsuleInfo, config::SPATIAL_MAP_TILES_X, config::SPATIAL_MAP_TILES_Y> CapsuleInfoMap;
+
 		typedef SpatialMap<Food, config::SPATIAL_MAP_TILES_X, config::SPATIAL_MAP_TILES_Y> FoodMap;
 
+		/*!
+		 * Bounding box of the segment positions of a Snake at the last update
+		 * of the segment map. Snakes crossing the field border span the whole
+		 * field in that direction.
+		 */
+		struct SnakeBounds {
+			guid_t   botGUID = std::numeric_limits<guid_t>::max(); //!< The bot these bounds belong to
+			Vector2D min;
+			Vector2D max;
+			real_t   maxSegmentDistance = 0; //!< Largest distance between consecutive segments
+			real_t   reach = 0;              //!< getSegmentReach() at the map update
+		};
+
 	private:
 		const real_t m_width;
 		const real_t m_height;
+		const Torus m_torus;
 		real_t m_maxSegmentRadius = 0;
 		uint32_t m_currentFrame = 0;
 
 		BotSet  m_bots;
+		std::vector<bool> m_usedBotSlots; //!< Bot slots in use, see Bot::getSlot()
 
 		BotUpDownThread m_limbo;
 
@@ -82,14 +113,50 @@ class Field
 
 		FoodMap m_foodMap;
 		SegmentInfoMap m_segmentInfoMap;
+		std::vector<real_t> m_segmentTileMaxReach;  //!< Maximum getSegmentReach() by tile of m_segmentInfoMap
+		std::vector<SnakeBounds> m_snakeBounds;     //!< Bounds of all snakes in m_segmentInfoMap by bot slot
+		real_t m_segmentReachGrowth = 0;            //!< See updateSegmentReachGrowth()
+		CapsuleInfoMap m_capsuleInfoMap;
+		std::vector<real_t> m_capsuleTileMaxReach;  //!< Maximum distance of a capsule's surface from its center by tile of m_capsuleInfoMap
+		real_t m_maxCapsuleReach = 0;
+		std::vector<SnakeBounds> m_capsuleBounds;   //!< Bounds of all snakes in m_capsuleInfoMap by bot slot
 		std::vector<BotKilledCallback> m_botKilledCallbacks;
 		std::vector<BotErrorCallback> m_botErrorCallbacks;
 		BotThreadPool m_threadPool;
 
+		//! Food in consume range by bot slot, see consumeFood()
+		std::vector< std::vector<Food*> > m_consumeCandidates;
+
 		void setupRandomness(void);
 		void createStaticFood(std::size_t count);
 
 		void updateSnakeSegmentMap(void);
+		void updateSnakeCapsuleMap(void);
+
+		/*!
+		 * Determine by how much the getSegmentReach() of any Snake has grown
+		 * since the last update of the segment map.
+		 */
+		void updateSegmentReachGrowth(void);
+
+		/*!
+		 * Upper bound of the distance between the position of a segment at
+		 * the update of the segment map and its surface at the collision
+		 * check after the following move. The segment map stores references
+		 * to the segments, so the collision check sees them at their current
+		 * positions, which may be outside of their tile.
+		 *
+		 * \param snake                The Snake, with its current size.
+		 * \param maxSegmentDistance   Largest distance between consecutive
+		 *                             segments at the map update.
+		 */
+		static real_t getSegmentReach(const Snake &snake, real_t maxSegmentDistance);
+
+		/*!
+		 * Check on the torus whether the given position is within margin of
+		 * the bounding box.
+		 */
+		bool isInBounds(const SnakeBounds &bounds, const Vector2D &pos, real_t margin) const;
 		void updateMaxSegmentRadius(void);
 
 		bool isLocationOutsideSnakes(const Vector2D &pos, real_t margin = 10);
@@ -97,6 +164,22 @@ class Field
 
 		void sendAllLogMessages(const std::shared_ptr<Bot> &b);
 
+		uint32_t allocateBotSlot(void);
+		void releaseBotSlot(uint32_t slot);
+
+		/*!
+		 * Move all processed jobs from the thread pool to the given vector,
+		 * sorted by bot slot.
+		 */
+		void getProcessedJobsBySlot(std::vector< std::unique_ptr<BotThreadPool::Job> > &jobs);
+
+		/*!
+		 * Compare the results of the collision check jobs to the exact
+		 * collision model and print the differences to stdout. Requires
+		 * updateSegmentReachGrowth() to be called after the move.
+		 */
+		void printCollisionModelDeltas(const std::vector< std::unique_ptr<BotThreadPool::Job> > &jobs);
+
 	public:
 		Field(real_t w, real_t h, std::size_t food_parts, std::unique_ptr<UpdateTracker> update_tracker);
 
@@ -126,10 +209,26 @@ class Field
 		/*!
 		 * Make all Snakes consume food in their eating range.
 		 *
+		 * The bots are processed in the BotThreadPool. Food in range of
+		 * several bots goes to the bot with the lowest slot, so the result
+		 * is the same as consuming serially in slot order.
+		 *
 		 * \todo This function is searching for a better name.
 		 */
 		void consumeFood(void);
 
+		/*!
+		 * Part of consumeFood(), run in the BotThreadPool: find the food in
+		 * consume range of the job's bot.
+		 */
+		void collectConsumableFood(BotThreadPool::Job &job);
+
+		/*!
+		 * Part of consumeFood(), run in the BotThreadPool: consume the food
+		 * assigned to the job's bot and adjust the size of its Snake.
+		 */
+		void consumeCollectedFood(BotThreadPool::Job &job);
+
 		/*!
 		 * \brief remove decayed and consumed food
 		 */
@@ -140,6 +239,13 @@ class Field
 		 */
 		void moveAllBots(void);
 
+		/*!
+		 * Part of moveAllBots() for a bot that survived its move, run in the
+		 * BotThreadPool: track the move and adjust the size of the Snake,
+		 * unless it has to drop food for boosting first.
+		 */
+		void finishMove(BotThreadPool::Job &job);
+
 		/*!
 		 * \brief process bot log messages
 		 *
@@ -190,7 +296,7 @@ class Field
 		 * \param v    The vector to wrap.
 		 * \returns    A new vector containing the wrapped coordinates.
 		 */
-		Vector2D wrapCoords(const Vector2D &v) const;
+		Vector2D wrapCoords(const Vector2D &v) const { return m_torus.wrap(v); }
 
 		/*!
 		 * Unwrap the coordinates of the given vector with respect to a reference
@@ -205,9 +311,19 @@ class Field
 		 * \param ref  The reference vector.
 		 * \returns    A new vector containing the unwrapped coordinates.
 		 */
-		Vector2D unwrapCoords(const Vector2D &v, const Vector2D &ref) const;
+		Vector2D unwrapCoords(const Vector2D &v, const Vector2D &ref) const { return m_torus.unwrap(v, ref); }
 
-		Vector2D unwrapRelativeCoords(const Vector2D& relativeCoords) const;
+		/*!
+		 * Unwrap the difference of two positions such that it is the shortest
+		 * one in the wrapped space.
+		 */
+		Vector2D unwrapRelativeCoords(const Vector2D& relativeCoords) const { return m_torus.unwrapRelative(relativeCoords); }
+
+		/*!
+		 * Get the coordinate arithmetic of the field, e.g. for batch
+		 * operations.
+		 */
+		const Torus& getTorus(void) const { return m_torus; }
 
 		/*!
 		 * Print a text representation of the field for debugging to stdout.
@@ -227,6 +343,38 @@ class Field
 		FoodMap& getFoodMap() { return m_foodMap; }
 		SegmentInfoMap& getSegmentInfoMap() { return m_segmentInfoMap; }
 
+		/*!
+		 * Get the maximum distance from the given tile of the segment map
+		 * (see SpatialMap::getTileIndex()) at which the surface of one of its
+		 * segments may be during the collision check.
+		 */
+		real_t getSegmentTileMaxReach(std::size_t tileIndex) const { return m_segmentTileMaxReach[tileIndex] + m_segmentReachGrowth; }
+
+		CapsuleInfoMap& getCapsuleInfoMap() { return m_capsuleInfoMap; }
+
+		/*!
+		 * Get the maximum distance of a capsule's surface from its center in
+		 * the given tile of the capsule map, 0 for empty tiles.
+		 */
+		real_t getCapsuleTileMaxReach(std::size_t tileIndex) const { return m_capsuleTileMaxReach[tileIndex]; }
+
+		/*!
+		 * Get the maximum distance of a capsule's surface from its center.
+		 */
+		real_t getMaxCapsuleReach(void) const { return m_maxCapsuleReach; }
+
+		/*!
+		 * Check whether a circle with the given center and radius may touch
+		 * one of the given bot's segments in the segment map during the
+		 * collision check. Bots without recorded bounds are always in reach.
+		 */
+		bool isInSegmentReach(const Bot &bot, const Vector2D &pos, real_t radius) const;
+
+		/*!
+		 * The same as isInSegmentReach() for the capsule map.
+		 */
+		bool isInCapsuleReach(const Bot &bot, const Vector2D &pos, real_t radius) const;
+
 		void addBotKilledCallback(BotKilledCallback callback);
 		void killBot(std::shared_ptr<Bot> victim, std::shared_ptr<Bot> killer);
 
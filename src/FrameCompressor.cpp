@@ -0,0 +1,218 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <cstring>
+#include <ctime>
+
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "MsgPackProtocol.h"
+#include "MsgPackV2.h"
+
+#include "FrameCompressor.h"
+
+/*!
+ * An item list in the dictionary: message type and number of fields per
+ * item (0: the items are plain GUIDs).
+ */
+struct DictionaryEntry {
+	int      messageType;
+	uint32_t itemFields;
+};
+
+// ordered by frequency: deflate encodes matches near the end (closer to
+// the data) with fewer bits
+static const DictionaryEntry DICTIONARY_ENTRIES[] = {
+	{MsgPackProtocol::MESSAGE_TYPE_FOOD_DECAY, 0},
+	{MsgPackProtocol::MESSAGE_TYPE_FOOD_CONSUME, 2},
+	{MsgPackProtocol::MESSAGE_TYPE_FOOD_SPAWN, 4},
+	{MsgPackProtocol::MESSAGE_TYPE_BOT_STATS, 5},
+	{MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE_HEAD, 3},
+	{MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE, 4},
+};
+
+// item lists usually exceed 15 entries and are packed as array 16
+static const uint32_t TYPICAL_ITEM_COUNT = 16;
+
+// uint32 marker and high byte of a GUID below 2^24
+static const char GUID_PREFIX[] = {'\xce', 0};
+
+// high bytes of a length prefix below 64 KiB
+static const char LENGTH_PREFIX[] = {0, 0};
+
+static uint64_t getThreadCpuTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+std::string FrameCompressor::buildDictionary(void)
+{
+	MsgPackBuffer dictionary;
+	msgpack::packer<MsgPackBuffer> packer(dictionary);
+
+	// version 1: length prefix, [version, type, [items...]]
+	for(auto &entry: DICTIONARY_ENTRIES) {
+		dictionary.write(LENGTH_PREFIX, sizeof(LENGTH_PREFIX));
+		packer.pack_array(3);
+		packer.pack(MsgPackProtocol::PROTOCOL_VERSION);
+		packer.pack(entry.messageType);
+		packer.pack_array(TYPICAL_ITEM_COUNT);
+
+		if(entry.itemFields > 0) {
+			packer.pack_array(entry.itemFields);
+		}
+		dictionary.write(GUID_PREFIX, sizeof(GUID_PREFIX));
+	}
+
+	dictionary.write(LENGTH_PREFIX, sizeof(LENGTH_PREFIX));
+	packer.pack_array(3);
+	packer.pack(MsgPackProtocol::PROTOCOL_VERSION);
+	packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_TICK));
+
+	// version 2: [type, [items...]] within a frame
+	for(auto &entry: DICTIONARY_ENTRIES) {
+		packer.pack_array(2);
+		packer.pack(entry.messageType);
+		packer.pack_array(TYPICAL_ITEM_COUNT);
+
+		if(entry.itemFields > 0) {
+			packer.pack_array(entry.itemFields);
+		}
+		dictionary.write(GUID_PREFIX, sizeof(GUID_PREFIX));
+	}
+
+	// every frame starts with its header and the Tick message
+	MsgPackV2::beginFrame(dictionary);
+	packer.pack_array(2);
+	packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_TICK));
+
+	return std::move(dictionary.data);
+}
+
+void FrameCompressor::buildDictionaryFrames(void)
+{
+	// version 1: length-prefixed [version, type, dictionary]
+	MsgPackBuffer v1;
+	v1.data.append(sizeof(uint32_t), '\0');
+
+	msgpack::packer<MsgPackBuffer> v1Packer(v1);
+	v1Packer.pack_array(3);
+	v1Packer.pack(MsgPackProtocol::PROTOCOL_VERSION);
+	v1Packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_COMPRESSION_DICTIONARY));
+	v1Packer.pack_bin(m_dictionary.size());
+	v1Packer.pack_bin_body(m_dictionary.data(), m_dictionary.size());
+
+	uint32_t length = htonl(static_cast<uint32_t>(v1.data.size() - sizeof(uint32_t)));
+	memcpy(&v1.data[0], &length, sizeof(length));
+
+	// version 2: a frame with [type, dictionary]
+	MsgPackBuffer v2;
+	MsgPackV2::beginFrame(v2);
+
+	msgpack::packer<MsgPackBuffer> v2Packer(v2);
+	v2Packer.pack_array(2);
+	v2Packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_COMPRESSION_DICTIONARY));
+	v2Packer.pack_bin(m_dictionary.size());
+	v2Packer.pack_bin_body(m_dictionary.data(), m_dictionary.size());
+
+	MsgPackV2::endFrame(v2, 1);
+
+	m_dictionaryFrames[UpdateTracker::STREAM_V1] = std::make_shared<const std::string>(std::move(v1.data));
+	m_dictionaryFrames[UpdateTracker::STREAM_V2_MOVE] = std::make_shared<const std::string>(std::move(v2.data));
+	m_dictionaryFrames[UpdateTracker::STREAM_V2_MOVE_HEAD] = m_dictionaryFrames[UpdateTracker::STREAM_V2_MOVE];
+}
+
+FrameCompressor::FrameCompressor()
+	: m_dictionary(buildDictionary())
+{
+	buildDictionaryFrames();
+
+	memset(&m_stream, 0, sizeof(m_stream));
+
+	if(deflateInit(&m_stream, config::VIEWER_COMPRESSION_LEVEL) == Z_OK) {
+		m_initialized = true;
+	} else {
+		std::cerr << "FrameCompressor: deflateInit() failed, frames will not be compressed." << std::endl;
+	}
+}
+
+FrameCompressor::~FrameCompressor()
+{
+	if(m_initialized) {
+		deflateEnd(&m_stream);
+	}
+}
+
+FrameCompressor::Frame FrameCompressor::compress(const Frame &frame)
+{
+	if(!m_initialized) {
+		return frame;
+	}
+
+	uint64_t startTime = getThreadCpuTime();
+
+	deflateReset(&m_stream);
+	deflateSetDictionary(&m_stream, reinterpret_cast<const Bytef*>(m_dictionary.data()), m_dictionary.size());
+
+	std::shared_ptr<std::string> output = std::make_shared<std::string>();
+	output->resize(sizeof(uint32_t) + deflateBound(&m_stream, frame->size()));
+
+	m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(frame->data()));
+	m_stream.avail_in = frame->size();
+	m_stream.next_out = reinterpret_cast<Bytef*>(&(*output)[sizeof(uint32_t)]);
+	m_stream.avail_out = output->size() - sizeof(uint32_t);
+
+	int result = deflate(&m_stream, Z_FINISH);
+
+	Frame compressed = frame;
+	if(result == Z_STREAM_END) {
+		std::size_t length = m_stream.total_out;
+
+		if(sizeof(uint32_t) + length < frame->size()) {
+			uint32_t prefix = htonl(static_cast<uint32_t>(length) | COMPRESSED_FLAG);
+			memcpy(&(*output)[0], &prefix, sizeof(prefix));
+
+			output->resize(sizeof(uint32_t) + length);
+			compressed = output;
+		}
+	} else {
+		std::cerr << "FrameCompressor: deflate() failed: " << result << std::endl;
+	}
+
+	m_frames.fetch_add(1, std::memory_order_relaxed);
+	m_inputBytes.fetch_add(frame->size(), std::memory_order_relaxed);
+	m_outputBytes.fetch_add(compressed->size(), std::memory_order_relaxed);
+	m_cpuNanoseconds.fetch_add(getThreadCpuTime() - startTime, std::memory_order_relaxed);
+
+	return compressed;
+}
+
+FrameCompressor::Stats FrameCompressor::getStats(void) const
+{
+	Stats stats;
+	stats.frames = m_frames.load(std::memory_order_relaxed);
+	stats.inputBytes = m_inputBytes.load(std::memory_order_relaxed);
+	stats.outputBytes = m_outputBytes.load(std::memory_order_relaxed);
+	stats.cpuNanoseconds = m_cpuNanoseconds.load(std::memory_order_relaxed);
+	return stats;
+}
@@ -0,0 +1,94 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <zlib.h>
+
+#include "UpdateTracker.h"
+
+/*!
+ * \brief Compresses serialized frames for viewers that requested it.
+ *
+ * \details
+ * Each frame is compressed independently (zlib format), so the result can be
+ * shared by all compressed connections like the uncompressed frame. The
+ * output is a single length-prefixed block with the COMPRESSED_FLAG set in
+ * the length (see MsgPackProtocol). Frames that do not get smaller are
+ * returned unchanged.
+ *
+ * Single frames are short, so deflate is primed with a preset dictionary of
+ * the message and item headers that start almost every frame. The dictionary
+ * is fixed, so all connections still get the same bytes; viewers receive it
+ * with getDictionaryFrames() before the first compressed block.
+ *
+ * The deflate state is reused for all frames. Statistics are updated by the
+ * compressing thread and can be read from any thread.
+ */
+class FrameCompressor
+{
+	public:
+		typedef UpdateTracker::Frame Frame;
+		typedef UpdateTracker::FrameSet FrameSet;
+
+		//! Set in the length prefix of a compressed block
+		static constexpr const uint32_t COMPRESSED_FLAG = 0x80000000;
+
+		struct Stats {
+			uint64_t frames = 0;
+			uint64_t inputBytes = 0;
+			uint64_t outputBytes = 0;
+			uint64_t cpuNanoseconds = 0; //!< CPU time of the compressing thread
+		};
+
+		FrameCompressor();
+		~FrameCompressor();
+
+		FrameCompressor(const FrameCompressor&) = delete;
+		FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+		Frame compress(const Frame &frame);
+
+		/*!
+		 * The CompressionDictionary message in every stream format. It is
+		 * not compressed itself.
+		 */
+		const FrameSet& getDictionaryFrames(void) const { return m_dictionaryFrames; }
+
+		Stats getStats(void) const;
+
+	private:
+		z_stream m_stream;
+		bool     m_initialized = false;
+
+		std::string m_dictionary;
+		FrameSet    m_dictionaryFrames;
+
+		static std::string buildDictionary(void);
+		void buildDictionaryFrames(void);
+
+		std::atomic<uint64_t> m_frames{0};
+		std::atomic<uint64_t> m_inputBytes{0};
+		std::atomic<uint64_t> m_outputBytes{0};
+		std::atomic<uint64_t> m_cpuNanoseconds{0};
+};
@@ -0,0 +1,258 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "FrameTaskGraph.h"
+
+/* Private methods */
+
+long FrameTaskGraph::getRunTime(void) const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - m_runStart).count();
+}
+
+void FrameTaskGraph::work(std::unique_lock<std::mutex> &lock)
+{
+	while(m_finishedPhases < m_phases.size()) {
+		if(m_ready.empty()) {
+			m_cv.wait(lock);
+			continue;
+		}
+
+		// take the phase that was added first, as a serial run would
+		auto next = std::min_element(m_ready.begin(), m_ready.end());
+		std::size_t index = *next;
+		m_ready.erase(next);
+
+		Phase &phase = m_phases[index];
+
+		lock.unlock();
+
+		phase.timing.start = getRunTime();
+
+		std::exception_ptr error;
+		try {
+			phase.function();
+		} catch(...) {
+			error = std::current_exception();
+		}
+
+		phase.timing.end = getRunTime();
+
+		lock.lock();
+
+		if(error && !m_error) {
+			m_error = error;
+		}
+
+		m_finishedPhases++;
+
+		for(std::size_t dependent: phase.dependents) {
+			if(--m_phases[dependent].pendingDependencies == 0) {
+				m_ready.push_back(dependent);
+			}
+		}
+
+		m_cv.notify_all();
+	}
+}
+
+void FrameTaskGraph::findCriticalPath(void)
+{
+	long maxPathEnd = 0;
+	std::size_t last = 0;
+
+	// dependencies always have lower indices
+	for(std::size_t i = 0; i < m_phases.size(); i++) {
+		PhaseTiming &timing = m_phases[i].timing;
+
+		long pathStart = 0;
+		for(std::size_t dependency: m_phases[i].dependencies) {
+			pathStart = std::max(pathStart, m_phases[dependency].timing.pathEnd);
+		}
+
+		timing.pathEnd = pathStart + (timing.end - timing.start);
+		timing.critical = false;
+
+		if(timing.pathEnd >= maxPathEnd) {
+			maxPathEnd = timing.pathEnd;
+			last = i;
+		}
+	}
+
+	if(m_phases.empty()) {
+		return;
+	}
+
+	// walk back along the dependencies that finished last
+	std::size_t current = last;
+	while(true) {
+		Phase &phase = m_phases[current];
+		phase.timing.critical = true;
+
+		if(phase.dependencies.empty()) {
+			break;
+		}
+
+		current = *std::max_element(phase.dependencies.begin(), phase.dependencies.end(),
+				[this](std::size_t a, std::size_t b) {
+					return m_phases[a].timing.pathEnd < m_phases[b].timing.pathEnd;
+				});
+	}
+}
+
+/* Public methods */
+
+FrameTaskGraph::FrameTaskGraph(std::size_t threadCount)
+	: m_threads(threadCount)
+{
+	int threadnum = 0;
+	for(auto &thread: m_threads) {
+		thread = std::thread(
+					[this] ()
+					{
+						std::unique_lock<std::mutex> lock(m_mutex);
+						uint64_t lastRun = 0;
+
+						while(true) {
+							m_cv.wait(lock, [this, &lastRun]() {
+									return m_shutdown || (m_runCount != lastRun);
+								});
+
+							if(m_shutdown) {
+								break;
+							}
+
+							lastRun = m_runCount;
+							work(lock);
+						}
+					});
+
+		std::ostringstream namestream;
+		namestream << "frame_worker_" << (threadnum++);
+		pthread_setname_np(thread.native_handle(), namestream.str().c_str());
+	}
+}
+
+FrameTaskGraph::~FrameTaskGraph()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+
+	m_cv.notify_all();
+
+	for(auto &thread: m_threads) {
+		thread.join();
+	}
+}
+
+void FrameTaskGraph::addPhase(const std::string &name, ResourceSet reads, ResourceSet writes,
+		PhaseFunction function)
+{
+	Phase phase;
+	phase.name = name;
+	phase.reads = reads;
+	phase.writes = writes;
+	phase.function = function;
+
+	std::size_t index = m_phases.size();
+
+	for(std::size_t i = 0; i < index; i++) {
+		Phase &earlier = m_phases[i];
+
+		bool conflict =
+			(earlier.writes & (reads | writes)) ||
+			(earlier.reads & writes);
+
+		if(conflict) {
+			phase.dependencies.push_back(i);
+			earlier.dependents.push_back(index);
+		}
+	}
+
+	m_phases.push_back(std::move(phase));
+}
+
+void FrameTaskGraph::run(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_ready.clear();
+	for(std::size_t i = 0; i < m_phases.size(); i++) {
+		m_phases[i].pendingDependencies = m_phases[i].dependencies.size();
+
+		if(m_phases[i].pendingDependencies == 0) {
+			m_ready.push_back(i);
+		}
+	}
+
+	m_finishedPhases = 0;
+	m_error = nullptr;
+	m_runStart = std::chrono::steady_clock::now();
+	m_runCount++;
+
+	m_cv.notify_all();
+
+	work(lock);
+
+	m_runDuration = getRunTime();
+	findCriticalPath();
+
+	if(m_error) {
+		std::rethrow_exception(m_error);
+	}
+}
+
+void FrameTaskGraph::printTimings(void) const
+{
+	long total = 0;
+	long criticalPath = 0;
+
+	for(auto &phase: m_phases) {
+		long duration = phase.timing.end - phase.timing.start;
+
+		printf(
+			"%16s time: %6luus start: %6luus%s\n",
+			phase.name.c_str(),
+			duration / 1000,
+			phase.timing.start / 1000,
+			phase.timing.critical ? " (critical path)" : ""
+		);
+
+		total += duration;
+
+		if(phase.timing.critical) {
+			criticalPath += duration;
+		}
+	}
+
+	printf(
+		"%16s time: %6luus critical path: %6luus sum of phases: %6luus\n",
+		"FrameTaskGraph",
+		m_runDuration / 1000,
+		criticalPath / 1000,
+		total / 1000
+	);
+}
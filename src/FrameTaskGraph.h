@@ -0,0 +1,149 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief The phases of a frame with their data dependencies, executed on a
+ * set of worker threads.
+ *
+ * \details
+ * Each phase declares the resources it reads and writes as bit sets, the
+ * meaning of the bits is up to the user. A phase depends on every phase added
+ * before it that writes a resource it accesses or reads a resource it writes.
+ * Phases without such a conflict may run concurrently, so every run() has the
+ * same effect as running the phases in the order they were added, provided
+ * the declarations are complete.
+ *
+ * The calling thread and the worker threads take the ready phases in the
+ * order they were added. run() measures the wall clock time of each phase
+ * and determines the critical path: the chain of dependent phases that
+ * limits the duration of the run.
+ */
+class FrameTaskGraph
+{
+	public:
+		typedef uint32_t ResourceSet;
+		typedef std::function<void(void)> PhaseFunction;
+
+		/*!
+		 * Timing of a phase in the last run(). All times are in nanoseconds
+		 * since the start of the run.
+		 */
+		struct PhaseTiming {
+			long start = 0;
+			long end = 0;
+			long pathEnd = 0;      //!< End of the phase if every phase started as soon as its dependencies finished
+			bool critical = false; //!< Whether the phase is on the critical path
+		};
+
+	private:
+		struct Phase {
+			std::string              name;
+			ResourceSet              reads;
+			ResourceSet              writes;
+			PhaseFunction            function;
+			std::vector<std::size_t> dependencies;
+			std::vector<std::size_t> dependents;
+
+			std::size_t pendingDependencies = 0; //!< Unfinished dependencies in the current run
+			PhaseTiming timing;
+		};
+
+		std::vector<Phase> m_phases;
+
+		std::vector<std::thread> m_threads;
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+
+		// state of the current run, protected by m_mutex
+		uint64_t m_runCount = 0;
+		std::vector<std::size_t> m_ready;
+		std::size_t m_finishedPhases = 0;
+		std::exception_ptr m_error;
+		bool m_shutdown = false;
+
+		std::chrono::steady_clock::time_point m_runStart;
+		long m_runDuration = 0;
+
+		long getRunTime(void) const;
+
+		/*!
+		 * Execute ready phases until all phases of the current run are
+		 * finished.
+		 */
+		void work(std::unique_lock<std::mutex> &lock);
+
+		/*!
+		 * Determine PhaseTiming::pathEnd and PhaseTiming::critical from the
+		 * measured times.
+		 */
+		void findCriticalPath(void);
+
+	public:
+		/*!
+		 * \param threadCount   Number of worker threads in addition to the
+		 *                      thread calling run().
+		 */
+		FrameTaskGraph(std::size_t threadCount);
+		~FrameTaskGraph();
+
+		/*!
+		 * Add a phase. Phases cannot be added while run() is active.
+		 *
+		 * \param name       Name for the timing output.
+		 * \param reads      Resources the phase reads.
+		 * \param writes     Resources the phase writes (and maybe reads).
+		 * \param function   The work of the phase.
+		 */
+		void addPhase(const std::string &name, ResourceSet reads, ResourceSet writes,
+				PhaseFunction function);
+
+		/*!
+		 * Run all phases once and wait until they are finished. If a phase
+		 * throws an exception, the remaining phases are still run and the
+		 * first exception is rethrown afterwards.
+		 */
+		void run(void);
+
+		std::size_t getPhaseCount(void) const { return m_phases.size(); }
+		const std::string& getPhaseName(std::size_t phase) const { return m_phases[phase].name; }
+		const PhaseTiming& getPhaseTiming(std::size_t phase) const { return m_phases[phase].timing; }
+
+		/*!
+		 * Wall clock duration of the last run() in nanoseconds.
+		 */
+		long getRunDuration(void) const { return m_runDuration; }
+
+		/*!
+		 * Print the timings of the last run() to stdout: the duration and
+		 * start of each phase, with the phases on the critical path marked,
+		 * followed by the totals.
+		 */
+		void printTimings(void) const;
+};
@@ -25,36 +25,18 @@
 #include "config.h"
 #include "Environment.h"
 #include "debug_funcs.h"
-#include "MsgPackUpdateTracker.h"
-#include "Stopwatch.h"
+#include "MultiRateUpdateTracker.h"
 
 Game::Game()
+	: m_frameGraph(config::NTHREADS_FRAME_TASKS)
 {
+	std::unique_ptr<MultiRateUpdateTracker> updateTracker = std::make_unique<MultiRateUpdateTracker>();
+	m_updateTracker = updateTracker.get();
+
 	m_field = std::make_unique<Field>(
 		config::FIELD_SIZE_X, config::FIELD_SIZE_Y,
 		config::FIELD_STATIC_FOOD,
-		std::make_unique<MsgPackUpdateTracker>()
-	);
-
-	server.AddConnectionEstablishedListener(
-		[this](TcpSocket& socket)
-		{
-			return OnConnectionEstablished(socket);
-		}
-	);
-
-	server.AddConnectionClosedListener(
-		[this](TcpSocket& socket)
-		{
-			return OnConnectionClosed(socket);
-		}
-	);
-
-	server.AddDataAvailableListener(
-		[this](TcpSocket& socket)
-		{
-			return OnDataAvailable(socket);
-		}
+		std::move(updateTracker)
 	);
 
 	m_field->addBotKilledCallback(
@@ -90,119 +72,157 @@ Game::Game()
 			m_database->SetBotToCrashedState(failedBot->getDatabaseVersionId(), errorMessage);
 		}
 	);
+
+	setupFrameGraph();
 }
 
-bool Game::OnConnectionEstablished(TcpSocket &socket)
+void Game::updateKeyframe(void)
 {
-	std::cerr << "connection established to " << socket.GetPeer() << std::endl;
+	ViewerServer::FrameSet keyframe;
+	uint64_t keyframeFrameCount;
 
-	// send initial state
-	MsgPackUpdateTracker initTracker;
-	initTracker.gameInfo();
-	initTracker.worldState(*m_field);
-	socket.Write(initTracker.serialize());
+	if(m_keyframeBuilder.getResult(keyframe, keyframeFrameCount)) {
+		m_viewerServer.setKeyframe(keyframe, keyframeFrameCount);
 
-	socket.SetWriteBlocking(false);
+		if(m_recorder) {
+			m_recorder->recordKeyframe(keyframe, keyframeFrameCount);
+		}
+	}
 
-	return true;
+	uint64_t frame = m_field->getCurrentFrame();
+
+	// keyframes must coincide with an update of every rate
+	if((frame >= m_nextKeyframeFrame) && ((m_viewerServer.getFrameCount() % config::VIEWER_RATE_ALIGNMENT) == 0)) {
+		// the captured state includes all updates broadcast so far
+		if(m_keyframeBuilder.request(*m_field, m_viewerServer.getFrameCount())) {
+			m_nextKeyframeFrame = frame + config::VIEWER_KEYFRAME_INTERVAL;
+		}
+	}
 }
 
-bool Game::OnConnectionClosed(TcpSocket &socket)
+void Game::sendUpdate(void)
 {
-	std::cerr << "connection to " << socket.GetPeer() << " closed." << std::endl;
+	// send differential update to all connected clients
+	ViewerServer::FrameSet frames = m_updateTracker->serialize();
+	m_viewerServer.broadcast(frames);
+	if(m_recorder) {
+		m_recorder->recordFrames(frames, 1, m_viewerServer.getFrameCount());
+	}
 
-	return true;
+	m_viewerServer.updateAreasOfInterest(*m_field);
+	m_viewerServer.sendLogFrames(m_updateTracker->getLogFrames(), 1);
+
+	// lower rates: events merged over several frames
+	for(std::size_t framesPerUpdate = 2; framesPerUpdate <= config::VIEWER_MAX_FRAMES_PER_UPDATE; framesPerUpdate++) {
+		if((m_viewerServer.getFrameCount() % framesPerUpdate) == 0) {
+			ViewerServer::FrameSet aggregatedFrames = m_updateTracker->serializeAggregated(framesPerUpdate);
+			m_viewerServer.broadcastAggregated(aggregatedFrames, framesPerUpdate);
+			if(m_recorder) {
+				m_recorder->recordFrames(aggregatedFrames, framesPerUpdate, m_viewerServer.getFrameCount());
+			}
+
+			m_viewerServer.sendLogFrames(m_updateTracker->getAggregatedLogFrames(framesPerUpdate), framesPerUpdate);
+		}
+	}
+	updateKeyframe();
 }
 
-bool Game::OnDataAvailable(TcpSocket &socket)
+void Game::setupFrameGraph(void)
 {
-	char data[1024];
-	ssize_t count = socket.Read(data, sizeof(data));
-	if(count > 0) {
-		// return to sender
-		socket.Write(data, count, false);
-	}
-	return true;
+	// The phases in their logical order. Each one runs as soon as all earlier
+	// phases touching the same data are finished.
+
+	m_frameGraph.addPhase("DecayFood",
+		0,
+		RES_FOOD | RES_RANDOM | RES_EVENTS,
+		[this]() { m_field->decayFood(); });
+
+	m_frameGraph.addPhase("ConsumeFood",
+		RES_BOT_SET,
+		RES_FOOD | RES_BOTS | RES_RANDOM | RES_EVENTS | RES_THREAD_POOL,
+		[this]() { m_field->consumeFood(); });
+
+	m_frameGraph.addPhase("RemoveFood",
+		0,
+		RES_FOOD,
+		[this]() { m_field->removeFood(); });
+
+	// kills report to the database and shut down the bots
+	m_frameGraph.addPhase("MoveAllBots",
+		RES_FRAME,
+		RES_FOOD | RES_BOTS | RES_BOT_SET | RES_BOT_LOGS | RES_LIMBO | RES_RANDOM |
+			RES_EVENTS | RES_LOG_EVENTS | RES_THREAD_POOL | RES_DATABASE,
+		[this]() { m_field->moveAllBots(); });
+
+	m_frameGraph.addPhase("StreamStats",
+		RES_BOT_SET | RES_BOTS,
+		RES_EVENTS,
+		[this]() {
+			if(m_frameTime > m_nextStreamStatsUpdateTime) {
+				m_field->sendStatsToStream();
+				m_nextStreamStatsUpdateTime = m_frameTime + STREAM_STATS_UPDATE_INTERVAL;
+			}
+		});
+
+	// gathers the statistics, m_liveStatsWriter writes them in the background
+	m_frameGraph.addPhase("DbStats",
+		RES_BOT_SET | RES_BOTS | RES_FOOD | RES_LIMBO | RES_VIEWER,
+		RES_DB_STATS,
+		[this]() {
+			if(m_frameTime > m_nextDbStatsUpdateTime) {
+				updateDbStats(m_frameTime, m_frame);
+				m_nextDbStatsUpdateTime = m_frameTime + DB_STATS_UPDATE_INTERVAL;
+			}
+		});
+
+	m_frameGraph.addPhase("ProcessLog",
+		RES_BOT_SET,
+		RES_BOT_LOGS | RES_LOG_EVENTS,
+		[this]() { m_field->processLog(); });
+
+	m_frameGraph.addPhase("ProcessTick",
+		0,
+		RES_FRAME | RES_EVENTS,
+		[this]() { m_field->tick(); });
+
+	// started bots may fail, which is reported to the database
+	m_frameGraph.addPhase("Limbo",
+		0,
+		RES_BOTS | RES_BOT_SET | RES_BOT_LOGS | RES_LIMBO | RES_EVENTS | RES_LOG_EVENTS | RES_DATABASE,
+		[this]() { m_field->updateLimbo(); });
+
+	// serialization resets the tracker, keyframes capture the field
+	m_frameGraph.addPhase("SendUpdate",
+		RES_FRAME | RES_FOOD | RES_BOTS | RES_BOT_SET,
+		RES_EVENTS | RES_LOG_EVENTS | RES_VIEWER,
+		[this]() { sendUpdate(); });
+
+	// creates and kills bots
+	m_frameGraph.addPhase("QueryDB",
+		RES_FRAME,
+		RES_FOOD | RES_BOTS | RES_BOT_SET | RES_BOT_LOGS | RES_LIMBO | RES_RANDOM |
+			RES_EVENTS | RES_LOG_EVENTS | RES_DATABASE,
+		[this]() {
+			if (m_frameTime > m_nextDbQueryTime)
+			{
+				queryDB();
+				m_nextDbQueryTime = m_frameTime + DB_QUERY_INTERVAL;
+			}
+		});
 }
 
 void Game::ProcessOneFrame()
 {
 	// do all the game logic here and send updates to clients
-	auto frame = m_field->getCurrentFrame();
+	m_frame = m_field->getCurrentFrame();
+	m_frameTime = getCurrentTimestamp();
 
-	double now = getCurrentTimestamp();
-
-	Stopwatch swProcessFrame("ProcessFrame");
-
-	Stopwatch swDecayFood("DecayFood");
-	m_field->decayFood();
-	swDecayFood.Stop();
-
-	Stopwatch swConsumeFood("ConsumeFood");
-	m_field->consumeFood();
-	swConsumeFood.Stop();
-
-	Stopwatch swRemoveFood("RemoveFood");
-	m_field->removeFood();
-	swRemoveFood.Stop();
-
-	Stopwatch swMoveAllBots("MoveAllBots");
-	m_field->moveAllBots();
-	swMoveAllBots.Stop();
-
-	Stopwatch swProcessStats("ProcessStats");
-	if(now > m_nextStreamStatsUpdateTime) {
-		m_field->sendStatsToStream();
-		m_nextStreamStatsUpdateTime = now + STREAM_STATS_UPDATE_INTERVAL;
-	}
-	if(now > m_nextDbStatsUpdateTime) {
-		updateDbStats(now);
-		m_nextDbStatsUpdateTime = now + DB_STATS_UPDATE_INTERVAL;
-	}
-	swProcessStats.Stop();
-
-	Stopwatch swProcessLog("ProcessLog");
-	m_field->processLog();
-	swProcessLog.Stop();
-
-	Stopwatch swProcessTick("ProcessTick");
-	m_field->tick();
-	swProcessTick.Stop();
-
-	Stopwatch swLimbo("Limbo");
-	m_field->updateLimbo();
-	swLimbo.Stop();
-
-	Stopwatch swSendUpdate("SendUpdate");
-	// send differential update to all connected clients
-	std::string update = m_field->getUpdateTracker().serialize();
-	server.Broadcast(update);
-	swSendUpdate.Stop();
-
-	Stopwatch swQueryDB("QueryDB");
-	if (now > m_nextDbQueryTime)
-	{
-		queryDB();
-		m_nextDbQueryTime = now + DB_QUERY_INTERVAL;
-	}
-	swQueryDB.Stop();
-
-	swProcessFrame.Stop();
+	m_frameGraph.run();
 
 #if DEBUG_TIMINGS
 	std::cout << std::endl;
-	std::cout << "Frame " << frame << " timings: " << std::endl;
-	swDecayFood.Print();
-	swConsumeFood.Print();
-	swRemoveFood.Print();
-	swMoveAllBots.Print();
-	swProcessStats.Print();
-	swProcessLog.Print();
-	swProcessTick.Print();
-	swSendUpdate.Print();
-	swLimbo.Print();
-	swQueryDB.Print();
-	swProcessFrame.Print();
+	std::cout << "Frame " << m_frame << " timings: " << std::endl;
+	m_frameGraph.printTimings();
 	std::cout << std::endl;
 #endif
 }
@@ -212,7 +232,7 @@ int Game::Main()
 	// set up umask so we can create shared files for the bots
 	umask(0000);
 
-	if (!server.Listen(9010)) 
+	if (!m_viewerServer.listen(9010, config::VIEWER_WEBSOCKET_PORT))
 	{
 		return -1;
 	}
@@ -222,6 +242,19 @@ int Game::Main()
 		return -2;
 	}
 
+	std::string recordDirectory = Environment::GetDefault(Environment::ENV_RECORD_DIRECTORY, Environment::ENV_RECORD_DIRECTORY_DEFAULT);
+	if (!recordDirectory.empty())
+	{
+		try {
+			m_recorder = std::make_unique<StreamRecorder>(recordDirectory, FPS);
+		} catch(std::runtime_error &e) {
+			std::cerr << e.what() << std::endl;
+			return -3;
+		}
+
+		std::cerr << "Recording the game to " << m_recorder->getDirectory() << std::endl;
+	}
+
 	for (auto id: m_database->GetActiveBotIds())
 	{
 		createBot(id);
@@ -233,7 +266,6 @@ int Game::Main()
 	while(true)
 	{
 		ProcessOneFrame();
-		server.Poll(0);
 
 		waitForNextFrame();
 
@@ -278,7 +310,7 @@ double Game::getCurrentTimestamp(void)
 	return t.tv_sec + t.tv_nsec * 1e-9;
 }
 
-bool Game::connectDB()
+static std::unique_ptr<db::IDatabase> connectMysql(void)
 {
 	auto db = std::make_unique<db::MysqlDatabase>();
 	db->Connect(
@@ -287,7 +319,16 @@ bool Game::connectDB()
 		Environment::GetDefault(Environment::ENV_MYSQL_PASSWORD, Environment::ENV_MYSQL_PASSWORD_DEFAULT),
 		Environment::GetDefault(Environment::ENV_MYSQL_DB, Environment::ENV_MYSQL_DB_DEFAULT)
 	);
-	m_database = std::move(db);
+	return std::move(db);
+}
+
+bool Game::connectDB()
+{
+	m_database = connectMysql();
+
+	// the live stats are written from another thread, which needs its own
+	// connection
+	m_liveStatsWriter = std::make_unique<LiveStatsWriter>(connectMysql());
 	return true;
 }
 
@@ -364,7 +405,7 @@ void Game::createBot(int bot_id)
 	}
 }
 
-void Game::updateDbStats(double now)
+void Game::updateDbStats(double now, uint64_t frame)
 {
 	double fps;
 	uint64_t current_frame;
@@ -378,7 +419,7 @@ void Game::updateDbStats(double now)
 	 * Gather statistics
 	 */
 
-	current_frame = m_field->getCurrentFrame();
+	current_frame = frame;
 
 	if(m_lastFPSUpdateTime != 0) {
 		fps = (current_frame - m_lastFPSUpdateFrameCount) /
@@ -397,9 +438,30 @@ void Game::updateDbStats(double now)
 	m_field->getLimboStats(&start_queue_len, &stop_queue_len);
 
 	/*
-	 * Save to database
+	 * Save to database (in the background)
+	 */
+	m_liveStatsWriter->submit({fps, current_frame, running_bots,
+			static_cast<uint32_t>(start_queue_len), static_cast<uint32_t>(stop_queue_len),
+			living_mass, dead_mass});
+
+	/*
+	 * Viewer frame compression
 	 */
-	m_database->UpdateLiveStats(fps, current_frame, running_bots, start_queue_len, stop_queue_len, living_mass, dead_mass);
+	FrameCompressor::Stats compression = m_viewerServer.getCompressionStats();
+	uint64_t compressedFrames = compression.frames - m_lastCompressionStats.frames;
+
+	if(compressedFrames > 0) {
+		uint64_t inputBytes = compression.inputBytes - m_lastCompressionStats.inputBytes;
+		uint64_t outputBytes = compression.outputBytes - m_lastCompressionStats.outputBytes;
+		uint64_t cpuNanoseconds = compression.cpuNanoseconds - m_lastCompressionStats.cpuNanoseconds;
+
+		std::cerr << "Viewer compression: " << compressedFrames << " frames, "
+		          << inputBytes << " -> " << outputBytes << " bytes ("
+		          << (100.0 * outputBytes / inputBytes) << "%), "
+		          << (cpuNanoseconds / 1e6) << " ms CPU" << std::endl;
+	}
+
+	m_lastCompressionStats = compression;
 }
 
 void Game::Shutdown(void)
@@ -20,9 +20,13 @@
 
 #include <memory>
 
-#include <TcpServer/TcpServer.h>
-
+#include "FrameTaskGraph.h"
+#include "KeyframeBuilder.h"
+#include "LiveStatsWriter.h"
+#include "MultiRateUpdateTracker.h"
+#include "StreamRecorder.h"
 #include "UpdateTracker.h"
+#include "ViewerServer.h"
 #include "Field.h"
 #include "Database.h"
 
@@ -36,9 +40,32 @@ class Game
 
 		static constexpr const double FPS = 60.0;
 
-		TcpServer server;
+		/*!
+		 * Data accessed by the phases of a frame, see setupFrameGraph().
+		 */
+		enum FrameResource : FrameTaskGraph::ResourceSet {
+			RES_FOOD        = 1 << 0,  //!< Food map
+			RES_BOTS        = 1 << 1,  //!< State of the bots and their snakes
+			RES_BOT_SET     = 1 << 2,  //!< Set of living bots and their slots
+			RES_BOT_LOGS    = 1 << 3,  //!< Pending log messages and log credit of the bots
+			RES_LIMBO       = 1 << 4,  //!< Bots starting up or shutting down
+			RES_RANDOM      = 1 << 5,  //!< Random generator of the field
+			RES_EVENTS      = 1 << 6,  //!< Game events in the update tracker
+			RES_LOG_EVENTS  = 1 << 7,  //!< Log messages in the update tracker
+			RES_FRAME       = 1 << 8,  //!< Frame counter
+			RES_THREAD_POOL = 1 << 9,  //!< The field's BotThreadPool
+			RES_DATABASE    = 1 << 10, //!< Database connection
+			RES_VIEWER      = 1 << 11, //!< Viewer server, keyframe builder and recorder
+			RES_DB_STATS    = 1 << 12, //!< State of updateDbStats()
+		};
+
+		ViewerServer m_viewerServer;
+		KeyframeBuilder m_keyframeBuilder;
 		std::unique_ptr<Field> m_field;
+		MultiRateUpdateTracker *m_updateTracker; //!< Owned by m_field
 		std::unique_ptr<db::IDatabase> m_database;
+		std::unique_ptr<LiveStatsWriter> m_liveStatsWriter;
+		std::unique_ptr<StreamRecorder> m_recorder; //!< Only set if recording is enabled
 		double m_nextDbQueryTime = 0;
 		double m_nextStreamStatsUpdateTime = 0;
 		double m_nextDbStatsUpdateTime = 0;
@@ -46,8 +73,16 @@ class Game
 		double m_lastFPSUpdateTime = 0;
 		double m_lastFPSUpdateFrameCount = 0;
 
+		FrameCompressor::Stats m_lastCompressionStats;
+
 		double m_nextFrameTime = 0;
 
+		double m_frameTime = 0; //!< Timestamp of the current frame
+		uint64_t m_frame = 0;   //!< Number of the current frame before ProcessTick
+		FrameTaskGraph m_frameGraph;
+
+		uint64_t m_nextKeyframeFrame = 0;
+
 		bool m_shuttingDown = false;
 
 		void waitForNextFrame(void);
@@ -56,14 +91,28 @@ class Game
 		bool connectDB();
 		void queryDB();
 		void createBot(int bot_id);
-		void updateDbStats(double now);
+		void updateDbStats(double now, uint64_t frame);
+
+		/*!
+		 * Start building a new viewer keyframe when it is due and hand finished
+		 * keyframes to the viewer server.
+		 */
+		void updateKeyframe(void);
+
+		/*!
+		 * Send the updates of the current frame to the viewers and the
+		 * recorder.
+		 */
+		void sendUpdate(void);
+
+		/*!
+		 * Declare the phases of ProcessOneFrame() with the data they access.
+		 */
+		void setupFrameGraph(void);
 
 	public:
 		Game();
 
-		bool OnConnectionEstablished(TcpSocket &socket);
-		bool OnConnectionClosed(TcpSocket &socket);
-		bool OnDataAvailable(TcpSocket &socket);
 		void ProcessOneFrame();
 
 		int Main();
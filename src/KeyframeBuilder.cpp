@@ -0,0 +1,96 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+
+#include "MsgPackUpdateTracker.h"
+
+#include "KeyframeBuilder.h"
+
+KeyframeBuilder::KeyframeBuilder()
+{
+	m_thread = std::thread([this] () { run(); });
+
+	// remove this code if it does not compile on your system. It does not affect
+	// the program's functionality.
+	pthread_setname_np(m_thread.native_handle(), "keyframe");
+}
+
+KeyframeBuilder::~KeyframeBuilder()
+{
+	m_shutdown = true;
+	m_requestSemaphore.post();
+
+	m_thread.join();
+}
+
+bool KeyframeBuilder::request(Field &field, uint64_t sequence)
+{
+	if(m_busy) {
+		return false;
+	}
+
+	m_snapshot.capture(field);
+	m_snapshotSequence = sequence;
+
+	m_busy = true;
+	m_requestSemaphore.post();
+
+	return true;
+}
+
+bool KeyframeBuilder::getResult(ViewerServer::FrameSet &frames, uint64_t &sequence)
+{
+	std::lock_guard<std::mutex> guard(m_resultMutex);
+
+	if(!m_hasResult) {
+		return false;
+	}
+
+	frames = std::move(m_result);
+	sequence = m_resultSequence;
+
+	m_hasResult = false;
+	return true;
+}
+
+void KeyframeBuilder::run(void)
+{
+	MsgPackUpdateTracker tracker;
+
+	while(true) {
+		m_requestSemaphore.wait();
+
+		if(m_shutdown) {
+			break;
+		}
+
+		tracker.gameInfo();
+		tracker.worldState(m_snapshot);
+		ViewerServer::FrameSet frames = tracker.serialize();
+
+		{
+			std::lock_guard<std::mutex> guard(m_resultMutex);
+			m_result = frames;
+			m_resultSequence = m_snapshotSequence;
+			m_hasResult = true;
+		}
+
+		m_busy = false;
+	}
+}
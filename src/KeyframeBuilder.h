@@ -0,0 +1,83 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "Semaphore.h"
+#include "ViewerServer.h"
+#include "WorldSnapshot.h"
+
+class Field;
+
+/*!
+ * \brief Serializes keyframes for the viewers in a background thread.
+ *
+ * \details
+ * request() copies the world state into a WorldSnapshot on the calling (game)
+ * thread. Serializing the snapshot, which is the expensive part, runs in the
+ * builder thread. The finished keyframe is picked up with getResult().
+ *
+ * Only one keyframe is built at a time; requests while the builder is busy
+ * are rejected.
+ */
+class KeyframeBuilder
+{
+	public:
+		KeyframeBuilder();
+		~KeyframeBuilder();
+
+		/*!
+		 * \brief Start building a keyframe of the current world state.
+		 *
+		 * \param field     The Field to capture.
+		 * \param sequence  Sequence number identifying the state, returned
+		 *                  with the result.
+		 *
+		 * \returns  false if a keyframe is still being built.
+		 */
+		bool request(Field &field, uint64_t sequence);
+
+		/*!
+		 * \brief Get a finished keyframe.
+		 *
+		 * \returns  true if a new keyframe was stored in frames and sequence.
+		 */
+		bool getResult(ViewerServer::FrameSet &frames, uint64_t &sequence);
+
+	private:
+		std::thread m_thread;
+		Semaphore   m_requestSemaphore;
+
+		std::atomic<bool> m_busy{false};
+		std::atomic<bool> m_shutdown{false};
+
+		WorldSnapshot m_snapshot;           //!< Owned by the builder thread while m_busy is set
+		uint64_t      m_snapshotSequence = 0;
+
+		std::mutex          m_resultMutex;
+		ViewerServer::FrameSet m_result;
+		bool                   m_hasResult = false;
+		uint64_t            m_resultSequence = 0;
+
+		void run(void);
+};
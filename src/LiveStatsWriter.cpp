@@ -0,0 +1,78 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <stdexcept>
+
+#include "LiveStatsWriter.h"
+
+LiveStatsWriter::LiveStatsWriter(std::unique_ptr<db::IDatabase> database)
+	: m_database(std::move(database))
+{
+	m_thread = std::thread(&LiveStatsWriter::run, this);
+}
+
+LiveStatsWriter::~LiveStatsWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+
+	m_cv.notify_one();
+	m_thread.join();
+}
+
+void LiveStatsWriter::submit(const LiveStats &stats)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending = stats;
+		m_hasPending = true;
+	}
+
+	m_cv.notify_one();
+}
+
+void LiveStatsWriter::run(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while(true) {
+		m_cv.wait(lock, [this]() { return m_hasPending || m_shutdown; });
+
+		if(!m_hasPending) {
+			// shutdown without pending statistics
+			break;
+		}
+
+		LiveStats stats = m_pending;
+		m_hasPending = false;
+
+		lock.unlock();
+
+		try {
+			m_database->UpdateLiveStats(stats.fps, stats.currentFrame, stats.runningBots,
+					stats.startQueueLength, stats.stopQueueLength, stats.livingMass, stats.deadMass);
+		} catch(std::exception &e) {
+			std::cerr << "Writing live stats failed: " << e.what() << std::endl;
+		}
+
+		lock.lock();
+	}
+}
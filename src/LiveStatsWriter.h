@@ -0,0 +1,74 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Database.h"
+
+/*!
+ * \brief Writes the live statistics to the database in a background thread.
+ *
+ * \details
+ * The writer uses its own database connection, so the write does not block
+ * the frame. Only the latest statistics are kept: if the previous write is
+ * still in progress when new statistics arrive, the older pending ones are
+ * replaced.
+ */
+class LiveStatsWriter
+{
+	public:
+		struct LiveStats {
+			double   fps;
+			uint64_t currentFrame;
+			uint32_t runningBots;
+			uint32_t startQueueLength;
+			uint32_t stopQueueLength;
+			double   livingMass;
+			double   deadMass;
+		};
+
+	private:
+		std::unique_ptr<db::IDatabase> m_database;
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+
+		LiveStats m_pending;
+		bool m_hasPending = false;
+		bool m_shutdown = false;
+
+		void run(void);
+
+	public:
+		/*!
+		 * \param database   Connection used exclusively by the writer thread.
+		 */
+		LiveStatsWriter(std::unique_ptr<db::IDatabase> database);
+		~LiveStatsWriter();
+
+		/*!
+		 * Queue the given statistics for writing. Returns immediately.
+		 */
+		void submit(const LiveStats &stats);
+};
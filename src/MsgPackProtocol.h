@@ -27,6 +27,7 @@
 
 #include "Field.h"
 #include "Bot.h"
+#include "WorldSnapshot.h"
 
 namespace MsgPackProtocol
 {
@@ -34,6 +35,7 @@ namespace MsgPackProtocol
 	{
 		MESSAGE_TYPE_GAME_INFO = 0x00,
 		MESSAGE_TYPE_WORLD_UPDATE = 0x01,
+		MESSAGE_TYPE_COMPRESSION_DICTIONARY = 0x02,
 
 		MESSAGE_TYPE_TICK = 0x10,
 
@@ -43,16 +45,183 @@ namespace MsgPackProtocol
 		MESSAGE_TYPE_BOT_LOG = 0x23,
 		MESSAGE_TYPE_BOT_STATS = 0x24,
 		MESSAGE_TYPE_BOT_MOVE_HEAD = 0x25,
+		MESSAGE_TYPE_BOT_LEAVE = 0x26,
 
 		MESSAGE_TYPE_FOOD_SPAWN = 0x30,
 		MESSAGE_TYPE_FOOD_CONSUME = 0x31,
 		MESSAGE_TYPE_FOOD_DECAY = 0x32,
+		MESSAGE_TYPE_FOOD_LEAVE = 0x33,
+
+		MESSAGE_TYPE_RELAY_FRAME = 0x40,
 
 		MESSAGE_TYPE_PLAYER_INFO = 0xF0,
+
+		// sent by the viewer
+		MESSAGE_TYPE_CLIENT_HELLO = 0xF1,
+		MESSAGE_TYPE_SUBSCRIBE_AREA = 0xF2,
+		MESSAGE_TYPE_SUBSCRIBE_BOT = 0xF3,
+		MESSAGE_TYPE_UNSUBSCRIBE = 0xF4,
+		MESSAGE_TYPE_SUBSCRIBE_LOG = 0xF5,
+		MESSAGE_TYPE_UNSUBSCRIBE_LOG = 0xF6,
+		MESSAGE_TYPE_SET_RATE = 0xF7,
+		MESSAGE_TYPE_SET_COMPRESSION = 0xF8,
+		MESSAGE_TYPE_RELAY_HELLO = 0xF9,
 	};
 
 	static constexpr const uint8_t PROTOCOL_VERSION = 1;
 
+	/*
+	 * Bot logs
+	 *
+	 * BotLog messages are not broadcast. A viewer receives the log messages of
+	 * the bots with a given viewer key after subscribing to it (framed like the
+	 * ClientHello below, valid in both protocol versions):
+	 *
+	 *   [MESSAGE_TYPE_SUBSCRIBE_LOG, viewer_key]
+	 *   [MESSAGE_TYPE_UNSUBSCRIBE_LOG, viewer_key]
+	 *
+	 * The log messages of a frame arrive right after the frame, one BotLog
+	 * message (version 1) or frame (version 2) per subscribed viewer key.
+	 *
+	 * Update rate
+	 *
+	 * By default, a viewer receives an update every frame. It can select a
+	 * lower rate (both protocol versions):
+	 *
+	 *   [MESSAGE_TYPE_SET_RATE, frames_per_update]
+	 *
+	 * frames_per_update ranges from 1 to config::VIEWER_MAX_FRAMES_PER_UPDATE.
+	 * The viewer starts over with a keyframe, then each update contains the
+	 * merged events of that many frames: food that spawned and vanished in
+	 * between is omitted, bots that spawned in between are sent with their
+	 * current state, and the moves of a bot are combined into one with all
+	 * its head positions. Tick carries the last frame id.
+	 *
+	 * Compression
+	 *
+	 * A viewer can request compressed frames (both protocol versions):
+	 *
+	 *   [MESSAGE_TYPE_SET_COMPRESSION, compression]
+	 *
+	 * with compression being one of the Compression values. For
+	 * COMPRESSION_ZLIB, the server answers with the preset dictionary,
+	 * uncompressed:
+	 *
+	 *   [PROTOCOL_VERSION, MESSAGE_TYPE_COMPRESSION_DICTIONARY, dictionary] (version 1)
+	 *   [MESSAGE_TYPE_COMPRESSION_DICTIONARY, dictionary]                   (version 2)
+	 *
+	 * Afterwards, the server may send a frame (version 2) or the messages of a
+	 * frame (version 1) as one compressed block: a 32 bit big endian length
+	 * with the highest bit (0x80000000) set, followed by that many bytes of
+	 * zlib data. Each block is a complete zlib stream that refers to the
+	 * dictionary (binary) from the last CompressionDictionary message: pass
+	 * it to inflateSetDictionary() when inflate() returns Z_NEED_DICT. The
+	 * dictionary is the same for all viewers and does not change while the
+	 * server runs. The decompressed data is the uncompressed stream, i.e.
+	 * length-prefixed messages. Uncompressed messages (highest length bit
+	 * clear) may still occur, e.g. if compression does not pay off.
+	 */
+	enum Compression
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_ZLIB = 1,
+	};
+
+	/*
+	 * Relays
+	 *
+	 * A relay server registers with
+	 *
+	 *   [MESSAGE_TYPE_RELAY_HELLO]
+	 *
+	 * and then receives only RelayFrame messages:
+	 *
+	 *   [PROTOCOL_VERSION, MESSAGE_TYPE_RELAY_FRAME, kind, frames_per_update,
+	 *    frame_count, [stream_data, ...]]
+	 *
+	 * kind is one of RelayFrameKind. stream_data holds the serialized frame
+	 * (binary) in every stream format: version 1, version 2 with moves and
+	 * version 2 with head moves. frame_count is the number of full-rate
+	 * updates sent by the server so far (for a keyframe: when it was
+	 * captured).
+	 *
+	 * A relay starts with a RELAY_FRAME_RESYNC keyframe, followed by the
+	 * updates of all rates since then and afterwards as they are sent. Merged
+	 * updates (frames_per_update > 1) follow the full-rate update with the
+	 * same frame_count. Another RELAY_FRAME_RESYNC keyframe means the relay
+	 * fell behind and its stream starts over.
+	 */
+	enum RelayFrameKind
+	{
+		RELAY_FRAME_UPDATE = 0,   //!< Update at the given rate
+		RELAY_FRAME_KEYFRAME = 1, //!< Periodic keyframe for the relay's joining viewers
+		RELAY_FRAME_RESYNC = 2,   //!< Keyframe that replaces the relay's state
+	};
+
+	/*
+	 * Protocol version 2
+	 *
+	 * Viewers request version 2 by sending a ClientHello message (framed like
+	 * the server messages: 32 bit big endian length, then MsgPack):
+	 *
+	 *   [MESSAGE_TYPE_CLIENT_HELLO, protocol_version, move_encoding]
+	 *
+	 * The server then switches the connection to the requested format and
+	 * starts over with GameInfo and WorldUpdate. Viewers that never send a
+	 * ClientHello receive version 1.
+	 *
+	 * In version 2, each frame is a single length-prefixed MsgPack array
+	 *
+	 *   [PROTOCOL_VERSION_2, [message, message, ...]]
+	 *
+	 * and every message is an array starting with its type, without version.
+	 * Differences to version 1:
+	 *
+	 * - Bot and food ids are truncated to 32 bits (wrapping).
+	 * - Positions are fixed point integers: world coordinate multiplied by
+	 *   V2_POSITION_SCALE, in the range [0, world size * V2_POSITION_SCALE).
+	 * - Lists of positions are flat [x, y, x, y, ...] arrays. In BotSpawn and
+	 *   WorldUpdate, the first position (head) is absolute and each following
+	 *   one is relative to its predecessor. In BotMove and BotMoveHead, the
+	 *   first position is relative to the bot's previous head position.
+	 *   Relative positions take the shortest way around the torus, so the
+	 *   result must be wrapped into the world.
+	 * - Only one of BotMove and BotMoveHead is sent, as selected by
+	 *   move_encoding in the ClientHello.
+	 * - Masses and statistics are 32 bit floats.
+	 * - GameInfo has V2_POSITION_SCALE appended.
+	 *
+	 * Area of interest (version 2 only)
+	 *
+	 * A viewer can limit the stream to a part of the world:
+	 *
+	 *   [MESSAGE_TYPE_SUBSCRIBE_AREA, x, y, width, height]  fixed rectangle
+	 *   [MESSAGE_TYPE_SUBSCRIBE_BOT, bot_id, width, height] rectangle centered on
+	 *                                                       the bot's head
+	 *   [MESSAGE_TYPE_UNSUBSCRIBE]                          whole world again
+	 *
+	 * Coordinates are in world units. After subscribing, the viewer receives
+	 * GameInfo and a WorldUpdate with the entities in the area only. Each
+	 * following frame contains Tick, BotSpawn for bots entering the area, the
+	 * moves of the visible bots, FoodSpawn for food entering the area and
+	 *
+	 *   [MESSAGE_TYPE_BOT_LEAVE, [bot_id, ...]]
+	 *   [MESSAGE_TYPE_FOOD_LEAVE, [food_id, ...]]
+	 *
+	 * for entities that left the area or ceased to exist. Sending another
+	 * subscription moves the area; the changes arrive as enter and leave
+	 * messages.
+	 */
+	static constexpr const uint8_t PROTOCOL_VERSION_2 = 2;
+
+	static constexpr const int32_t V2_POSITION_SCALE = 16;
+
+	enum MoveEncoding
+	{
+		MOVE_ENCODING_MOVE = 0,      // BotMove: all segments
+		MOVE_ENCODING_MOVE_HEAD = 1, // BotMoveHead: head positions only
+	};
+
 	struct GameInfoMessage
 	{
 		double world_size_x = 0;
@@ -426,13 +595,13 @@ namespace msgpack {
 			{
 				template <typename Stream> msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, std::shared_ptr<Bot> const& v) const
 				{
+					const std::string &info = v->getPackedInfo();
+
 					o.pack_array(9);
 					o.pack(v->getGUID());
-					o.pack(v->getName());
-					o.pack(v->getDatabaseVersionId());
-					o.pack(v->getFace());
-					o.pack(v->getDogTag());
-					o.pack(v->getColors());
+					// name, database version, face, dog tag and colors;
+					// pack_bin_body() appends the encoded fields as they are
+					o.pack_bin_body(info.data(), info.size());
 					o.pack(v->getSnake()->getMass());
 					o.pack(v->getSnake()->getSegmentRadius());
 					o.pack(v->getSnake()->getSegments());
@@ -440,6 +609,35 @@ namespace msgpack {
 				}
 			};
 
+			// same layout as pack<Food>
+			template <> struct pack<WorldSnapshot::FoodEntry>
+			{
+				template <typename Stream> msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, WorldSnapshot::FoodEntry const& v) const
+				{
+					o.pack_array(4);
+					o.pack(v.guid);
+					o.pack(v.x);
+					o.pack(v.y);
+					o.pack(v.value);
+					return o;
+				}
+			};
+
+			// same layout as pack<std::shared_ptr<Bot>>
+			template <> struct pack<WorldSnapshot::BotEntry>
+			{
+				template <typename Stream> msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, WorldSnapshot::BotEntry const& v) const
+				{
+					o.pack_array(9);
+					o.pack(v.guid);
+					o.pack_bin_body(v.info.data(), v.info.size());
+					o.pack(v.mass);
+					o.pack(v.segmentRadius);
+					o.pack(v.segments);
+					return o;
+				}
+			};
+
 			template <> struct pack<MsgPackProtocol::BotLogMessage>
 			{
 				template <typename Stream> msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, MsgPackProtocol::BotLogMessage const& v) const
@@ -16,6 +16,9 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include <arpa/inet.h>
 
 #include "Bot.h"
@@ -27,12 +30,203 @@
 
 /* Private methods */
 
-void MsgPackUpdateTracker::appendMessage(const msgpack::sbuffer &buf)
+std::size_t MsgPackUpdateTracker::beginMessage(Buffer &out)
+{
+	std::size_t start = out.data.size();
+	out.data.append(sizeof(uint32_t), '\0');
+	return start;
+}
+
+void MsgPackUpdateTracker::endMessage(Buffer &out, std::size_t start)
+{
+	uint32_t length = htonl(static_cast<uint32_t>(out.data.size() - start - sizeof(uint32_t)));
+	memcpy(&out.data[start], &length, sizeof(length));
+}
+
+void MsgPackUpdateTracker::appendItemMessage(Buffer &out, int messageType, const ItemList &list)
+{
+	if(list.count == 0) {
+		return;
+	}
+
+	std::size_t start = beginMessage(out);
+
+	msgpack::packer<Buffer> packer(out);
+	packer.pack_array(3);
+	packer.pack(MsgPackProtocol::PROTOCOL_VERSION);
+	packer.pack(messageType);
+	packer.pack_array(list.count);
+
+	out.write(list.items.data.data(), list.items.data.size());
+
+	endMessage(out, start);
+}
+
+std::string& MsgPackUpdateTracker::getOutputBuffer(Stream stream)
+{
+	std::shared_ptr<std::string> &output = m_output[stream];
+
+	if(!output || (output.use_count() != 1)) {
+		output = std::make_shared<std::string>();
+	}
+
+	output->clear();
+	return *output;
+}
+
+void MsgPackUpdateTracker::writeV2Frame(std::string &out, uint32_t commonCount, int moveType, const ItemList &moveItems)
+{
+	Buffer frame;
+	frame.data.swap(out);
+
+	MsgPackV2::beginFrame(frame);
+	frame.write(m_v2Common.data.data(), m_v2Common.data.size());
+
+	uint32_t moveCount = appendV2ItemMessage(frame, moveType, moveItems);
+	MsgPackV2::endFrame(frame, commonCount + moveCount);
+
+	out.swap(frame.data);
+}
+
+void MsgPackUpdateTracker::serializeLogFrames(void)
+{
+	m_logFrames.clear();
+
+	for(auto it = m_botLogItems.begin(); it != m_botLogItems.end();) {
+		const ItemList &list = it->second;
+
+		if(list.count == 0) {
+			// no messages for this key in the last frame: release the buffer
+			it = m_botLogItems.erase(it);
+			continue;
+		}
+
+		LogFrame logFrame;
+		logFrame.viewerKey = it->first;
+
+		// encoded once per key, the version 2 streams differ in moves only
+		Buffer v1;
+		appendItemMessage(v1, MsgPackProtocol::MESSAGE_TYPE_BOT_LOG, list);
+		logFrame.frames[STREAM_V1] = std::make_shared<const std::string>(std::move(v1.data));
+
+		Buffer v2;
+		MsgPackV2::beginFrame(v2);
+		uint32_t count = appendV2ItemMessage(v2, MsgPackProtocol::MESSAGE_TYPE_BOT_LOG, list);
+		MsgPackV2::endFrame(v2, count);
+
+		logFrame.frames[STREAM_V2_MOVE] = std::make_shared<const std::string>(std::move(v2.data));
+		logFrame.frames[STREAM_V2_MOVE_HEAD] = logFrame.frames[STREAM_V2_MOVE];
+
+		m_logFrames.push_back(std::move(logFrame));
+		it++;
+	}
+}
+
+bool MsgPackUpdateTracker::MergeEntry::operator<(const MergeEntry &other) const
+{
+	if(key != other.key) {
+		return key < other.key;
+	}
+
+	if(worker != other.worker) {
+		return worker < other.worker;
+	}
+
+	return item < other.item;
+}
+
+void MsgPackUpdateTracker::mergeWorkerItems(ItemList &out, KeyedItemList WorkerItems::*list)
+{
+	m_mergeOrder.clear();
+
+	for(std::size_t worker = 0; worker < m_workerItems.size(); worker++) {
+		const KeyedItemList &items = m_workerItems[worker].*list;
+
+		for(std::size_t i = 0; i < items.index.size(); i++) {
+			m_mergeOrder.push_back({items.index[i].key, static_cast<uint32_t>(worker), static_cast<uint32_t>(i)});
+		}
+	}
+
+	std::sort(m_mergeOrder.begin(), m_mergeOrder.end());
+
+	for(auto &entry: m_mergeOrder) {
+		const KeyedItemList &items = m_workerItems[entry.worker].*list;
+
+		std::size_t begin = items.index[entry.item].offset;
+		std::size_t end = (entry.item + 1 < items.index.size()) ?
+			items.index[entry.item + 1].offset : items.items.data.size();
+
+		out.items.write(items.items.data.data() + begin, end - begin);
+		out.count++;
+	}
+}
+
+void MsgPackUpdateTracker::packFoodConsumed(Buffer &v1, Buffer &v2,
+		const Food &food, const std::shared_ptr<Bot> &by_bot)
+{
+	// same layout as MsgPackProtocol::FoodConsumeItem
+	msgpack::packer<Buffer> packer(v1);
+	packer.pack_array(2);
+	packer.pack(food.getGUID());
+	packer.pack(by_bot->getGUID());
+
+	msgpack::packer<Buffer> v2Packer(v2);
+	v2Packer.pack_array(2);
+	v2Packer.pack(static_cast<uint32_t>(food.getGUID()));
+	v2Packer.pack(static_cast<uint32_t>(by_bot->getGUID()));
+}
+
+void MsgPackUpdateTracker::packBotMoved(Buffer &v1Move, Buffer &v1MoveHead, Buffer &v2Move, Buffer &v2MoveHead,
+		const std::shared_ptr<Bot> &bot, std::size_t steps,
+		const Snake::PositionList &headPositions)
+{
+	const Snake::SegmentList &segments = bot->getSnake()->getSegments();
+
+	// same layout as MsgPackProtocol::BotMoveItem
+	{
+		msgpack::packer<Buffer> packer(v1Move);
+		packer.pack_array(4);
+		packer.pack(bot->getGUID());
+		packer.pack_array(steps);
+		for(std::size_t i = 0; i < steps; i++) {
+			packer.pack(segments[i]);
+		}
+		packer.pack(static_cast<uint32_t>(segments.size()));
+		packer.pack(static_cast<uint32_t>(bot->getSnake()->getSegmentRadius()));
+	}
+
+	// same layout as MsgPackProtocol::BotMoveHeadItem
+	{
+		msgpack::packer<Buffer> packer(v1MoveHead);
+		packer.pack_array(3);
+		packer.pack(bot->getGUID());
+		packer.pack(static_cast<double>(bot->getSnake()->getMass()));
+		packer.pack(headPositions);
+	}
+
+	// version 2: positions relative to the previous head
+	MsgPackV2::FixedPoint &previousHead = m_v2HeadPositions[bot->getSlot()];
+
+	{
+		msgpack::packer<Buffer> packer(v2Move);
+		MsgPackV2::packMoveItem(packer, bot, steps, previousHead);
+	}
+
+	{
+		msgpack::packer<Buffer> packer(v2MoveHead);
+		MsgPackV2::packMoveHeadItem(packer, bot, headPositions, previousHead);
+	}
+
+	previousHead = MsgPackV2::toFixedPoint(segments[0].pos());
+}
+
+void MsgPackUpdateTracker::beginV2Message(int messageType, uint32_t fieldCount)
 {
-	uint32_t length = htonl(static_cast<uint32_t>(buf.size()));
+	msgpack::packer<Buffer> packer(m_v2Messages);
+	packer.pack_array(fieldCount + 1);
+	packer.pack(messageType);
 
-	m_stream.write(reinterpret_cast<char*>(&length), sizeof(length));
-	m_stream.write(buf.data(), buf.size());
+	m_v2MessageCount++;
 }
 
 /* Public methods */
@@ -45,17 +239,36 @@ MsgPackUpdateTracker::MsgPackUpdateTracker()
 void MsgPackUpdateTracker::foodConsumed(const Food &food,
 		const std::shared_ptr<Bot> &by_bot)
 {
-	m_foodConsumeMessage->items.push_back({food.getGUID(), by_bot->getGUID()});
+	packFoodConsumed(m_foodConsumeItems.items, m_v2FoodConsumeItems.items, food, by_bot);
+
+	m_foodConsumeItems.count++;
+	m_v2FoodConsumeItems.count++;
 }
 
 void MsgPackUpdateTracker::foodDecayed(const Food &food)
 {
-	m_foodDecayMessage->food_ids.push_back(food.getGUID());
+	msgpack::packer<Buffer> packer(m_foodDecayItems.items);
+	packer.pack(food.getGUID());
+
+	m_foodDecayItems.count++;
+
+	msgpack::packer<Buffer> v2Packer(m_v2FoodDecayItems.items);
+	v2Packer.pack(static_cast<uint32_t>(food.getGUID()));
+
+	m_v2FoodDecayItems.count++;
 }
 
 void MsgPackUpdateTracker::foodSpawned(const Food &food)
 {
-	m_foodSpawnMessage->new_food.push_back(food);
+	msgpack::packer<Buffer> packer(m_foodSpawnItems.items);
+	packer.pack(food);
+
+	m_foodSpawnItems.count++;
+
+	msgpack::packer<Buffer> v2Packer(m_v2FoodSpawnItems.items);
+	MsgPackV2::packFood(v2Packer, food);
+
+	m_v2FoodSpawnItems.count++;
 }
 
 void MsgPackUpdateTracker::botSpawned(const std::shared_ptr<Bot> &bot)
@@ -63,9 +276,19 @@ void MsgPackUpdateTracker::botSpawned(const std::shared_ptr<Bot> &bot)
 	MsgPackProtocol::BotSpawnMessage msg;
 	msg.bot = bot;
 
-	msgpack::sbuffer buf;
-	msgpack::pack(buf, msg);
-	appendMessage(buf);
+	appendMessage(msg);
+
+	beginV2Message(MsgPackProtocol::MESSAGE_TYPE_BOT_SPAWN, 1);
+	msgpack::packer<Buffer> v2Packer(m_v2Messages);
+	MsgPackV2::packBot(v2Packer, bot);
+
+	// reference for the relative positions of the following moves
+	uint32_t slot = bot->getSlot();
+	if(slot >= m_v2HeadPositions.size()) {
+		m_v2HeadPositions.resize(slot + 1);
+	}
+
+	m_v2HeadPositions[slot] = MsgPackV2::toFixedPoint(bot->getSnake()->getHeadPosition());
 }
 
 void MsgPackUpdateTracker::botKilled(
@@ -76,9 +299,12 @@ void MsgPackUpdateTracker::botKilled(
 	msg.killer_id = killer->getGUID();
 	msg.victim_id = victim->getGUID();
 
-	msgpack::sbuffer buf;
-	msgpack::pack(buf, msg);
-	appendMessage(buf);
+	appendMessage(msg);
+
+	beginV2Message(MsgPackProtocol::MESSAGE_TYPE_BOT_KILL, 2);
+	msgpack::packer<Buffer> v2Packer(m_v2Messages);
+	v2Packer.pack(static_cast<uint32_t>(msg.killer_id));
+	v2Packer.pack(static_cast<uint32_t>(msg.victim_id));
 
 	if (msg.killer_id == msg.victim_id)
 	{
@@ -93,31 +319,44 @@ void MsgPackUpdateTracker::botKilled(
 
 void MsgPackUpdateTracker::botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps)
 {
-	// Fill BotMoveMessage
-	MsgPackProtocol::BotMoveItem item;
-
-	const Snake::SegmentList &segments = bot->getSnake()->getSegments();
-
-	item.bot_id = bot->getGUID();
-	item.new_segments.assign(segments.begin(), segments.begin() + steps);
-	item.current_segment_radius = bot->getSnake()->getSegmentRadius();
-	item.current_length = segments.size();
-
-	m_botMoveMessage->items.push_back(item);
+	botMoved(bot, steps, bot->getSnake()->getHeadPositionsDuringLastMove());
+}
 
-	// Fill BotMoveHeadMessage
-	MsgPackProtocol::BotMoveHeadItem headItem;
+void MsgPackUpdateTracker::botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps,
+		const Snake::PositionList &headPositions)
+{
+	uint32_t slot = bot->getSlot();
+	if(slot >= m_v2HeadPositions.size()) {
+		m_v2HeadPositions.resize(slot + 1, MsgPackV2::toFixedPoint(bot->getSnake()->getHeadPosition()));
+	}
 
-	headItem.bot_id = bot->getGUID();
-	headItem.mass = bot->getSnake()->getMass();
-	headItem.new_head_positions = bot->getSnake()->getHeadPositionsDuringLastMove();
+	packBotMoved(m_botMoveItems.items, m_botMoveHeadItems.items,
+			m_v2BotMoveItems.items, m_v2BotMoveHeadItems.items,
+			bot, steps, headPositions);
 
-	m_botMoveHeadMessage->items.push_back(headItem);
+	m_botMoveItems.count++;
+	m_botMoveHeadItems.count++;
+	m_v2BotMoveItems.count++;
+	m_v2BotMoveHeadItems.count++;
 }
 
 void MsgPackUpdateTracker::botLogMessage(uint64_t viewerKey, const std::string& message)
 {
-	m_botLogMessage->items.push_back({viewerKey, message});
+	botLogMessage(viewerKey, message.data(), message.size());
+}
+
+void MsgPackUpdateTracker::botLogMessage(uint64_t viewerKey, const char *message, std::size_t length)
+{
+	ItemList &list = m_botLogItems[viewerKey];
+
+	// same layout as MsgPackProtocol::BotLogItem
+	msgpack::packer<Buffer> packer(list.items);
+	packer.pack_array(2);
+	packer.pack(viewerKey);
+	packer.pack_str(length);
+	packer.pack_str_body(message, length);
+
+	list.count++;
 }
 
 void MsgPackUpdateTracker::gameInfo(void)
@@ -133,116 +372,199 @@ void MsgPackUpdateTracker::gameInfo(void)
 	msg.snake_segment_distance_exponent = config::SNAKE_SEGMENT_DISTANCE_EXPONENT;
 	msg.snake_pull_factor               = config::SNAKE_PULL_FACTOR;
 
-	msgpack::sbuffer buf;
-	msgpack::pack(buf, msg);
-	appendMessage(buf);
+	appendMessage(msg);
+
+	msgpack::packer<Buffer> v2Packer(m_v2Messages);
+	MsgPackV2::packGameInfo(v2Packer);
+	m_v2MessageCount++;
 }
 
 void MsgPackUpdateTracker::worldState(Field& field)
 {
-	MsgPackProtocol::WorldUpdateMessage msg;
+	WorldSnapshot snapshot;
+	snapshot.capture(field);
 
-	msg.bots = field.getBots();
+	worldState(snapshot);
+}
 
-	msg.food.reserve(1024);
-	for (auto& food: field.getFoodMap()) // TODO directly serialize FoodMap
-	{
-		msg.food.push_back(food);
+void MsgPackUpdateTracker::worldState(const WorldSnapshot &snapshot)
+{
+	// same layout as MsgPackProtocol::WorldUpdateMessage
+	std::size_t start = beginMessage(m_frame);
+
+	msgpack::packer<Buffer> packer(m_frame);
+	packer.pack_array(4);
+	packer.pack(MsgPackProtocol::PROTOCOL_VERSION);
+	packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_WORLD_UPDATE));
+	packer.pack(snapshot.getBots());
+	packer.pack(snapshot.getFood());
+
+	endMessage(m_frame, start);
+
+	beginV2Message(MsgPackProtocol::MESSAGE_TYPE_WORLD_UPDATE, 2);
+	msgpack::packer<Buffer> v2Packer(m_v2Messages);
+
+	v2Packer.pack_array(snapshot.getBots().size());
+	for(auto &bot: snapshot.getBots()) {
+		MsgPackV2::packBot(v2Packer, bot);
 	}
 
-	msgpack::sbuffer buf;
-	msgpack::pack(buf, msg);
-	appendMessage(buf);
+	v2Packer.pack_array(snapshot.getFood().size());
+	for(auto &food: snapshot.getFood()) {
+		MsgPackV2::packFood(v2Packer, food);
+	}
 }
 
 void MsgPackUpdateTracker::tick(uint64_t frame_id)
 {
 	MsgPackProtocol::TickMessage msg;
 	msg.frame_id = frame_id;
-	msgpack::sbuffer buf;
-	msgpack::pack(buf, msg);
-	appendMessage(buf);
+
+	appendMessage(msg);
+
+	beginV2Message(MsgPackProtocol::MESSAGE_TYPE_TICK, 1);
+	msgpack::packer<Buffer> v2Packer(m_v2Messages);
+	v2Packer.pack(frame_id);
 }
 
 void MsgPackUpdateTracker::botStats(const std::shared_ptr<Bot> &bot)
 {
-	MsgPackProtocol::BotStatsItem item;
+	// same layout as MsgPackProtocol::BotStatsItem
+	msgpack::packer<Buffer> packer(m_botStatsItems.items);
+	packer.pack_array(5);
+	packer.pack(bot->getGUID());
+	packer.pack(static_cast<double>(bot->getConsumedNaturalFood()));
+	packer.pack(static_cast<double>(bot->getConsumedFoodHuntedByOthers()));
+	packer.pack(static_cast<double>(bot->getConsumedFoodHuntedBySelf()));
+	packer.pack(static_cast<double>(bot->getSnake()->getMass()));
+
+	m_botStatsItems.count++;
+
+	msgpack::packer<Buffer> v2Packer(m_v2BotStatsItems.items);
+	v2Packer.pack_array(5);
+	v2Packer.pack(static_cast<uint32_t>(bot->getGUID()));
+	v2Packer.pack(static_cast<float>(bot->getConsumedNaturalFood()));
+	v2Packer.pack(static_cast<float>(bot->getConsumedFoodHuntedByOthers()));
+	v2Packer.pack(static_cast<float>(bot->getConsumedFoodHuntedBySelf()));
+	v2Packer.pack(static_cast<float>(bot->getSnake()->getMass()));
+
+	m_v2BotStatsItems.count++;
+}
+
+UpdateTracker::FrameSet MsgPackUpdateTracker::serialize(void)
+{
+	FrameSet frames;
+
+	// protocol version 1
+	appendItemMessage(m_frame, MsgPackProtocol::MESSAGE_TYPE_FOOD_DECAY, m_foodDecayItems);
+	appendItemMessage(m_frame, MsgPackProtocol::MESSAGE_TYPE_FOOD_SPAWN, m_foodSpawnItems);
+	appendItemMessage(m_frame, MsgPackProtocol::MESSAGE_TYPE_FOOD_CONSUME, m_foodConsumeItems);
+	appendItemMessage(m_frame, MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE, m_botMoveItems);
+	appendItemMessage(m_frame, MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE_HEAD, m_botMoveHeadItems);
+	appendItemMessage(m_frame, MsgPackProtocol::MESSAGE_TYPE_BOT_STATS, m_botStatsItems);
+
+	// swap instead of copy: both buffers keep their capacity
+	getOutputBuffer(STREAM_V1).swap(m_frame.data);
+	frames[STREAM_V1] = m_output[STREAM_V1];
+
+	// protocol version 2: everything except the moves is common to all streams
+	m_v2Common.data.clear();
+	m_v2Common.write(m_v2Messages.data.data(), m_v2Messages.data.size());
+
+	uint32_t commonCount = m_v2MessageCount;
+	commonCount += appendV2ItemMessage(m_v2Common, MsgPackProtocol::MESSAGE_TYPE_FOOD_DECAY, m_v2FoodDecayItems);
+	commonCount += appendV2ItemMessage(m_v2Common, MsgPackProtocol::MESSAGE_TYPE_FOOD_SPAWN, m_v2FoodSpawnItems);
+	commonCount += appendV2ItemMessage(m_v2Common, MsgPackProtocol::MESSAGE_TYPE_FOOD_CONSUME, m_v2FoodConsumeItems);
+	commonCount += appendV2ItemMessage(m_v2Common, MsgPackProtocol::MESSAGE_TYPE_BOT_STATS, m_v2BotStatsItems);
+
+	writeV2Frame(getOutputBuffer(STREAM_V2_MOVE), commonCount,
+			MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE, m_v2BotMoveItems);
+	frames[STREAM_V2_MOVE] = m_output[STREAM_V2_MOVE];
+
+	if((m_v2BotMoveItems.count == 0) && (m_v2BotMoveHeadItems.count == 0)) {
+		// no moves (e.g. keyframes): both streams are identical
+		frames[STREAM_V2_MOVE_HEAD] = frames[STREAM_V2_MOVE];
+	} else {
+		writeV2Frame(getOutputBuffer(STREAM_V2_MOVE_HEAD), commonCount,
+				MsgPackProtocol::MESSAGE_TYPE_BOT_MOVE_HEAD, m_v2BotMoveHeadItems);
+		frames[STREAM_V2_MOVE_HEAD] = m_output[STREAM_V2_MOVE_HEAD];
+	}
 
-	item.bot_id = bot->getGUID();
-	item.natural_food_consumed = bot->getConsumedNaturalFood();
-	item.carrison_food_consumed = bot->getConsumedFoodHuntedByOthers();
-	item.hunted_food_consumed = bot->getConsumedFoodHuntedBySelf();
-	item.mass = bot->getSnake()->getMass();
+	serializeLogFrames();
 
-	m_botStatsMessage->items.push_back(item);
+	reset();
+	return frames;
 }
 
-std::string MsgPackUpdateTracker::serialize(void)
+void MsgPackUpdateTracker::reset(void)
 {
-	// decayed food
-	if(!m_foodDecayMessage->food_ids.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_foodDecayMessage);
-		appendMessage(buf);
+	m_frame.data.clear();
+
+	m_foodConsumeItems.clear();
+	m_foodSpawnItems.clear();
+	m_foodDecayItems.clear();
+	m_botMoveItems.clear();
+	m_botMoveHeadItems.clear();
+	m_botStatsItems.clear();
+
+	// keep the entries of active viewer keys to reuse their buffers
+	for(auto &entry: m_botLogItems) {
+		entry.second.clear();
 	}
 
-	// spawned food
-	if(!m_foodSpawnMessage->new_food.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_foodSpawnMessage);
-		appendMessage(buf);
-	}
+	m_v2Messages.data.clear();
+	m_v2MessageCount = 0;
 
-	// consumed food
-	if(!m_foodConsumeMessage->items.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_foodConsumeMessage);
-		appendMessage(buf);
-	}
+	m_v2FoodConsumeItems.clear();
+	m_v2FoodSpawnItems.clear();
+	m_v2FoodDecayItems.clear();
+	m_v2BotMoveItems.clear();
+	m_v2BotMoveHeadItems.clear();
+	m_v2BotStatsItems.clear();
+}
 
-	// moved bots
-	if(!m_botMoveMessage->items.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_botMoveMessage);
-		appendMessage(buf);
-	}
+void MsgPackUpdateTracker::beginParallelEvents(std::size_t workerCount)
+{
+	m_workerItems.resize(workerCount);
 
-	// moved bots (compressed version)
-	if(!m_botMoveHeadMessage->items.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_botMoveHeadMessage);
-		appendMessage(buf);
-	}
+	for(auto &worker: m_workerItems) {
+		worker.foodConsumeItems.clear();
+		worker.botMoveItems.clear();
+		worker.botMoveHeadItems.clear();
 
-	// bot statistics
-	if(!m_botStatsMessage->items.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_botStatsMessage);
-		appendMessage(buf);
+		worker.v2FoodConsumeItems.clear();
+		worker.v2BotMoveItems.clear();
+		worker.v2BotMoveHeadItems.clear();
 	}
+}
 
-	// log messages
-	if (!m_botLogMessage->items.empty()) {
-		msgpack::sbuffer buf;
-		msgpack::pack(buf, m_botLogMessage);
-		appendMessage(buf);
-	}
+void MsgPackUpdateTracker::botMovedParallel(std::size_t worker,
+		const std::shared_ptr<Bot> &bot, std::size_t steps)
+{
+	WorkerItems &items = m_workerItems[worker];
+	uint32_t key = bot->getSlot();
 
-	std::string result = m_stream.str();
-	reset();
-	return result;
+	packBotMoved(items.botMoveItems.add(key), items.botMoveHeadItems.add(key),
+			items.v2BotMoveItems.add(key), items.v2BotMoveHeadItems.add(key),
+			bot, steps, bot->getSnake()->getHeadPositionsDuringLastMove());
 }
 
-void MsgPackUpdateTracker::reset(void)
+void MsgPackUpdateTracker::foodConsumedParallel(std::size_t worker,
+		const Food &food, const std::shared_ptr<Bot> &by_bot)
 {
-	m_foodConsumeMessage = std::make_unique<MsgPackProtocol::FoodConsumeMessage>();
-	m_foodSpawnMessage = std::make_unique<MsgPackProtocol::FoodSpawnMessage>();
-	m_foodDecayMessage = std::make_unique<MsgPackProtocol::FoodDecayMessage>();
-	m_botMoveMessage = std::make_unique<MsgPackProtocol::BotMoveMessage>();
-	m_botMoveHeadMessage = std::make_unique<MsgPackProtocol::BotMoveHeadMessage>();
-	m_botStatsMessage = std::make_unique<MsgPackProtocol::BotStatsMessage>();
-	m_botLogMessage = std::make_unique<MsgPackProtocol::BotLogMessage>();
+	WorkerItems &items = m_workerItems[worker];
+	uint32_t key = by_bot->getSlot();
 
-	m_stream.str("");
+	packFoodConsumed(items.foodConsumeItems.add(key), items.v2FoodConsumeItems.add(key), food, by_bot);
 }
 
+void MsgPackUpdateTracker::endParallelEvents(void)
+{
+	mergeWorkerItems(m_foodConsumeItems, &WorkerItems::foodConsumeItems);
+	mergeWorkerItems(m_botMoveItems, &WorkerItems::botMoveItems);
+	mergeWorkerItems(m_botMoveHeadItems, &WorkerItems::botMoveHeadItems);
+
+	mergeWorkerItems(m_v2FoodConsumeItems, &WorkerItems::v2FoodConsumeItems);
+	mergeWorkerItems(m_v2BotMoveItems, &WorkerItems::v2BotMoveItems);
+	mergeWorkerItems(m_v2BotMoveHeadItems, &WorkerItems::v2BotMoveHeadItems);
+}
@@ -18,11 +18,16 @@
 
 #pragma once
 
-#include <sstream>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <msgpack.hpp>
 
 #include "MsgPackProtocol.h"
+#include "MsgPackV2.h"
 
 #include "types.h"
 #include "UpdateTracker.h"
@@ -30,22 +35,212 @@
 /*!
  * \brief Implementation of UpdateTracker which serializes the events using
  * MsgPack.
+ *
+ * \details
+ * Events are encoded directly into reusable buffers when they are tracked.
+ * Single messages (spawn, kill, tick, ...) go to the frame buffer right away,
+ * items of aggregated messages (food, moves, stats) are collected in one
+ * buffer per message type. serialize() appends the aggregated messages to the
+ * frame buffer. Message lengths are patched in after encoding, so no
+ * intermediate message objects or copies are needed.
+ *
+ * Every event is encoded for protocol version 1 and 2 (see MsgPackProtocol).
+ * Version 2 messages are collected separately and serialize() assembles one
+ * frame for each Stream from them.
+ *
+ * Log messages are collected per viewer key and serialized into separate
+ * frames (see getLogFrames()), so they can be sent to the interested viewers
+ * only.
+ *
+ * In parallel mode (see beginParallelEvents()), each worker encodes its items
+ * into its own lists, where every item is tagged with its order key.
+ * endParallelEvents() copies the encoded items into the regular lists in key
+ * order, so only a memcpy per item remains on the calling thread.
+ *
+ * All buffers keep their capacity, so after a few frames no more allocations
+ * happen.
  */
 class MsgPackUpdateTracker : public UpdateTracker
 {
 	private:
-		// messages that need to be filled over a frame
-		std::unique_ptr<MsgPackProtocol::FoodConsumeMessage> m_foodConsumeMessage;
-		std::unique_ptr<MsgPackProtocol::FoodSpawnMessage> m_foodSpawnMessage;
-		std::unique_ptr<MsgPackProtocol::FoodDecayMessage> m_foodDecayMessage;
-		std::unique_ptr<MsgPackProtocol::BotMoveMessage> m_botMoveMessage;
-		std::unique_ptr<MsgPackProtocol::BotMoveHeadMessage> m_botMoveHeadMessage;
-		std::unique_ptr<MsgPackProtocol::BotStatsMessage> m_botStatsMessage;
-		std::unique_ptr<MsgPackProtocol::BotLogMessage> m_botLogMessage;
+		typedef MsgPackBuffer Buffer;
+
+		/*!
+		 * Items of an aggregated message.
+		 */
+		struct ItemList {
+			Buffer   items;
+			uint32_t count = 0;
+
+			void clear(void) { items.data.clear(); count = 0; }
+		};
+
+		Buffer m_frame;  //!< Serialized messages of the current frame
+
+		//! Results of the last serialize() call
+		std::array<std::shared_ptr<std::string>, STREAM_COUNT> m_output;
+
+		ItemList m_foodConsumeItems;
+		ItemList m_foodSpawnItems;
+		ItemList m_foodDecayItems;
+		ItemList m_botMoveItems;
+		ItemList m_botMoveHeadItems;
+		ItemList m_botStatsItems;
+
+		//! Log items by viewer key, shared by both protocol versions
+		std::unordered_map<uint64_t, ItemList> m_botLogItems;
+		LogFrameList m_logFrames; //!< Log frames of the last serialize() call
+
+		// protocol version 2
+		Buffer   m_v2Messages; //!< Single messages of the current frame
+		uint32_t m_v2MessageCount = 0;
+		Buffer   m_v2Common;   //!< Messages common to all version 2 streams, built in serialize()
+
+		ItemList m_v2FoodConsumeItems;
+		ItemList m_v2FoodSpawnItems;
+		ItemList m_v2FoodDecayItems;
+		ItemList m_v2BotMoveItems;
+		ItemList m_v2BotMoveHeadItems;
+		ItemList m_v2BotStatsItems;
+
+		std::vector<MsgPackV2::FixedPoint> m_v2HeadPositions; //!< Last transmitted head position by bot slot
+
+		/*!
+		 * Items of an aggregated message tracked by one worker, with the
+		 * order key and start offset of each item.
+		 */
+		struct KeyedItemList {
+			struct Item {
+				uint32_t    key;
+				std::size_t offset;
+			};
+
+			Buffer            items;
+			std::vector<Item> index;
+
+			/*!
+			 * Start a new item with the given key.
+			 *
+			 * \returns   The buffer to encode the item to.
+			 */
+			Buffer& add(uint32_t key)
+			{
+				index.push_back({key, items.data.size()});
+				return items;
+			}
+
+			void clear(void) { items.data.clear(); index.clear(); }
+		};
+
+		/*!
+		 * Item lists of one worker in parallel mode.
+		 */
+		struct WorkerItems {
+			KeyedItemList foodConsumeItems;
+			KeyedItemList botMoveItems;
+			KeyedItemList botMoveHeadItems;
+
+			KeyedItemList v2FoodConsumeItems;
+			KeyedItemList v2BotMoveItems;
+			KeyedItemList v2BotMoveHeadItems;
+		};
 
-		std::ostringstream m_stream;
+		struct MergeEntry {
+			uint32_t key;
+			uint32_t worker;
+			uint32_t item;
 
-		void appendMessage(const msgpack::sbuffer &buf);
+			bool operator<(const MergeEntry &other) const;
+		};
+
+		std::vector<WorkerItems> m_workerItems;
+		std::vector<MergeEntry>  m_mergeOrder;
+
+		/*!
+		 * Append the items of the given list of all workers to the given list,
+		 * ordered by key.
+		 */
+		void mergeWorkerItems(ItemList &out, KeyedItemList WorkerItems::*list);
+
+		/*!
+		 * Encode the items of a consumed food event to the given buffers.
+		 */
+		static void packFoodConsumed(Buffer &v1, Buffer &v2,
+				const Food &food, const std::shared_ptr<Bot> &by_bot);
+
+		/*!
+		 * Encode the items of a move event to the given buffers and update the
+		 * bot's entry in m_v2HeadPositions, which must exist already.
+		 */
+		void packBotMoved(Buffer &v1Move, Buffer &v1MoveHead, Buffer &v2Move, Buffer &v2MoveHead,
+				const std::shared_ptr<Bot> &bot, std::size_t steps,
+				const Snake::PositionList &headPositions);
+
+		/*!
+		 * Reserve space for the length prefix of a new message in the given
+		 * buffer.
+		 *
+		 * \returns   Position of the length prefix, to be passed to endMessage().
+		 */
+		static std::size_t beginMessage(Buffer &out);
+
+		/*!
+		 * Write the length prefix of the message started at the given position.
+		 */
+		static void endMessage(Buffer &out, std::size_t start);
+
+		/*!
+		 * Append a complete message to the frame buffer.
+		 */
+		template<typename T>
+		void appendMessage(const T &msg)
+		{
+			std::size_t start = beginMessage(m_frame);
+			msgpack::pack(m_frame, msg);
+			endMessage(m_frame, start);
+		}
+
+		/*!
+		 * Append an aggregated message with the given type to the given buffer,
+		 * if it has any items.
+		 */
+		static void appendItemMessage(Buffer &out, int messageType, const ItemList &list);
+
+		/*!
+		 * Append a version 2 aggregated message to the given buffer, if the
+		 * list has any items.
+		 *
+		 * \returns   The number of appended messages.
+		 */
+		static uint32_t appendV2ItemMessage(Buffer &out, int messageType, const ItemList &list)
+		{
+			return MsgPackV2::appendItemMessage(out, messageType, list.items, list.count);
+		}
+
+		/*!
+		 * Build m_logFrames from the collected log items.
+		 */
+		void serializeLogFrames(void);
+
+		/*!
+		 * Get the output buffer for the given stream, empty. The previous buffer
+		 * is reused if nobody holds a reference to it anymore.
+		 */
+		std::string& getOutputBuffer(Stream stream);
+
+		/*!
+		 * Write a complete version 2 frame: the messages from m_v2Common and
+		 * the aggregated move message of the given type.
+		 */
+		void writeV2Frame(std::string &out, uint32_t commonCount, int moveType, const ItemList &moveItems);
+
+		/*!
+		 * Start a single version 2 message of the given type. The fields are
+		 * packed to m_v2Messages afterwards.
+		 *
+		 * \param fieldCount  Number of fields following the type.
+		 */
+		void beginV2Message(int messageType, uint32_t fieldCount);
 
 	public:
 		MsgPackUpdateTracker();
@@ -67,17 +262,38 @@ class MsgPackUpdateTracker : public UpdateTracker
 
 		void botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps) override;
 
+		/*!
+		 * Track a move with the given head positions instead of the ones of
+		 * the bot's last move, e.g. for moves merged over several frames.
+		 */
+		void botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps,
+				const Snake::PositionList &headPositions);
+
 		void botLogMessage(uint64_t viewerKey, const std::string &message) override;
+		void botLogMessage(uint64_t viewerKey, const char *message, std::size_t length) override;
 
 		void gameInfo(void);
 
 		void worldState(Field &field) override;
+		void worldState(const WorldSnapshot &snapshot) override;
 
 		void tick(uint64_t frame_id) override;
 
 		void botStats(const std::shared_ptr<Bot> &bot) override;
 
-		std::string serialize(void) override;
+		FrameSet serialize(void) override;
+
+		const LogFrameList& getLogFrames(void) const override { return m_logFrames; }
 
 		void reset(void) override;
+
+		void beginParallelEvents(std::size_t workerCount) override;
+
+		void botMovedParallel(std::size_t worker,
+				const std::shared_ptr<Bot> &bot, std::size_t steps) override;
+
+		void foodConsumedParallel(std::size_t worker,
+				const Food &food, const std::shared_ptr<Bot> &by_bot) override;
+
+		void endParallelEvents(void) override;
 };
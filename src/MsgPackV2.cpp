@@ -0,0 +1,206 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+#include "Bot.h"
+#include "Food.h"
+
+#include "config.h"
+#include "MsgPackProtocol.h"
+
+#include "MsgPackV2.h"
+
+namespace MsgPackV2
+{
+
+static const int32_t WORLD_SIZE_X = std::lround(config::FIELD_SIZE_X * MsgPackProtocol::V2_POSITION_SCALE);
+static const int32_t WORLD_SIZE_Y = std::lround(config::FIELD_SIZE_Y * MsgPackProtocol::V2_POSITION_SCALE);
+
+// length prefix, [version, [messages...]] with a fixed-size (array 32)
+// message list header, so the count can be written afterwards
+static const char FRAME_HEADER[] = {0, 0, 0, 0, '\x92', MsgPackProtocol::PROTOCOL_VERSION_2, '\xdd', 0, 0, 0, 0};
+static const std::size_t FRAME_HEADER_COUNT_OFFSET = 7;
+
+FixedPoint toFixedPoint(const Vector2D &pos)
+{
+	int32_t x = std::lround(pos.x() * MsgPackProtocol::V2_POSITION_SCALE) % WORLD_SIZE_X;
+	int32_t y = std::lround(pos.y() * MsgPackProtocol::V2_POSITION_SCALE) % WORLD_SIZE_Y;
+
+	return FixedPoint{(x < 0) ? (x + WORLD_SIZE_X) : x, (y < 0) ? (y + WORLD_SIZE_Y) : y};
+}
+
+void packOffset(Packer &packer, const FixedPoint &from, const FixedPoint &to)
+{
+	int32_t dx = to.x - from.x;
+	int32_t dy = to.y - from.y;
+
+	if(dx >= WORLD_SIZE_X / 2) {
+		dx -= WORLD_SIZE_X;
+	} else if(dx < -WORLD_SIZE_X / 2) {
+		dx += WORLD_SIZE_X;
+	}
+
+	if(dy >= WORLD_SIZE_Y / 2) {
+		dy -= WORLD_SIZE_Y;
+	} else if(dy < -WORLD_SIZE_Y / 2) {
+		dy += WORLD_SIZE_Y;
+	}
+
+	packer.pack(dx);
+	packer.pack(dy);
+}
+
+void packFood(Packer &packer, const Food &food)
+{
+	FixedPoint pos = toFixedPoint(food.pos());
+
+	packer.pack_array(4);
+	packer.pack(static_cast<uint32_t>(food.getGUID()));
+	packer.pack(pos.x);
+	packer.pack(pos.y);
+	packer.pack(static_cast<float>(food.getValue()));
+}
+
+void packFood(Packer &packer, const WorldSnapshot::FoodEntry &food)
+{
+	FixedPoint pos = toFixedPoint(Vector2D(food.x, food.y));
+
+	packer.pack_array(4);
+	packer.pack(static_cast<uint32_t>(food.guid));
+	packer.pack(pos.x);
+	packer.pack(pos.y);
+	packer.pack(static_cast<float>(food.value));
+}
+
+void packBotInfo(Packer &packer, const std::string &name, int databaseVersionId,
+		uint32_t face, uint32_t dogTag, const std::vector<uint32_t> &colors)
+{
+	packer.pack(name);
+	packer.pack(databaseVersionId);
+	packer.pack(face);
+	packer.pack(dogTag);
+	packer.pack(colors);
+}
+
+void packBot(Packer &packer, const std::shared_ptr<Bot> &bot)
+{
+	const std::string &info = bot->getPackedInfo();
+
+	packer.pack_array(9);
+	packer.pack(static_cast<uint32_t>(bot->getGUID()));
+	packer.pack_bin_body(info.data(), info.size()); // appends the encoded fields as they are
+	packer.pack(static_cast<float>(bot->getSnake()->getMass()));
+	packer.pack(static_cast<float>(bot->getSnake()->getSegmentRadius()));
+	packSegments(packer, bot->getSnake()->getSegments());
+}
+
+void packBot(Packer &packer, const WorldSnapshot::BotEntry &bot)
+{
+	packer.pack_array(9);
+	packer.pack(static_cast<uint32_t>(bot.guid));
+	packer.pack_bin_body(bot.info.data(), bot.info.size());
+	packer.pack(static_cast<float>(bot.mass));
+	packer.pack(static_cast<float>(bot.segmentRadius));
+	packSegments(packer, bot.segments);
+}
+
+void packMoveItem(Packer &packer, const std::shared_ptr<Bot> &bot, std::size_t steps,
+		const FixedPoint &previousHead)
+{
+	const Snake::SegmentList &segments = bot->getSnake()->getSegments();
+
+	packer.pack_array(4);
+	packer.pack(static_cast<uint32_t>(bot->getGUID()));
+	packer.pack_array(2 * steps);
+
+	FixedPoint previous = previousHead;
+	for(std::size_t i = 0; i < steps; i++) {
+		FixedPoint current = toFixedPoint(segments[i].pos());
+		packOffset(packer, previous, current);
+		previous = current;
+	}
+
+	packer.pack(static_cast<uint32_t>(segments.size()));
+	packer.pack(static_cast<uint32_t>(bot->getSnake()->getSegmentRadius()));
+}
+
+void packMoveHeadItem(Packer &packer, const std::shared_ptr<Bot> &bot,
+		const Snake::PositionList &headPositions, const FixedPoint &previousHead)
+{
+	packer.pack_array(3);
+	packer.pack(static_cast<uint32_t>(bot->getGUID()));
+	packer.pack(static_cast<float>(bot->getSnake()->getMass()));
+	packer.pack_array(2 * headPositions.size());
+
+	FixedPoint previous = previousHead;
+	for(auto &pos: headPositions) {
+		FixedPoint current = toFixedPoint(pos);
+		packOffset(packer, previous, current);
+		previous = current;
+	}
+}
+
+void packGameInfo(Packer &packer)
+{
+	packer.pack_array(9);
+	packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_GAME_INFO));
+	packer.pack(static_cast<double>(config::FIELD_SIZE_X));
+	packer.pack(static_cast<double>(config::FIELD_SIZE_Y));
+	packer.pack(static_cast<double>(config::FOOD_DECAY_STEP));
+	packer.pack(static_cast<double>(config::SNAKE_DISTANCE_PER_STEP));
+	packer.pack(static_cast<double>(config::SNAKE_SEGMENT_DISTANCE_FACTOR));
+	packer.pack(static_cast<double>(config::SNAKE_SEGMENT_DISTANCE_EXPONENT));
+	packer.pack(static_cast<double>(config::SNAKE_PULL_FACTOR));
+	packer.pack(MsgPackProtocol::V2_POSITION_SCALE);
+}
+
+uint32_t appendItemMessage(MsgPackBuffer &frame, int messageType,
+		const MsgPackBuffer &items, uint32_t itemCount)
+{
+	if(itemCount == 0) {
+		return 0;
+	}
+
+	Packer packer(frame);
+	packer.pack_array(2);
+	packer.pack(messageType);
+	packer.pack_array(itemCount);
+
+	frame.write(items.data.data(), items.data.size());
+	return 1;
+}
+
+void beginFrame(MsgPackBuffer &frame)
+{
+	frame.write(FRAME_HEADER, sizeof(FRAME_HEADER));
+}
+
+void endFrame(MsgPackBuffer &frame, uint32_t messageCount)
+{
+	uint32_t count = htonl(messageCount);
+	memcpy(&frame.data[FRAME_HEADER_COUNT_OFFSET], &count, sizeof(count));
+
+	uint32_t length = htonl(static_cast<uint32_t>(frame.data.size() - sizeof(uint32_t)));
+	memcpy(&frame.data[0], &length, sizeof(length));
+}
+
+}
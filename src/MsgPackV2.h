@@ -0,0 +1,159 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <msgpack.hpp>
+
+#include "types.h"
+
+#include "Snake.h"
+#include "WorldSnapshot.h"
+
+class Bot;
+class Food;
+
+/*!
+ * \brief Growable byte buffer that can be used as MsgPack stream.
+ */
+struct MsgPackBuffer {
+	std::string data;
+
+	void write(const char *buf, std::size_t len) { data.append(buf, len); }
+};
+
+/*!
+ * \brief Encoding helpers for protocol version 2 (see MsgPackProtocol).
+ */
+namespace MsgPackV2
+{
+	typedef msgpack::packer<MsgPackBuffer> Packer;
+
+	/*!
+	 * Fixed point position.
+	 */
+	struct FixedPoint {
+		int32_t x;
+		int32_t y;
+	};
+
+	/*!
+	 * Convert a (possibly unwrapped) position to fixed point, wrapped into
+	 * the world.
+	 */
+	FixedPoint toFixedPoint(const Vector2D &pos);
+
+	/*!
+	 * Pack the offset between two fixed point positions, wrapped to the
+	 * shortest way around the torus.
+	 */
+	void packOffset(Packer &packer, const FixedPoint &from, const FixedPoint &to);
+
+	inline const Vector2D& positionOf(const Snake::Segment &segment) { return segment.pos(); }
+	inline const Vector2D& positionOf(const Vector2D &pos) { return pos; }
+
+	/*!
+	 * Pack a segment list: head absolute, all other segments relative to
+	 * their predecessor.
+	 */
+	template<typename Container>
+	void packSegments(Packer &packer, const Container &segments)
+	{
+		packer.pack_array(2 * segments.size());
+
+		FixedPoint previous;
+		bool first = true;
+
+		for(auto &segment: segments) {
+			FixedPoint current = toFixedPoint(positionOf(segment));
+
+			if(first) {
+				packer.pack(current.x);
+				packer.pack(current.y);
+				first = false;
+			} else {
+				packOffset(packer, previous, current);
+			}
+
+			previous = current;
+		}
+	}
+
+	void packFood(Packer &packer, const Food &food);
+	void packFood(Packer &packer, const WorldSnapshot::FoodEntry &food);
+
+	/*!
+	 * Pack the fields of a bot that are cached by Bot::getPackedInfo(). The
+	 * GUID is not part of them because its width differs between the protocol
+	 * versions.
+	 */
+	void packBotInfo(Packer &packer, const std::string &name, int databaseVersionId,
+			uint32_t face, uint32_t dogTag, const std::vector<uint32_t> &colors);
+
+	void packBot(Packer &packer, const std::shared_ptr<Bot> &bot);
+	void packBot(Packer &packer, const WorldSnapshot::BotEntry &bot);
+
+	/*!
+	 * Pack a BotMove item for the last move of the given bot.
+	 *
+	 * \param steps         Number of new segments at the head.
+	 * \param previousHead  Head position the viewer knows from the last update.
+	 */
+	void packMoveItem(Packer &packer, const std::shared_ptr<Bot> &bot, std::size_t steps,
+			const FixedPoint &previousHead);
+
+	/*!
+	 * Pack a BotMoveHead item for the given bot.
+	 *
+	 * \param headPositions Head positions since the last update, usually
+	 *                      Snake::getHeadPositionsDuringLastMove().
+	 * \param previousHead  Head position the viewer knows from the last update.
+	 */
+	void packMoveHeadItem(Packer &packer, const std::shared_ptr<Bot> &bot,
+			const Snake::PositionList &headPositions, const FixedPoint &previousHead);
+
+	/*!
+	 * Pack a complete GameInfo message.
+	 */
+	void packGameInfo(Packer &packer);
+
+	/*!
+	 * Append an aggregated message with the given items to a frame, if there
+	 * are any.
+	 *
+	 * \returns   The number of appended messages.
+	 */
+	uint32_t appendItemMessage(MsgPackBuffer &frame, int messageType,
+			const MsgPackBuffer &items, uint32_t itemCount);
+
+	/*!
+	 * Append the frame header (length prefix, version and message list
+	 * header) to an empty buffer. The messages follow directly.
+	 */
+	void beginFrame(MsgPackBuffer &frame);
+
+	/*!
+	 * Fill in the length and message count of a frame started with
+	 * beginFrame().
+	 */
+	void endFrame(MsgPackBuffer &frame, uint32_t messageCount);
+}
@@ -0,0 +1,195 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdexcept>
+
+#include "MultiRateUpdateTracker.h"
+
+/* Private methods */
+
+AggregatingUpdateTracker& MultiRateUpdateTracker::getAggregated(std::size_t framesPerUpdate)
+{
+	if((framesPerUpdate < 2) || (framesPerUpdate > config::VIEWER_MAX_FRAMES_PER_UPDATE)) {
+		throw std::runtime_error("MultiRateUpdateTracker: no aggregation for " + std::to_string(framesPerUpdate) + " frames per update");
+	}
+
+	return m_aggregated[framesPerUpdate - 2];
+}
+
+/* Public methods */
+
+void MultiRateUpdateTracker::foodConsumed(const Food &food,
+		const std::shared_ptr<Bot> &by_bot)
+{
+	m_fullRate.foodConsumed(food, by_bot);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.foodConsumed(food, by_bot);
+	}
+}
+
+void MultiRateUpdateTracker::foodDecayed(const Food &food)
+{
+	m_fullRate.foodDecayed(food);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.foodDecayed(food);
+	}
+}
+
+void MultiRateUpdateTracker::foodSpawned(const Food &food)
+{
+	m_fullRate.foodSpawned(food);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.foodSpawned(food);
+	}
+}
+
+void MultiRateUpdateTracker::botSpawned(const std::shared_ptr<Bot> &bot)
+{
+	m_fullRate.botSpawned(bot);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.botSpawned(bot);
+	}
+}
+
+void MultiRateUpdateTracker::botKilled(const std::shared_ptr<Bot> &killer,
+		const std::shared_ptr<Bot> &victim)
+{
+	m_fullRate.botKilled(killer, victim);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.botKilled(killer, victim);
+	}
+}
+
+void MultiRateUpdateTracker::botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps)
+{
+	m_fullRate.botMoved(bot, steps);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.botMoved(bot, steps);
+	}
+}
+
+void MultiRateUpdateTracker::botLogMessage(uint64_t viewerKey, const std::string &message)
+{
+	botLogMessage(viewerKey, message.data(), message.size());
+}
+
+void MultiRateUpdateTracker::botLogMessage(uint64_t viewerKey, const char *message, std::size_t length)
+{
+	m_fullRate.botLogMessage(viewerKey, message, length);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.botLogMessage(viewerKey, message, length);
+	}
+}
+
+void MultiRateUpdateTracker::worldState(Field &field)
+{
+	m_fullRate.worldState(field);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.worldState(field);
+	}
+}
+
+void MultiRateUpdateTracker::worldState(const WorldSnapshot &snapshot)
+{
+	m_fullRate.worldState(snapshot);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.worldState(snapshot);
+	}
+}
+
+void MultiRateUpdateTracker::tick(uint64_t frame_id)
+{
+	m_fullRate.tick(frame_id);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.tick(frame_id);
+	}
+}
+
+void MultiRateUpdateTracker::botStats(const std::shared_ptr<Bot> &bot)
+{
+	m_fullRate.botStats(bot);
+
+	for(auto &tracker: m_aggregated) {
+		tracker.botStats(bot);
+	}
+}
+
+UpdateTracker::FrameSet MultiRateUpdateTracker::serialize(void)
+{
+	return m_fullRate.serialize();
+}
+
+UpdateTracker::FrameSet MultiRateUpdateTracker::serializeAggregated(std::size_t framesPerUpdate)
+{
+	return getAggregated(framesPerUpdate).serialize();
+}
+
+const UpdateTracker::LogFrameList& MultiRateUpdateTracker::getAggregatedLogFrames(std::size_t framesPerUpdate)
+{
+	return getAggregated(framesPerUpdate).getLogFrames();
+}
+
+void MultiRateUpdateTracker::reset(void)
+{
+	m_fullRate.reset();
+
+	for(auto &tracker: m_aggregated) {
+		tracker.reset();
+	}
+}
+
+void MultiRateUpdateTracker::beginParallelEvents(std::size_t workerCount)
+{
+	m_fullRate.beginParallelEvents(workerCount);
+	m_aggregatedParallelEvents.begin(workerCount);
+}
+
+void MultiRateUpdateTracker::botMovedParallel(std::size_t worker,
+		const std::shared_ptr<Bot> &bot, std::size_t steps)
+{
+	m_fullRate.botMovedParallel(worker, bot, steps);
+	m_aggregatedParallelEvents.botMoved(worker, bot, steps);
+}
+
+void MultiRateUpdateTracker::foodConsumedParallel(std::size_t worker,
+		const Food &food, const std::shared_ptr<Bot> &by_bot)
+{
+	m_fullRate.foodConsumedParallel(worker, food, by_bot);
+	m_aggregatedParallelEvents.foodConsumed(worker, food, by_bot);
+}
+
+void MultiRateUpdateTracker::endParallelEvents(void)
+{
+	m_fullRate.endParallelEvents();
+
+	m_aggregatedParallelEvents.merge();
+	for(auto &tracker: m_aggregated) {
+		m_aggregatedParallelEvents.replay(tracker);
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <array>
+
+#include "config.h"
+
+#include "AggregatingUpdateTracker.h"
+#include "MsgPackUpdateTracker.h"
+#include "UpdateEventBuffer.h"
+
+/*!
+ * \brief UpdateTracker providing the events at several update rates.
+ *
+ * \details
+ * All events are passed to a MsgPackUpdateTracker for the full rate and to
+ * one AggregatingUpdateTracker per lower rate. serialize() and getLogFrames()
+ * provide the full rate updates, serializeAggregated() the merged ones.
+ *
+ * A rate is given as the number of frames per update, from 1 (every frame)
+ * to config::VIEWER_MAX_FRAMES_PER_UPDATE. Events are merged independent of
+ * connected viewers, so each rate is ready to be sent at any time.
+ *
+ * Events from parallel jobs are encoded concurrently by the full rate
+ * tracker. For the lower rates, they are buffered once and passed to all
+ * aggregating trackers by endParallelEvents().
+ */
+class MultiRateUpdateTracker : public UpdateTracker
+{
+	private:
+		MsgPackUpdateTracker m_fullRate;
+
+		//! Trackers for the lower rates, index is framesPerUpdate - 2
+		std::array<AggregatingUpdateTracker, config::VIEWER_MAX_FRAMES_PER_UPDATE - 1> m_aggregated;
+
+		//! Events from parallel jobs for the lower rates
+		UpdateEventBuffer m_aggregatedParallelEvents;
+
+		AggregatingUpdateTracker& getAggregated(std::size_t framesPerUpdate);
+
+	public:
+		/* Implemented functions */
+		void foodConsumed(
+				const Food &food,
+				const std::shared_ptr<Bot> &by_bot) override;
+
+		void foodDecayed(const Food &food) override;
+
+		void foodSpawned(const Food &food) override;
+
+		void botSpawned(const std::shared_ptr<Bot> &bot) override;
+
+		void botKilled(
+				const std::shared_ptr<Bot> &killer,
+				const std::shared_ptr<Bot> &victim) override;
+
+		void botMoved(const std::shared_ptr<Bot> &bot, std::size_t steps) override;
+
+		void botLogMessage(uint64_t viewerKey, const std::string &message) override;
+		void botLogMessage(uint64_t viewerKey, const char *message, std::size_t length) override;
+
+		void worldState(Field &field) override;
+		void worldState(const WorldSnapshot &snapshot) override;
+
+		void tick(uint64_t frame_id) override;
+
+		void botStats(const std::shared_ptr<Bot> &bot) override;
+
+		FrameSet serialize(void) override;
+
+		const LogFrameList& getLogFrames(void) const override { return m_fullRate.getLogFrames(); }
+
+		/*!
+		 * Serialize the events merged since the last call for the given rate.
+		 *
+		 * \param framesPerUpdate  The rate, 2 to config::VIEWER_MAX_FRAMES_PER_UPDATE.
+		 */
+		FrameSet serializeAggregated(std::size_t framesPerUpdate);
+
+		/*!
+		 * Log frames of the last serializeAggregated() call for the given rate.
+		 */
+		const LogFrameList& getAggregatedLogFrames(std::size_t framesPerUpdate);
+
+		void reset(void) override;
+
+		void beginParallelEvents(std::size_t workerCount) override;
+
+		void botMovedParallel(std::size_t worker,
+				const std::shared_ptr<Bot> &bot, std::size_t steps) override;
+
+		void foodConsumedParallel(std::size_t worker,
+				const Food &food, const std::shared_ptr<Bot> &by_bot) override;
+
+		void endParallelEvents(void) override;
+};
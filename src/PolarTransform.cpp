@@ -0,0 +1,149 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "PolarTransform.h"
+
+// Minimax polynomial for atan(z) with z in [0, 1]. The resulting error of
+// fastAtan2() is documented in PolarTransform.h.
+static const float ATAN_C1  =  0.99997726f;
+static const float ATAN_C3  = -0.33262347f;
+static const float ATAN_C5  =  0.19354346f;
+static const float ATAN_C7  = -0.11643287f;
+static const float ATAN_C9  =  0.05265332f;
+static const float ATAN_C11 = -0.01172120f;
+
+static const float PI_F      = 3.14159265f;
+static const float HALF_PI_F = 1.57079633f;
+static const float TWO_PI_F  = 6.28318531f;
+
+// prevents division by zero for atan2(0, 0), which results in 0
+static const float ATAN_MIN_DENOMINATOR = 1e-30f;
+
+PolarTransform::PolarTransform(real_t fieldWidth, real_t fieldHeight)
+	: m_torus(fieldWidth, fieldHeight)
+{
+}
+
+void PolarTransform::clear(void)
+{
+	m_x.clear();
+	m_y.clear();
+}
+
+real_t PolarTransform::fastAtan2(real_t y, real_t x)
+{
+	float ax = std::fabs(x);
+	float ay = std::fabs(y);
+
+	float z = std::fmin(ax, ay) / std::fmax(std::fmax(ax, ay), ATAN_MIN_DENOMINATOR);
+	float z2 = z * z;
+
+	float r = z * (ATAN_C1 + z2 * (ATAN_C3 + z2 * (ATAN_C5 + z2 * (ATAN_C7 + z2 * (ATAN_C9 + z2 * ATAN_C11)))));
+
+	r = (ay > ax) ? (HALF_PI_F - r) : r;
+	r = (x < 0) ? (PI_F - r) : r;
+
+	return std::copysign(r, y);
+}
+
+void PolarTransform::runScalar(std::size_t first, real_t heading)
+{
+	for(std::size_t i = first; i < m_x.size(); i++) {
+		real_t x = m_x[i];
+		real_t y = m_y[i];
+
+		real_t direction = fastAtan2(y, x) - heading;
+		direction -= TWO_PI_F * std::nearbyint(direction / TWO_PI_F);
+
+		m_dist[i] = std::sqrt(x*x + y*y);
+		m_dir[i] = direction;
+	}
+}
+
+void PolarTransform::run(real_t heading)
+{
+	std::size_t n = m_x.size();
+
+	m_dist.resize(n);
+	m_dir.resize(n);
+
+	m_torus.unwrapRelative(m_x.data(), m_y.data(), n);
+
+	std::size_t i = 0;
+
+#ifdef __SSE2__
+	static_assert(sizeof(real_t) == sizeof(float), "SSE2 kernel requires real_t == float");
+
+	const __m128 vHeading  = _mm_set1_ps(heading);
+	const __m128 signMask  = _mm_set1_ps(-0.0f);
+	const __m128 zero      = _mm_setzero_ps();
+	const __m128 pi        = _mm_set1_ps(PI_F);
+	const __m128 halfPi    = _mm_set1_ps(HALF_PI_F);
+	const __m128 twoPi     = _mm_set1_ps(TWO_PI_F);
+	const __m128 invTwoPi  = _mm_set1_ps(1.0f / TWO_PI_F);
+	const __m128 minDenom  = _mm_set1_ps(ATAN_MIN_DENOMINATOR);
+
+	for(; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(&m_x[i]);
+		__m128 y = _mm_loadu_ps(&m_y[i]);
+
+		__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+
+		// atan2 approximation
+		__m128 ax = _mm_andnot_ps(signMask, x);
+		__m128 ay = _mm_andnot_ps(signMask, y);
+
+		__m128 z  = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), minDenom));
+		__m128 z2 = _mm_mul_ps(z, z);
+
+		__m128 r = _mm_set1_ps(ATAN_C11);
+		r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(ATAN_C9));
+		r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(ATAN_C7));
+		r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(ATAN_C5));
+		r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(ATAN_C3));
+		r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(ATAN_C1));
+		r = _mm_mul_ps(r, z);
+
+		// r = (ay > ax) ? (pi/2 - r) : r
+		__m128 mask = _mm_cmpgt_ps(ay, ax);
+		r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(halfPi, r)), _mm_andnot_ps(mask, r));
+
+		// r = (x < 0) ? (pi - r) : r
+		mask = _mm_cmplt_ps(x, zero);
+		r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(pi, r)), _mm_andnot_ps(mask, r));
+
+		// copy the sign of y
+		r = _mm_or_ps(r, _mm_and_ps(signMask, y));
+
+		// direction relative to heading, normalized to -pi..pi
+		__m128 dir = _mm_sub_ps(r, vHeading);
+		dir = _mm_sub_ps(dir, _mm_mul_ps(twoPi, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(dir, invTwoPi)))));
+
+		_mm_storeu_ps(&m_dist[i], dist);
+		_mm_storeu_ps(&m_dir[i], dir);
+	}
+#endif
+
+	runScalar(i, heading);
+}
@@ -0,0 +1,96 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+#include "Torus.h"
+
+/*!
+ * \brief Batched conversion of relative positions to polar coordinates.
+ *
+ * \details
+ * Candidate positions (relative to a Snake's head) are collected in
+ * structure-of-arrays form using add() and converted in a single pass by
+ * run(). It unwraps the positions on the torus (see Torus::unwrapRelative()),
+ * then calculates the distance and the direction relative to the given
+ * heading. Both passes are vectorized using SSE2 where available.
+ *
+ * The direction is calculated using a polynomial approximation of atan2().
+ * Evaluated in float, its maximum absolute error compared to std::atan2() is
+ * ATAN2_MAX_ERROR radians (measured: 1.97e-6). That is about 8 ULP for angles
+ * near ±π, where adjacent floats are 2^-22 (about 2.4e-7) apart.
+ */
+class PolarTransform
+{
+	public:
+		//! Maximum absolute error of fastAtan2() in radians.
+		static constexpr const real_t ATAN2_MAX_ERROR = 2e-6;
+
+		PolarTransform(real_t fieldWidth, real_t fieldHeight);
+
+		/*!
+		 * Remove all candidates.
+		 */
+		void clear(void);
+
+		/*!
+		 * Add a candidate position relative to the reference point. The
+		 * position may be wrapped, i.e. span up to a full field size.
+		 */
+		void add(const Vector2D &relPos)
+		{
+			m_x.push_back(relPos.x());
+			m_y.push_back(relPos.y());
+		}
+
+		std::size_t size(void) const { return m_x.size(); }
+
+		/*!
+		 * Convert all candidates.
+		 *
+		 * After this call, x() and y() return the unwrapped relative position,
+		 * dist() the distance from the reference point and dir() the direction
+		 * relative to the given heading (range -π to +π).
+		 *
+		 * \param heading   Heading of the reference point in radians.
+		 */
+		void run(real_t heading);
+
+		real_t x(std::size_t i) const { return m_x[i]; }
+		real_t y(std::size_t i) const { return m_y[i]; }
+		real_t dist(std::size_t i) const { return m_dist[i]; }
+		real_t dir(std::size_t i) const { return m_dir[i]; }
+
+		/*!
+		 * Scalar version of the atan2() approximation used by run().
+		 */
+		static real_t fastAtan2(real_t y, real_t x);
+
+	private:
+		const Torus m_torus;
+
+		std::vector<real_t> m_x;
+		std::vector<real_t> m_y;
+		std::vector<real_t> m_dist;
+		std::vector<real_t> m_dir;
+
+		void runScalar(std::size_t first, real_t heading);
+};
@@ -0,0 +1,325 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <msgpack.hpp>
+
+#include "config.h"
+
+#include "FrameCompressor.h"
+#include "MsgPackProtocol.h"
+#include "MsgPackV2.h"
+
+#include "RelayServer.h"
+
+// poll timeout, limits the delay of a shutdown
+static const int POLL_TIMEOUT_MS = 100;
+
+RelayServer::RelayServer(const std::string &upstreamHost, uint16_t upstreamPort, uint16_t port, uint16_t webSocketPort)
+	: m_upstreamHost(upstreamHost)
+	, m_upstreamPort(upstreamPort)
+	, m_port(port)
+	, m_webSocketPort(webSocketPort)
+{
+}
+
+RelayServer::~RelayServer()
+{
+	disconnect();
+}
+
+int RelayServer::Main()
+{
+	if(!m_viewerServer.listen(m_port, m_webSocketPort)) {
+		return -1;
+	}
+
+	while(!m_shuttingDown) {
+		if(m_socket == -1) {
+			if(!connectUpstream()) {
+				sleep(config::RELAY_RECONNECT_INTERVAL);
+				continue;
+			}
+		}
+
+		struct pollfd pfd;
+		pfd.fd = m_socket;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		int ret = poll(&pfd, 1, POLL_TIMEOUT_MS);
+		if(ret == -1) {
+			if(errno != EINTR) {
+				std::cerr << "RelayServer: poll() failed: " << strerror(errno) << std::endl;
+				disconnect();
+			}
+			continue;
+		}
+
+		if((ret > 0) && !receive()) {
+			disconnect();
+			sleep(config::RELAY_RECONNECT_INTERVAL);
+		}
+	}
+
+	return 0;
+}
+
+void RelayServer::Shutdown(void)
+{
+	m_shuttingDown = true;
+}
+
+bool RelayServer::connectUpstream(void)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *addresses;
+	int ret = getaddrinfo(m_upstreamHost.c_str(), std::to_string(m_upstreamPort).c_str(), &hints, &addresses);
+	if(ret != 0) {
+		std::cerr << "RelayServer: cannot resolve " << m_upstreamHost << ": " << gai_strerror(ret) << std::endl;
+		return false;
+	}
+
+	for(struct addrinfo *addr = addresses; addr != NULL; addr = addr->ai_next) {
+		int s = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+		if(s == -1) {
+			continue;
+		}
+
+		if(connect(s, addr->ai_addr, addr->ai_addrlen) == 0) {
+			m_socket = s;
+			break;
+		}
+
+		close(s);
+	}
+
+	freeaddrinfo(addresses);
+
+	if(m_socket == -1) {
+		std::cerr << "RelayServer: cannot connect to " << m_upstreamHost << " port " << m_upstreamPort
+			<< ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	int one = 1;
+	setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	// register as relay; messages are framed like the server's
+	MsgPackBuffer hello;
+	hello.data.append(sizeof(uint32_t), '\0');
+
+	msgpack::packer<MsgPackBuffer> packer(hello);
+	packer.pack_array(1);
+	packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_RELAY_HELLO));
+
+	uint32_t length = htonl(static_cast<uint32_t>(hello.data.size() - sizeof(uint32_t)));
+	memcpy(&hello.data[0], &length, sizeof(length));
+
+	if(send(m_socket, hello.data.data(), hello.data.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(hello.data.size())) {
+		std::cerr << "RelayServer: cannot send RelayHello: " << strerror(errno) << std::endl;
+		disconnect();
+		return false;
+	}
+
+	std::cerr << "RelayServer: connected to " << m_upstreamHost << " port " << m_upstreamPort << std::endl;
+
+	m_inbound.clear();
+	m_synced = false;
+
+	return true;
+}
+
+void RelayServer::disconnect(void)
+{
+	if(m_socket == -1) {
+		return;
+	}
+
+	close(m_socket);
+	m_socket = -1;
+
+	// keep serving the last state until the upstream server is back
+	m_synced = false;
+}
+
+bool RelayServer::receive(void)
+{
+	char buf[65536];
+
+	ssize_t count = recv(m_socket, buf, sizeof(buf), 0);
+	if(count == 0) {
+		std::cerr << "RelayServer: upstream server closed the connection." << std::endl;
+		return false;
+	} else if(count == -1) {
+		if(errno == EINTR) {
+			return true;
+		}
+
+		std::cerr << "RelayServer: recv() failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	m_inbound.append(buf, count);
+
+	std::size_t pos = 0;
+	while(m_inbound.size() - pos >= sizeof(uint32_t)) {
+		uint32_t length;
+		memcpy(&length, m_inbound.data() + pos, sizeof(length));
+		length = ntohl(length);
+
+		if(length & FrameCompressor::COMPRESSED_FLAG) {
+			std::cerr << "RelayServer: upstream server sent compressed data, which was not requested." << std::endl;
+			return false;
+		}
+
+		if(length > config::RELAY_MAX_MESSAGE_SIZE) {
+			std::cerr << "RelayServer: message from upstream server is too long (" << length << " bytes)." << std::endl;
+			return false;
+		}
+
+		if(m_inbound.size() - pos - sizeof(uint32_t) < length) {
+			break;
+		}
+
+		if(!handleMessage(m_inbound.data() + pos + sizeof(uint32_t), length)) {
+			return false;
+		}
+
+		pos += sizeof(uint32_t) + length;
+	}
+
+	m_inbound.erase(0, pos);
+	return true;
+}
+
+bool RelayServer::handleMessage(const char *data, std::size_t length)
+{
+	try {
+		msgpack::object_handle handle = msgpack::unpack(data, length);
+		const msgpack::object &message = handle.get();
+
+		if((message.type != msgpack::type::ARRAY) || (message.via.array.size < 2)) {
+			throw msgpack::type_error();
+		}
+
+		const msgpack::object *fields = message.via.array.ptr;
+		uint32_t fieldCount = message.via.array.size;
+
+		if(fields[1].as<int>() != MsgPackProtocol::MESSAGE_TYPE_RELAY_FRAME) {
+			// not meant for relays
+			return true;
+		}
+
+		if((fieldCount < 6) || (fields[5].type != msgpack::type::ARRAY)
+				|| (fields[5].via.array.size != UpdateTracker::STREAM_COUNT)) {
+			throw msgpack::type_error();
+		}
+
+		std::size_t framesPerUpdate = fields[3].as<uint32_t>();
+		if((framesPerUpdate < 1) || (framesPerUpdate > config::VIEWER_MAX_FRAMES_PER_UPDATE)) {
+			throw msgpack::type_error();
+		}
+
+		ViewerServer::FrameSet frames;
+		for(std::size_t stream = 0; stream < UpdateTracker::STREAM_COUNT; stream++) {
+			frames[stream] = std::make_shared<const std::string>(fields[5].via.array.ptr[stream].as<std::string>());
+		}
+
+		handleRelayFrame(fields[2].as<int>(), framesPerUpdate, fields[4].as<uint64_t>(), frames);
+	} catch(std::exception &e) {
+		std::cerr << "RelayServer: invalid message from upstream server: " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void RelayServer::handleRelayFrame(int kind, std::size_t framesPerUpdate, uint64_t frameCount,
+		const ViewerServer::FrameSet &frames)
+{
+	switch(kind) {
+		case MsgPackProtocol::RELAY_FRAME_RESYNC:
+			// the upstream keyframes are aligned to all rates, so counting
+			// from here keeps the alignment
+			m_viewerServer.restart(frames);
+
+			m_frameCountOffset = frameCount;
+			m_lastFrameCount = frameCount;
+			m_synced = true;
+			break;
+
+		case MsgPackProtocol::RELAY_FRAME_KEYFRAME:
+			if(m_synced && (frameCount >= m_frameCountOffset) && (frameCount <= m_lastFrameCount)) {
+				m_viewerServer.setKeyframe(frames, frameCount - m_frameCountOffset);
+			}
+			break;
+
+		case MsgPackProtocol::RELAY_FRAME_UPDATE:
+			if(!m_synced) {
+				break;
+			}
+
+			if(framesPerUpdate == 1) {
+				if(frameCount != m_lastFrameCount + 1) {
+					std::cerr << "RelayServer: expected frame " << (m_lastFrameCount + 1) << ", got "
+						<< frameCount << ". Waiting for a resync." << std::endl;
+					m_synced = false;
+					break;
+				}
+
+				m_viewerServer.broadcast(frames);
+				m_lastFrameCount = frameCount;
+			} else if(frameCount == m_lastFrameCount) {
+				// merged updates follow the full-rate update of the same frame
+				m_viewerServer.broadcastAggregated(frames, framesPerUpdate);
+			}
+			break;
+
+		default:
+			std::cerr << "RelayServer: ignoring relay frame of unknown kind " << kind << std::endl;
+			break;
+	}
+}
+
+void RelayServer::sleep(double seconds)
+{
+	auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+
+	while(!m_shuttingDown && (std::chrono::steady_clock::now() < end)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_TIMEOUT_MS));
+	}
+}
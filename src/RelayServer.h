@@ -0,0 +1,101 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "ViewerServer.h"
+
+/*!
+ * \brief Rebroadcasts the viewer stream of another server.
+ *
+ * \details
+ * The relay connects to a game server (or another relay) as a viewer and
+ * registers with a RelayHello message (see MsgPackProtocol). The upstream
+ * server then sends the frames of all streams and rates together with its
+ * keyframes, which are passed to the relay's own ViewerServer. The relay's
+ * viewers are therefore served exactly like the upstream's, including
+ * backpressure, keyframes on join and relay clients of their own, while the
+ * upstream server only sends each frame once per relay.
+ *
+ * If the upstream server resyncs the relay (because it fell behind) or the
+ * connection is reestablished, the relay restarts its stream, so its viewers
+ * resync as well.
+ *
+ * Areas of interest and bot logs need the game state and are not relayed.
+ */
+class RelayServer
+{
+	public:
+		/*!
+		 * \param upstreamHost   Host name or address of the upstream server.
+		 * \param upstreamPort   Viewer port of the upstream server.
+		 * \param port           Port for the relay's TCP viewers.
+		 * \param webSocketPort  Port for the relay's WebSocket viewers, 0 to
+		 *                       disable.
+		 */
+		RelayServer(const std::string &upstreamHost, uint16_t upstreamPort, uint16_t port, uint16_t webSocketPort);
+		~RelayServer();
+
+		RelayServer(const RelayServer&) = delete;
+		RelayServer& operator=(const RelayServer&) = delete;
+
+		int Main();
+
+		void Shutdown(void);
+
+	private:
+		std::string m_upstreamHost;
+		uint16_t    m_upstreamPort;
+		uint16_t    m_port;
+		uint16_t    m_webSocketPort;
+
+		ViewerServer m_viewerServer;
+
+		int         m_socket = -1;
+		std::string m_inbound; //!< Incomplete message from upstream
+
+		bool     m_synced = false;       //!< A resync keyframe was received
+		uint64_t m_frameCountOffset = 0; //!< Upstream frame count of ViewerServer frame count 0
+		uint64_t m_lastFrameCount = 0;   //!< Upstream frame count of the last full-rate update
+
+		bool m_shuttingDown = false;
+
+		bool connectUpstream(void);
+		void disconnect(void);
+
+		/*!
+		 * Read from the upstream socket and handle complete messages.
+		 *
+		 * \returns  false if the connection was closed or the data is invalid.
+		 */
+		bool receive(void);
+
+		bool handleMessage(const char *data, std::size_t length);
+
+		void handleRelayFrame(int kind, std::size_t framesPerUpdate, uint64_t frameCount,
+				const ViewerServer::FrameSet &frames);
+
+		/*!
+		 * Sleep for the given time, returning early on shutdown.
+		 */
+		void sleep(double seconds);
+};
@@ -0,0 +1,385 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ReplayServer.h"
+
+/*!
+ * Map a whole file read-only.
+ *
+ * \returns  The mapping, or nullptr if the file cannot be mapped or is empty.
+ */
+static const char* mapFile(const std::string &path, std::size_t &size)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd == -1) {
+		std::cerr << "ReplayServer: cannot open " << path << ": " << strerror(errno) << std::endl;
+		return nullptr;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) == -1) {
+		std::cerr << "ReplayServer: fstat(" << path << ") failed: " << strerror(errno) << std::endl;
+		close(fd);
+		return nullptr;
+	}
+
+	size = st.st_size;
+	if(size == 0) {
+		close(fd);
+		return nullptr;
+	}
+
+	void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED) {
+		std::cerr << "ReplayServer: mmap(" << path << ") failed: " << strerror(errno) << std::endl;
+		return nullptr;
+	}
+
+	// records are mostly read in order
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	return static_cast<const char*>(data);
+}
+
+ReplayServer::ReplayServer(const std::string &directory, double speed, uint64_t startFrameCount)
+	: m_directory(directory)
+	, m_speed(speed)
+	, m_startFrameCount(startFrameCount)
+{
+	m_lastPlayed.fill(0);
+}
+
+ReplayServer::~ReplayServer()
+{
+	for(auto &segment: m_segments) {
+		if(segment.data) {
+			munmap(const_cast<char*>(segment.data), segment.dataSize);
+		}
+
+		if(segment.index) {
+			munmap(const_cast<StreamRecording::IndexEntry*>(segment.index), segment.indexMapSize);
+		}
+	}
+}
+
+int ReplayServer::Main()
+{
+	if(m_speed <= 0) {
+		std::cerr << "ReplayServer: invalid playback speed " << m_speed << std::endl;
+		return -1;
+	}
+
+	if(!loadSegments()) {
+		return -1;
+	}
+
+	std::size_t startSegment;
+	std::size_t startEntry;
+	if(!findStart(startSegment, startEntry)) {
+		std::cerr << "ReplayServer: the recording in " << m_directory << " contains no keyframe." << std::endl;
+		return -1;
+	}
+
+	if(!m_viewerServer.listen(9010, config::VIEWER_WEBSOCKET_PORT)) {
+		return -1;
+	}
+
+	const Segment &segment = m_segments[startSegment];
+	const StreamRecording::IndexEntry &keyframe = segment.index[startEntry];
+
+	// the ViewerServer counts from the start keyframe, which is aligned to all
+	// update rates
+	m_frameCountOffset = keyframe.frameCount;
+	m_lastPlayed.fill(keyframe.frameCount);
+
+	m_viewerServer.setKeyframe(getFrames(segment, keyframe), 0);
+
+	std::cerr << "Replaying " << m_directory << " from frame " << keyframe.frameCount
+	          << " at speed " << m_speed << std::endl;
+
+	m_nextFrameTime = getCurrentTimestamp();
+
+	bool playing = true;
+	for(std::size_t s = startSegment; playing && (s < m_segments.size()); s++) {
+		const Segment &current = m_segments[s];
+
+		for(std::size_t e = 0; e < current.entryCount; e++) {
+			if(m_shuttingDown || !play(current, current.index[e])) {
+				playing = false;
+				break;
+			}
+		}
+	}
+
+	if(!m_shuttingDown) {
+		std::cerr << "Replay finished at frame " << m_lastPlayed[0] << std::endl;
+	}
+
+	// keep serving the final state
+	while(!m_shuttingDown) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	return 0;
+}
+
+void ReplayServer::Shutdown(void)
+{
+	m_shuttingDown = true;
+}
+
+bool ReplayServer::loadSegments(void)
+{
+	DIR *dir = opendir(m_directory.c_str());
+	if(!dir) {
+		std::cerr << "ReplayServer: cannot open " << m_directory << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	std::vector<std::string> names;
+	std::string extension = StreamRecording::DATA_EXTENSION;
+
+	struct dirent *dirEntry;
+	while((dirEntry = readdir(dir)) != NULL) {
+		std::string fileName = dirEntry->d_name;
+
+		if((fileName.size() > extension.size())
+				&& (fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0)) {
+			names.push_back(fileName.substr(0, fileName.size() - extension.size()));
+		}
+	}
+
+	closedir(dir);
+
+	// names are zero-padded frame counts
+	std::sort(names.begin(), names.end());
+
+	for(auto &name: names) {
+		Segment segment;
+		segment.name = name;
+
+		if(mapSegment(segment)) {
+			m_segments.push_back(segment);
+		} else {
+			std::cerr << "ReplayServer: skipping segment " << name << std::endl;
+
+			if(segment.data) {
+				munmap(const_cast<char*>(segment.data), segment.dataSize);
+			}
+
+			if(segment.index) {
+				munmap(const_cast<StreamRecording::IndexEntry*>(segment.index), segment.indexMapSize);
+			}
+		}
+	}
+
+	if(m_segments.empty()) {
+		std::cerr << "ReplayServer: no segments found in " << m_directory << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool ReplayServer::mapSegment(Segment &segment)
+{
+	std::string path = m_directory + "/" + segment.name;
+
+	segment.data = mapFile(path + StreamRecording::DATA_EXTENSION, segment.dataSize);
+	if(!segment.data || (segment.dataSize < sizeof(StreamRecording::FileHeader))) {
+		return false;
+	}
+
+	StreamRecording::FileHeader header;
+	memcpy(&header, segment.data, sizeof(header));
+
+	if((memcmp(header.magic, StreamRecording::MAGIC, sizeof(header.magic)) != 0) || !(header.framesPerSecond > 0)) {
+		std::cerr << "ReplayServer: " << path << StreamRecording::DATA_EXTENSION << " is not a recording." << std::endl;
+		return false;
+	}
+
+	segment.framesPerSecond = header.framesPerSecond;
+
+	segment.index = reinterpret_cast<const StreamRecording::IndexEntry*>(
+			mapFile(path + StreamRecording::INDEX_EXTENSION, segment.indexMapSize));
+	if(!segment.index) {
+		return false;
+	}
+
+	// use the entries up to the first one that does not match the data,
+	// e.g. because the recorder stopped while writing
+	std::size_t entryCount = segment.indexMapSize / sizeof(StreamRecording::IndexEntry);
+
+	for(segment.entryCount = 0; segment.entryCount < entryCount; segment.entryCount++) {
+		const StreamRecording::IndexEntry &entry = segment.index[segment.entryCount];
+
+		if((entry.offset < sizeof(StreamRecording::FileHeader))
+				|| (entry.length < sizeof(StreamRecording::RecordHeader))
+				|| (entry.offset + entry.length > segment.dataSize)) {
+			break;
+		}
+
+		if(entry.type == StreamRecording::RECORD_FRAMES) {
+			if((entry.framesPerUpdate < 1) || (entry.framesPerUpdate > config::VIEWER_MAX_FRAMES_PER_UPDATE)) {
+				break;
+			}
+		} else if(entry.type != StreamRecording::RECORD_KEYFRAME) {
+			break;
+		}
+
+		StreamRecording::RecordHeader recordHeader;
+		memcpy(&recordHeader, segment.data + entry.offset, sizeof(recordHeader));
+
+		uint64_t length = sizeof(recordHeader);
+		for(auto size: recordHeader.sizes) {
+			length += size;
+		}
+
+		if(length != entry.length) {
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool ReplayServer::findStart(std::size_t &segmentIndex, std::size_t &entryIndex) const
+{
+	bool found = false;
+
+	for(std::size_t s = 0; s < m_segments.size(); s++) {
+		const Segment &segment = m_segments[s];
+
+		for(std::size_t e = 0; e < segment.entryCount; e++) {
+			const StreamRecording::IndexEntry &entry = segment.index[e];
+
+			if(entry.type != StreamRecording::RECORD_KEYFRAME) {
+				continue;
+			}
+
+			// the first keyframe is used if the start is before all others
+			if(!found || (entry.frameCount <= m_startFrameCount)) {
+				segmentIndex = s;
+				entryIndex = e;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+bool ReplayServer::play(const Segment &segment, const StreamRecording::IndexEntry &entry)
+{
+	if(entry.type == StreamRecording::RECORD_KEYFRAME) {
+		// later keyframes let resyncing viewers skip the frames before them
+		if((entry.frameCount > m_frameCountOffset) && (entry.frameCount <= m_lastPlayed[0])) {
+			m_viewerServer.setKeyframe(getFrames(segment, entry), entry.frameCount - m_frameCountOffset);
+		}
+
+		return true;
+	}
+
+	std::size_t framesPerUpdate = entry.framesPerUpdate;
+
+	// segments repeat the records since their keyframe
+	if(entry.frameCount <= m_lastPlayed[framesPerUpdate - 1]) {
+		return true;
+	}
+
+	if(framesPerUpdate == 1) {
+		if(entry.frameCount != m_lastPlayed[0] + 1) {
+			std::cerr << "ReplayServer: the recording has a gap after frame " << m_lastPlayed[0] << std::endl;
+			return false;
+		}
+
+		waitForNextFrame(1.0 / (segment.framesPerSecond * m_speed));
+
+		m_viewerServer.broadcast(getFrames(segment, entry));
+	} else {
+		// merged updates must follow the full-rate update of the same frame
+		if(entry.frameCount != m_lastPlayed[0]) {
+			return true;
+		}
+
+		m_viewerServer.broadcastAggregated(getFrames(segment, entry), framesPerUpdate);
+	}
+
+	m_lastPlayed[framesPerUpdate - 1] = entry.frameCount;
+	return true;
+}
+
+ViewerServer::FrameSet ReplayServer::getFrames(const Segment &segment, const StreamRecording::IndexEntry &entry) const
+{
+	const char *data = segment.data + entry.offset;
+
+	StreamRecording::RecordHeader header;
+	memcpy(&header, data, sizeof(header));
+	data += sizeof(header);
+
+	ViewerServer::FrameSet frames;
+	for(std::size_t stream = 0; stream < UpdateTracker::STREAM_COUNT; stream++) {
+		frames[stream] = std::make_shared<const std::string>(data, header.sizes[stream]);
+		data += header.sizes[stream];
+	}
+
+	return frames;
+}
+
+void ReplayServer::waitForNextFrame(double frameTime)
+{
+	struct timespec nextFrameTS;
+	nextFrameTS.tv_sec  = static_cast<time_t>(m_nextFrameTime);
+	nextFrameTS.tv_nsec = static_cast<long  >((m_nextFrameTime - nextFrameTS.tv_sec) * 1e9);
+
+	int ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &nextFrameTS, NULL);
+	if(ret == -1) {
+		std::cerr << "clock_nanosleep(CLOCK_MONOTONIC) failed: " << strerror(errno) << std::endl;
+	}
+
+	m_nextFrameTime += frameTime;
+}
+
+double ReplayServer::getCurrentTimestamp(void)
+{
+	struct timespec t;
+	int ret = clock_gettime(CLOCK_MONOTONIC, &t);
+	if(ret == -1) {
+		std::cerr << "clock_gettime(CLOCK_MONOTONIC) failed: " << strerror(errno) << std::endl;
+		return -1;
+	}
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
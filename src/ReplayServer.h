@@ -0,0 +1,125 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#include "StreamRecording.h"
+#include "ViewerServer.h"
+
+/*!
+ * \brief Serves a recorded game to the viewers without running the game.
+ *
+ * \details
+ * The segments of a recording (see StreamRecording) are memory-mapped and
+ * their records are passed to a ViewerServer in the order and at the rate
+ * they were recorded, scaled by the playback speed. Viewers connect and
+ * resync exactly like on the live server.
+ *
+ * Playback starts at the last recorded keyframe at or before the requested
+ * frame count and stops at the end of the recording or at a gap (where the
+ * recorder had to drop data); the server keeps running afterwards, so
+ * connected viewers keep the final state. Speed and start position are
+ * chosen when the server is started; all viewers watch the same playback.
+ *
+ * Areas of interest and bot logs are not recorded, viewers only get the
+ * shared stream.
+ */
+class ReplayServer
+{
+	public:
+		/*!
+		 * \param directory        Session directory created by StreamRecorder.
+		 * \param speed            Playback speed, 1 is real time.
+		 * \param startFrameCount  Frame count to start the playback at.
+		 */
+		ReplayServer(const std::string &directory, double speed, uint64_t startFrameCount);
+		~ReplayServer();
+
+		ReplayServer(const ReplayServer&) = delete;
+		ReplayServer& operator=(const ReplayServer&) = delete;
+
+		int Main();
+
+		void Shutdown(void);
+
+	private:
+		struct Segment {
+			std::string name;
+			const char *data = nullptr;
+			std::size_t dataSize = 0;
+			const StreamRecording::IndexEntry *index = nullptr;
+			std::size_t indexMapSize = 0;
+			std::size_t entryCount = 0;   //!< Number of valid index entries
+			double      framesPerSecond = 0;
+		};
+
+		std::string m_directory;
+		double      m_speed;
+		uint64_t    m_startFrameCount;
+
+		std::vector<Segment> m_segments;
+
+		ViewerServer m_viewerServer;
+
+		uint64_t m_frameCountOffset = 0; //!< Recorded frame count of ViewerServer frame count 0
+
+		//! Recorded frame count of the last played record by rate
+		std::array<uint64_t, config::VIEWER_MAX_FRAMES_PER_UPDATE> m_lastPlayed;
+
+		double m_nextFrameTime = 0;
+
+		bool m_shuttingDown = false;
+
+		/*!
+		 * Map all segments of the recording, sorted by frame count.
+		 */
+		bool loadSegments(void);
+
+		/*!
+		 * Map the files of a segment and determine the valid index entries.
+		 */
+		bool mapSegment(Segment &segment);
+
+		/*!
+		 * Find the keyframe to start the playback with.
+		 *
+		 * \returns  false if the recording contains no keyframe.
+		 */
+		bool findStart(std::size_t &segmentIndex, std::size_t &entryIndex) const;
+
+		/*!
+		 * Pass the record to the ViewerServer, waiting for its time if it
+		 * is a full-rate update.
+		 *
+		 * \returns  false if the playback must stop.
+		 */
+		bool play(const Segment &segment, const StreamRecording::IndexEntry &entry);
+
+		ViewerServer::FrameSet getFrames(const Segment &segment, const StreamRecording::IndexEntry &entry) const;
+
+		void waitForNextFrame(double frameTime);
+		double getCurrentTimestamp(void);
+};
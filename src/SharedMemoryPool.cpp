@@ -0,0 +1,156 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/vfs.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#include "SharedMemoryPool.h"
+
+// from linux/magic.h
+static const long HUGETLBFS_MAGIC_NUMBER = 0x958458f6;
+
+SharedMemoryPool::~SharedMemoryPool()
+{
+	for(auto &region: m_released) {
+		destroy(region);
+	}
+}
+
+SharedMemoryPool::Region SharedMemoryPool::acquire(const std::string &path, std::size_t minSize)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+
+		for(auto it = m_released.begin(); it != m_released.end(); it++) {
+			if((it->path == path) && (it->size >= minSize)) {
+				Region region = *it;
+				m_released.erase(it);
+
+				region.reused = true;
+				return region;
+			}
+		}
+	}
+
+	return create(path, minSize);
+}
+
+void SharedMemoryPool::release(const Region &region)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	m_released.push_back(region);
+
+	while(m_released.size() > config::BOT_SHM_POOL_SIZE) {
+		destroy(m_released.front());
+		m_released.pop_front();
+	}
+}
+
+void SharedMemoryPool::prefault(void *addr, std::size_t len)
+{
+	if(len == 0) {
+		return;
+	}
+
+	const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr) & ~(pageSize - 1);
+	uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + len + pageSize - 1) & ~(pageSize - 1);
+
+#ifdef MADV_POPULATE_WRITE
+	if(madvise(reinterpret_cast<void*>(begin), end - begin, MADV_POPULATE_WRITE) == 0) {
+		return;
+	}
+#endif
+
+	// fallback for older kernels: write every page once without changing it
+	for(uintptr_t page = begin; page < end; page += pageSize) {
+		volatile uint8_t *p = reinterpret_cast<volatile uint8_t*>(page);
+		*p = *p;
+	}
+}
+
+SharedMemoryPool::Region SharedMemoryPool::create(const std::string &path, std::size_t minSize)
+{
+	int fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+	if(fd == -1) {
+		std::cerr << "[" << path << "] open() failed: " << strerror(errno) << std::endl;
+		throw std::runtime_error("Failed to set up shared memory.");
+	}
+
+	struct statfs fsInfo;
+	bool hugetlbfs = (fstatfs(fd, &fsInfo) == 0) && (fsInfo.f_type == HUGETLBFS_MAGIC_NUMBER);
+
+	std::size_t size = minSize;
+	if(hugetlbfs) {
+		// size must be a multiple of the huge page size
+		std::size_t hugePageSize = fsInfo.f_bsize;
+		size = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+	}
+
+	// truncate first to discard contents left over from a previous server run
+	if((ftruncate(fd, 0) == -1) || (ftruncate(fd, size) == -1)) {
+		std::cerr << "[" << path << "] ftruncate() failed: " << strerror(errno) << std::endl;
+		close(fd);
+		throw std::runtime_error("Failed to set up shared memory.");
+	}
+
+	// huge pages are few and large, so populating the whole mapping is cheap
+	int flags = MAP_SHARED;
+	if(hugetlbfs) {
+		flags |= MAP_POPULATE;
+	}
+
+	void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+	if(addr == MAP_FAILED) {
+		std::cerr << "[" << path << "] mmap() failed: " << strerror(errno) << std::endl;
+		close(fd);
+		throw std::runtime_error("Failed to set up shared memory.");
+	}
+
+#ifdef MADV_HUGEPAGE
+	if(!hugetlbfs) {
+		// only effective on tmpfs with shmem_enabled=advise; failure is harmless
+		madvise(addr, size, MADV_HUGEPAGE);
+	}
+#endif
+
+	return Region{path, fd, addr, size, false};
+}
+
+void SharedMemoryPool::destroy(const Region &region)
+{
+	int ret = munmap(region.addr, region.size);
+	if(ret == -1) {
+		std::cerr << "[" << region.path << "] munmap() failed: " << strerror(errno) << std::endl;
+	}
+
+	close(region.fd);
+}
@@ -0,0 +1,96 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+
+/*!
+ * \brief Keeps bot shared memory regions mapped across bot restarts.
+ *
+ * \details
+ * Setting up a fresh shared memory region is expensive: the file has to be
+ * created and every page is faulted in on first access, which would otherwise
+ * happen in the worker threads during the bot's first frames.
+ *
+ * Released regions are kept mapped (up to config::BOT_SHM_POOL_SIZE) and
+ * handed out again when a bot with the same shared memory path respawns. The
+ * file stays the same, so the bind mount into the bot container still works.
+ *
+ * If the file lives on a hugetlbfs mount, it is mapped with MAP_POPULATE and
+ * backed by huge pages. On other file systems, transparent huge pages are
+ * requested and the caller prefaults the parts it will use with prefault().
+ */
+class SharedMemoryPool
+{
+	public:
+		struct Region {
+			std::string path;
+			int         fd = -1;
+			void       *addr = nullptr;
+			std::size_t size = 0;
+			bool        reused = false; //!< Region was taken from the pool (contents are stale)
+		};
+
+		/*!
+		 * \brief Get a mapped region for the given file.
+		 *
+		 * Reuses a released region for the same path if available. Otherwise,
+		 * the file is created (discarding any old contents) and mapped.
+		 *
+		 * \param path     Path of the shared memory file.
+		 * \param minSize  Minimum size of the region in bytes.
+		 *
+		 * \throws std::runtime_error if the region cannot be set up.
+		 */
+		Region acquire(const std::string &path, std::size_t minSize);
+
+		/*!
+		 * \brief Return a region to the pool.
+		 *
+		 * If the pool is full, the least recently released region is unmapped.
+		 */
+		void release(const Region &region);
+
+		/*!
+		 * \brief Fault in the pages of the given range.
+		 *
+		 * Uses MADV_POPULATE_WRITE where available and falls back to touching
+		 * every page. The contents are not modified.
+		 */
+		static void prefault(void *addr, std::size_t len);
+
+		static SharedMemoryPool& instance(void)
+		{
+			static SharedMemoryPool theOneAndOnly;
+			return theOneAndOnly;
+		}
+
+	private:
+		std::mutex        m_mutex;
+		std::list<Region> m_released; //!< Least recently released first
+
+		SharedMemoryPool() {}
+		~SharedMemoryPool();
+
+		static Region create(const std::string &path, std::size_t minSize);
+		static void destroy(const Region &region);
+};
@@ -23,6 +23,7 @@
 #include "Field.h"
 
 #include "Snake.h"
+#include "SnakeGeometryTable.h"
 
 Snake::Snake(Field *field)
 	: m_field(field), m_mass(1.0f), m_heading(0.0f)
@@ -45,9 +46,9 @@ Snake::Snake(Field *field, const Vector2D &startPos, real_t start_mass,
 
 void Snake::ensureSizeMatchesMass(void)
 {
-	m_targetSegmentDistance = pow(
-			m_mass * config::SNAKE_SEGMENT_DISTANCE_FACTOR,
-			config::SNAKE_SEGMENT_DISTANCE_EXPONENT);
+	SnakeGeometryTable::Geometry geometry = SnakeGeometryTable::instance().lookup(m_mass);
+
+	m_targetSegmentDistance = geometry.segmentDistance;
 
 	std::size_t curLen = m_segments.size();
 	std::size_t targetLen = static_cast<std::size_t>(
@@ -72,21 +73,8 @@ void Snake::ensureSizeMatchesMass(void)
 		m_segments.resize(targetLen);
 	}
 
-	// update segment radius
-	m_segmentRadius = std::pow((20*m_mass+100), 0.3) - 3.9810717055349722;
-	//                                    100**0.3 --------^
-}
-
-real_t Snake::maxRotationPerStep(void)
-{
-	real_t arg = config::SNAKE_DISTANCE_PER_STEP /
-			(2 * m_segmentRadius * (1 + config::SNAKE_TURN_RADIUS_FACTOR));
-
-	if(arg >= 1 || arg <= -1) {
-		return M_PI/2;
-	}
-
-	return 2 * std::asin(arg);
+	m_segmentRadius = geometry.segmentRadius;
+	m_maxRotationPerStep = geometry.maxRotationPerStep;
 }
 
 void Snake::consume(const Food& food)
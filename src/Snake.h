@@ -67,6 +67,7 @@ class Snake
 
 		real_t m_segmentRadius; //!< Segment radius (calculated from m_mass; cached)
 		real_t m_targetSegmentDistance; //!< Distance between the segments
+		real_t m_maxRotationPerStep; //!< Maximum heading change per step (calculated from m_mass; cached)
 
 		real_t m_movedSinceLastSpawn = 0; //!< Distance the head has moved since the last spawned segment
 
@@ -84,6 +85,7 @@ class Snake
 
 		/*!
 		 * Updates the length of m_segments and calculates the current m_segmentRadius
+		 * and the other mass dependent parameters, see SnakeGeometryTable.
 		 */
 		void ensureSizeMatchesMass(void);
 
@@ -117,6 +119,11 @@ class Snake
 		 */
 		real_t getSegmentRadius(void) const;
 
+		/*!
+		 * Get the distance between two segments the Snake aims for.
+		 */
+		real_t getTargetSegmentDistance(void) const { return m_targetSegmentDistance; }
+
 		/*!
 		 * Check if this Snake can consume the given Food.
 		 */
@@ -153,7 +160,7 @@ class Snake
 
 		real_t getConsumeRadius(void);
 
-		real_t maxRotationPerStep(void);
+		real_t maxRotationPerStep(void) const { return m_maxRotationPerStep; }
 
 		bool boostedLastMove(void) const { return m_boostedLastMove; }
 
@@ -0,0 +1,88 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "config.h"
+
+#include "SnakeGeometryTable.h"
+
+/*!
+ * The formulas in double precision, for building the table.
+ */
+static void calculateExact(double mass, double &segmentDistance, double &segmentRadius, double &maxRotationPerStep)
+{
+	segmentDistance = std::pow(
+			mass * config::SNAKE_SEGMENT_DISTANCE_FACTOR,
+			config::SNAKE_SEGMENT_DISTANCE_EXPONENT);
+
+	segmentRadius = std::pow((20*mass+100), 0.3) - 3.9810717055349722;
+	//                                    100**0.3 --------^
+
+	double arg = config::SNAKE_DISTANCE_PER_STEP /
+			(2 * segmentRadius * (1 + config::SNAKE_TURN_RADIUS_FACTOR));
+
+	if(arg >= 1 || arg <= -1) {
+		maxRotationPerStep = M_PI/2;
+	} else {
+		maxRotationPerStep = 2 * std::asin(arg);
+	}
+}
+
+SnakeGeometryTable::Geometry SnakeGeometryTable::calculate(real_t mass)
+{
+	double segmentDistance, segmentRadius, maxRotationPerStep;
+	calculateExact(mass, segmentDistance, segmentRadius, maxRotationPerStep);
+
+	return {
+		static_cast<real_t>(segmentDistance),
+		static_cast<real_t>(segmentRadius),
+		static_cast<real_t>(maxRotationPerStep)
+	};
+}
+
+SnakeGeometryTable::SnakeGeometryTable()
+{
+	for(uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+		// bucket boundaries are exactly representable
+		double startMass = std::ldexp(1.0 + static_cast<double>(bucket % (1u << SUBDIVISION_BITS)) / (1u << SUBDIVISION_BITS),
+				MIN_MASS_EXPONENT + static_cast<int>(bucket >> SUBDIVISION_BITS));
+		double endMass = startMass + std::ldexp(1.0,
+				MIN_MASS_EXPONENT + static_cast<int>(bucket >> SUBDIVISION_BITS) - static_cast<int>(SUBDIVISION_BITS));
+
+		double startDistance, startRadius, startRotation;
+		double endDistance, endRadius, endRotation;
+		calculateExact(startMass, startDistance, startRadius, startRotation);
+		calculateExact(endMass, endDistance, endRadius, endRotation);
+
+		double massRange = endMass - startMass;
+
+		Entry &e = m_entries[bucket];
+		e.mass = static_cast<real_t>(startMass);
+		e.value = {
+			static_cast<real_t>(startDistance),
+			static_cast<real_t>(startRadius),
+			static_cast<real_t>(startRotation)
+		};
+		e.slope = {
+			static_cast<real_t>((endDistance - startDistance) / massRange),
+			static_cast<real_t>((endRadius - startRadius) / massRange),
+			static_cast<real_t>((endRotation - startRotation) / massRange)
+		};
+	}
+}
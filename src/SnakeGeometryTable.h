@@ -0,0 +1,115 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "types.h"
+
+/*!
+ * \brief Lookup table for the geometry of a Snake as a function of its mass.
+ *
+ * \details
+ * The segment distance, segment radius and maximum rotation per step are
+ * tabulated for masses from 2^MIN_MASS_EXPONENT to 2^MAX_MASS_EXPONENT. Each
+ * power of two is divided into 2^SUBDIVISION_BITS buckets of equal size, so
+ * the bucket of a mass is given by the exponent and the upper mantissa bits
+ * of its float representation. Within a bucket, the values are interpolated
+ * linearly.
+ *
+ * The maximum relative error of the interpolated values compared to
+ * calculate() is MAX_RELATIVE_ERROR, which is reached by the maximum rotation
+ * at the smallest masses. The segment distance is accurate to 7e-6 and the
+ * segment radius to 1.1e-5. Masses outside of the table are calculated
+ * directly: below it, the maximum rotation approaches its limit of π/2 with
+ * a slope that linear interpolation cannot follow.
+ */
+class SnakeGeometryTable
+{
+	public:
+		struct Geometry {
+			real_t segmentDistance;    //!< Target distance between two segments
+			real_t segmentRadius;
+			real_t maxRotationPerStep; //!< Maximum heading change per step in radians
+		};
+
+		static constexpr const int MIN_MASS_EXPONENT = 2;
+		static constexpr const int MAX_MASS_EXPONENT = 31;
+		static constexpr const unsigned SUBDIVISION_BITS = 6;
+
+		//! Maximum relative error of lookup() compared to calculate().
+		static constexpr const real_t MAX_RELATIVE_ERROR = 6e-5;
+
+		/*!
+		 * Calculate the geometry for the given mass using the formulas.
+		 */
+		static Geometry calculate(real_t mass);
+
+		/*!
+		 * Get the geometry for the given mass from the table.
+		 */
+		Geometry lookup(real_t mass) const
+		{
+			static_assert(sizeof(real_t) == sizeof(uint32_t), "bucket index requires real_t == float");
+
+			uint32_t bits;
+			std::memcpy(&bits, &mass, sizeof(bits));
+
+			// negative masses and NaN are out of range, too
+			uint32_t bucket = (bits >> (23 - SUBDIVISION_BITS)) - FIRST_BUCKET_BITS;
+			if(bucket >= BUCKET_COUNT) {
+				return calculate(mass);
+			}
+
+			const Entry &e = m_entries[bucket];
+			real_t offset = mass - e.mass;
+
+			return {
+				e.value.segmentDistance + e.slope.segmentDistance * offset,
+				e.value.segmentRadius + e.slope.segmentRadius * offset,
+				e.value.maxRotationPerStep + e.slope.maxRotationPerStep * offset
+			};
+		}
+
+		static const SnakeGeometryTable& instance(void)
+		{
+			static const SnakeGeometryTable theOneAndOnly;
+			return theOneAndOnly;
+		}
+
+	private:
+		static constexpr const uint32_t BUCKET_COUNT =
+			(MAX_MASS_EXPONENT - MIN_MASS_EXPONENT) << SUBDIVISION_BITS;
+
+		//! Bucket index part of the float representation of 2^MIN_MASS_EXPONENT
+		static constexpr const uint32_t FIRST_BUCKET_BITS =
+			static_cast<uint32_t>(127 + MIN_MASS_EXPONENT) << SUBDIVISION_BITS;
+
+		struct Entry {
+			real_t   mass;  //!< Mass at the start of the bucket
+			Geometry value; //!< Geometry at the start of the bucket
+			Geometry slope; //!< Change of the geometry per mass within the bucket
+		};
+
+		std::array<Entry, BUCKET_COUNT> m_entries;
+
+		SnakeGeometryTable();
+};
@@ -17,7 +17,9 @@
  */
 
 #pragma once
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <vector>
 #include <functional>
 #include "types.h"
@@ -89,6 +91,84 @@ template <class T, size_t TILES_X, size_t TILES_Y> class SpatialMap
 			};
 		}
 
+		/*!
+		 * Region of all tiles intersecting the given rectangle. The rectangle
+		 * may extend beyond the field borders, but must not be larger than
+		 * the field.
+		 */
+		Region getRectRegion(const Vector2D& topLeft, const Vector2D& size)
+		{
+			const Vector2D bottomRight = topLeft + size;
+			return {
+				*this,
+				static_cast<int>(std::floor(topLeft.x() / m_tileSizeX)),
+				static_cast<int>(std::floor(topLeft.y() / m_tileSizeY)),
+				static_cast<int>(std::floor(bottomRight.x() / m_tileSizeX)),
+				static_cast<int>(std::floor(bottomRight.y() / m_tileSizeY))
+			};
+		}
+
+		/*!
+		 * Visit the tiles of getRegion(center, radius) in the same order,
+		 * skipping tiles whose area is not closer to the center than the
+		 * distance returned by reach() for them.
+		 *
+		 * \param reach   Called with a tile index (see getTileIndex()),
+		 *                returns the distance up to which the tile is of
+		 *                interest.
+		 * \param visit   Called with the elements of each remaining tile.
+		 *                Returning false stops the search.
+		 */
+		template <class ReachFunction, class VisitFunction>
+		void visitTilesInReach(const Vector2D& center, real_t radius, ReachFunction reach, VisitFunction visit)
+		{
+			// same tile range as getRegion()
+			const int x1 = static_cast<int>((center.x() - radius) / m_tileSizeX);
+			const int y1 = static_cast<int>((center.y() - radius) / m_tileSizeY);
+			const int x2 = static_cast<int>((center.x() + radius) / m_tileSizeX);
+			const int y2 = static_cast<int>((center.y() + radius) / m_tileSizeY);
+
+			for (int tileY = y1; tileY <= y2; tileY++)
+			{
+				// distance of the center to the tile area, in unwrapped coordinates
+				real_t dy = std::max(std::max(tileY*m_tileSizeY - center.y(), center.y() - (tileY+1)*m_tileSizeY), real_t(0));
+
+				for (int tileX = x1; tileX <= x2; tileX++)
+				{
+					real_t dx = std::max(std::max(tileX*m_tileSizeX - center.x(), center.x() - (tileX+1)*m_tileSizeX), real_t(0));
+
+					size_t index = wrap<TILES_Y>(tileY)*TILES_X + wrap<TILES_X>(tileX);
+					real_t maxDistance = reach(index);
+
+					if ((dx*dx + dy*dy) >= (maxDistance*maxDistance))
+					{
+						continue;
+					}
+
+					if (!visit(m_tiles[index]))
+					{
+						return;
+					}
+				}
+			}
+		}
+
+		/*!
+		 * Index of the tile containing the given position, see
+		 * visitTilesInReach().
+		 */
+		size_t getTileIndex(const Vector2D& pos) const
+		{
+			size_t tileX = wrap<TILES_X>(pos.x() / m_tileSizeX);
+			size_t tileY = wrap<TILES_Y>(pos.y() / m_tileSizeY);
+			return tileY*TILES_X + tileX;
+		}
+
+		static constexpr size_t getTileCount()
+		{
+			return TILES_X*TILES_Y;
+		}
+
 		typename Region::Iterator begin()
 		{
 			return m_fullRegion.begin();
@@ -117,9 +197,7 @@ template <class T, size_t TILES_X, size_t TILES_Y> class SpatialMap
 
 		TileVector& getTileVectorForPosition(const Vector2D& pos)
 		{
-			size_t tileX = wrap<TILES_X>(pos.x() / m_tileSizeX);
-			size_t tileY = wrap<TILES_Y>(pos.y() / m_tileSizeY);
-			return m_tiles[tileY*TILES_X + tileX];
+			return m_tiles[getTileIndex(pos)];
 		}
 
 		template <size_t SIZE> static size_t wrap(int unwrapped)
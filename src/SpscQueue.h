@@ -0,0 +1,93 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/*!
+ * \brief Bounded lock-free queue for exactly one producer and one consumer
+ * thread.
+ *
+ * \details
+ * The items are stored in a ring buffer whose size is rounded up to a power
+ * of two. Producer and consumer only synchronize through the two atomic
+ * indices, which live on separate cache lines.
+ */
+template<typename T>
+class SpscQueue
+{
+	public:
+		explicit SpscQueue(std::size_t capacity)
+		{
+			std::size_t size = 1;
+			while(size < capacity) {
+				size *= 2;
+			}
+
+			m_items.resize(size);
+			m_mask = size - 1;
+		}
+
+		/*!
+		 * Append an item. Only called by the producer thread.
+		 *
+		 * \returns   false if the queue is full. The item is left untouched
+		 *            in that case.
+		 */
+		bool push(T &&item)
+		{
+			std::size_t tail = m_tail.load(std::memory_order_relaxed);
+
+			if((tail - m_head.load(std::memory_order_acquire)) == m_items.size()) {
+				return false;
+			}
+
+			m_items[tail & m_mask] = std::move(item);
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		/*!
+		 * Remove the oldest item. Only called by the consumer thread.
+		 *
+		 * \returns   false if the queue is empty.
+		 */
+		bool pop(T &item)
+		{
+			std::size_t head = m_head.load(std::memory_order_relaxed);
+
+			if(head == m_tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+
+			item = std::move(m_items[head & m_mask]);
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		std::vector<T> m_items;
+		std::size_t    m_mask;
+
+		alignas(64) std::atomic<std::size_t> m_head{0}; //!< Next item to pop
+		alignas(64) std::atomic<std::size_t> m_tail{0}; //!< Next free slot
+};
@@ -0,0 +1,267 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "config.h"
+
+#include "StreamRecorder.h"
+
+StreamRecorder::StreamRecorder(const std::string &baseDirectory, double framesPerSecond)
+	: m_records(config::RECORDER_QUEUE_SIZE)
+	, m_framesPerSecond(framesPerSecond)
+{
+	time_t now = time(nullptr);
+	struct tm utc;
+	gmtime_r(&now, &utc);
+
+	char sessionName[32];
+	strftime(sessionName, sizeof(sessionName), "%Y%m%d-%H%M%S", &utc);
+
+	m_directory = baseDirectory + "/" + sessionName;
+
+	if(mkdir(m_directory.c_str(), 0755) == -1) {
+		std::cerr << "StreamRecorder: mkdir(" << m_directory << ") failed: " << strerror(errno) << std::endl;
+		throw std::runtime_error("Failed to create the recording directory.");
+	}
+
+	m_thread = std::thread([this] () { run(); });
+
+	// remove this code if it does not compile on your system. It does not affect
+	// the program's functionality.
+	pthread_setname_np(m_thread.native_handle(), "recorder");
+}
+
+StreamRecorder::~StreamRecorder()
+{
+	m_shutdown = true;
+	m_semaphore.post();
+
+	m_thread.join();
+}
+
+void StreamRecorder::recordFrames(const FrameSet &frames, std::size_t framesPerUpdate, uint64_t frameCount)
+{
+	Record record;
+	record.type = StreamRecording::RECORD_FRAMES;
+	record.framesPerUpdate = framesPerUpdate;
+	record.frameCount = frameCount;
+	record.frames = frames;
+
+	push(std::move(record));
+}
+
+void StreamRecorder::recordKeyframe(const FrameSet &keyframe, uint64_t frameCount)
+{
+	Record record;
+	record.type = StreamRecording::RECORD_KEYFRAME;
+	record.frameCount = frameCount;
+	record.frames = keyframe;
+
+	push(std::move(record));
+}
+
+void StreamRecorder::push(Record &&record)
+{
+	if(m_dropping) {
+		record.droppedFrameCount = m_droppedFrameCount;
+	}
+
+	if(!m_records.push(std::move(record))) {
+		if(!m_dropping) {
+			std::cerr << "StreamRecorder: writer thread is falling behind, dropping records." << std::endl;
+		}
+
+		// a dropped keyframe needs no special handling: there will be another one
+		if(record.type == StreamRecording::RECORD_FRAMES) {
+			m_droppedFrameCount = std::max(m_droppedFrameCount, record.frameCount);
+		}
+
+		m_dropping = true;
+		return;
+	}
+
+	m_dropping = false;
+	m_semaphore.post();
+}
+
+void StreamRecorder::run(void)
+{
+	Record record;
+
+	while(true) {
+		m_semaphore.wait();
+
+		while(m_records.pop(record)) {
+			handleRecord(record);
+		}
+
+		if(m_shutdown) {
+			break;
+		}
+	}
+
+	closeSegment();
+}
+
+void StreamRecorder::handleRecord(const Record &record)
+{
+	if(record.droppedFrameCount != 0) {
+		// the current segment is incomplete now
+		closeSegment();
+		m_recentRecords.clear();
+		m_minKeyframeCount = std::max(m_minKeyframeCount, record.droppedFrameCount);
+	}
+
+	if(record.type == StreamRecording::RECORD_KEYFRAME) {
+		handleKeyframe(record);
+		return;
+	}
+
+	// keyframes arrive some frames after their state was captured, so the
+	// records since then are needed to start a segment
+	m_recentRecords.push_back(record);
+
+	while(m_recentRecords.front().frameCount + config::VIEWER_MAX_BUFFERED_FRAMES < record.frameCount) {
+		m_recentRecords.pop_front();
+	}
+
+	if(m_segmentOpen) {
+		writeRecord(record);
+	}
+}
+
+void StreamRecorder::handleKeyframe(const Record &record)
+{
+	uint64_t keyframeFrameCount = record.frameCount;
+
+	if(keyframeFrameCount < m_minKeyframeCount) {
+		return;
+	}
+
+	if(m_segmentOpen && (keyframeFrameCount < m_lastKeyframeCount + config::RECORDER_KEYFRAME_INTERVAL)) {
+		return;
+	}
+
+	if(!m_segmentOpen || (keyframeFrameCount >= m_segmentFrameCount + config::RECORDER_SEGMENT_FRAMES)) {
+		// the records following the keyframe must still be available
+		if(!m_recentRecords.empty() && (m_recentRecords.front().frameCount > keyframeFrameCount + 1)) {
+			return;
+		}
+
+		closeSegment();
+		openSegment(keyframeFrameCount);
+
+		if(!m_segmentOpen) {
+			return;
+		}
+
+		writeRecord(record);
+
+		for(auto &recentRecord: m_recentRecords) {
+			if(recentRecord.frameCount > keyframeFrameCount) {
+				writeRecord(recentRecord);
+			}
+		}
+	} else {
+		writeRecord(record);
+	}
+
+	m_lastKeyframeCount = keyframeFrameCount;
+}
+
+void StreamRecorder::openSegment(uint64_t keyframeFrameCount)
+{
+	std::string path = m_directory + "/" + StreamRecording::getSegmentName(keyframeFrameCount);
+
+	m_data.open(path + StreamRecording::DATA_EXTENSION, std::ios::binary | std::ios::trunc);
+	m_index.open(path + StreamRecording::INDEX_EXTENSION, std::ios::binary | std::ios::trunc);
+
+	if(!m_data.is_open() || !m_index.is_open()) {
+		std::cerr << "StreamRecorder: cannot create segment " << path << ": " << strerror(errno) << std::endl;
+		closeSegment();
+		return;
+	}
+
+	StreamRecording::FileHeader header;
+	memcpy(header.magic, StreamRecording::MAGIC, sizeof(header.magic));
+	header.framesPerSecond = m_framesPerSecond;
+
+	m_data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	m_dataOffset = sizeof(header);
+	m_segmentFrameCount = keyframeFrameCount;
+	m_segmentOpen = true;
+}
+
+void StreamRecorder::closeSegment(void)
+{
+	m_data.close();
+	m_index.close();
+	m_segmentOpen = false;
+}
+
+void StreamRecorder::writeRecord(const Record &record)
+{
+	StreamRecording::RecordHeader header;
+	uint64_t length = sizeof(header);
+
+	for(std::size_t stream = 0; stream < UpdateTracker::STREAM_COUNT; stream++) {
+		header.sizes[stream] = record.frames[stream]->size();
+		length += record.frames[stream]->size();
+	}
+
+	m_data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for(auto &frame: record.frames) {
+		m_data.write(frame->data(), frame->size());
+	}
+
+	// the index entry must not refer to data that is not on disk yet
+	m_data.flush();
+
+	StreamRecording::IndexEntry entry;
+	entry.frameCount = record.frameCount;
+	entry.offset = m_dataOffset;
+	entry.length = length;
+	entry.type = record.type;
+	entry.framesPerUpdate = record.framesPerUpdate;
+	entry.reserved = 0;
+
+	m_index.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+	m_index.flush();
+
+	m_dataOffset += length;
+
+	if(!m_data.good() || !m_index.good()) {
+		std::cerr << "StreamRecorder: write error, stopping segment " << StreamRecording::getSegmentName(m_segmentFrameCount) << std::endl;
+		closeSegment();
+
+		// the next segment must not depend on the failed record
+		m_minKeyframeCount = std::max(m_minKeyframeCount, record.frameCount);
+	}
+}
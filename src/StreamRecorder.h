@@ -0,0 +1,127 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "Semaphore.h"
+#include "SpscQueue.h"
+#include "StreamRecording.h"
+#include "UpdateTracker.h"
+
+/*!
+ * \brief Records the viewer stream to segmented files for later replay.
+ *
+ * \details
+ * The game thread passes every broadcast update and every keyframe to the
+ * recorder, which queues references to the shared frame buffers for a
+ * writer thread. File I/O therefore never delays a frame.
+ *
+ * Each session is recorded into a new subdirectory named after its start
+ * time, see StreamRecording for the format. Not every viewer keyframe is
+ * recorded, only one every config::RECORDER_KEYFRAME_INTERVAL frames, which
+ * is the seek granularity of a replay. A new segment is started with the
+ * first recorded keyframe after config::RECORDER_SEGMENT_FRAMES frames.
+ *
+ * If the writer thread cannot keep up and the queue overflows, the records
+ * are dropped and the current segment is closed. Recording continues with a
+ * new segment at the next keyframe that does not depend on the lost records.
+ */
+class StreamRecorder
+{
+	public:
+		typedef UpdateTracker::FrameSet FrameSet;
+
+		/*!
+		 * \brief Start a new recording session.
+		 *
+		 * \param baseDirectory    Directory for the session subdirectories.
+		 * \param framesPerSecond  Frame rate of the game, stored for the replay.
+		 *
+		 * \throws std::runtime_error  if the session directory cannot be created.
+		 */
+		StreamRecorder(const std::string &baseDirectory, double framesPerSecond);
+		~StreamRecorder();
+
+		StreamRecorder(const StreamRecorder&) = delete;
+		StreamRecorder& operator=(const StreamRecorder&) = delete;
+
+		/*!
+		 * \brief Record an update as broadcast to the viewers.
+		 *
+		 * \param frameCount  ViewerServer::getFrameCount() after the broadcast.
+		 */
+		void recordFrames(const FrameSet &frames, std::size_t framesPerUpdate, uint64_t frameCount);
+
+		/*!
+		 * \brief Record a keyframe as passed to ViewerServer::setKeyframe().
+		 */
+		void recordKeyframe(const FrameSet &keyframe, uint64_t frameCount);
+
+		const std::string& getDirectory(void) const { return m_directory; }
+
+	private:
+		struct Record {
+			StreamRecording::RecordType type = StreamRecording::RECORD_FRAMES;
+			std::size_t framesPerUpdate = 1;
+			uint64_t    frameCount = 0;
+			FrameSet    frames;
+			uint64_t    droppedFrameCount = 0; //!< Last frame count dropped before this record, if any
+		};
+
+		// shared
+		SpscQueue<Record> m_records;
+		Semaphore         m_semaphore;
+		std::atomic<bool> m_shutdown{false};
+		std::thread       m_thread;
+
+		std::string m_directory;
+		double      m_framesPerSecond;
+
+		// game thread
+		bool     m_dropping = false;
+		uint64_t m_droppedFrameCount = 0;
+
+		// writer thread
+		std::deque<Record> m_recentRecords; //!< Not yet covered by a recorded keyframe
+		std::ofstream m_data;
+		std::ofstream m_index;
+		bool          m_segmentOpen = false;
+		uint64_t      m_dataOffset = 0;
+		uint64_t      m_segmentFrameCount = 0;  //!< Frame count of the segment's keyframe
+		uint64_t      m_lastKeyframeCount = 0;
+		uint64_t      m_minKeyframeCount = 0;   //!< Earlier keyframes lack records after them
+
+		void push(Record &&record);
+
+		void run(void);
+
+		void handleRecord(const Record &record);
+		void handleKeyframe(const Record &record);
+
+		void openSegment(uint64_t keyframeFrameCount);
+		void closeSegment(void);
+		void writeRecord(const Record &record);
+};
@@ -0,0 +1,95 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "UpdateTracker.h"
+
+/*!
+ * \brief File format of recorded game streams.
+ *
+ * \details
+ * A recording is a directory of segments. Each segment consists of a data
+ * file (DATA_EXTENSION) and an index file (INDEX_EXTENSION), both named
+ * after the frame count of the keyframe the segment starts with, so a
+ * segment can be replayed without the ones before it.
+ *
+ * The data file starts with a FileHeader, followed by the records. A record
+ * is a RecordHeader followed by the serialized frame in every
+ * UpdateTracker::Stream format, in stream order.
+ *
+ * The index file is an array of IndexEntry, one per record, in the order the
+ * records were written. Entries are appended after their record, so a
+ * truncated segment (e.g. after a crash) is still readable up to its last
+ * index entry.
+ *
+ * Frame counts are those of ViewerServer::getFrameCount(). Records of a
+ * lower rate (framesPerUpdate > 1) follow the full-rate record of the same
+ * frame count. A keyframe with frame count K is followed by all records with
+ * a frame count greater than K; records before it in the same segment may
+ * also have a frame count greater than K, as keyframes are finished some
+ * frames after their state was captured.
+ *
+ * All values are stored in host byte order.
+ */
+namespace StreamRecording
+{
+	static const char MAGIC[8] = {'S', 'P', 'N', 'R', 'E', 'C', '0', '1'};
+
+	static constexpr const char *DATA_EXTENSION = ".spnrec";
+	static constexpr const char *INDEX_EXTENSION = ".spnidx";
+
+	enum RecordType : uint8_t
+	{
+		RECORD_FRAMES = 0,   //!< Update broadcast to the viewers
+		RECORD_KEYFRAME = 1, //!< Full world state
+	};
+
+	struct FileHeader {
+		char   magic[8];
+		double framesPerSecond; //!< Frame rate of the recorded game
+	};
+
+	struct RecordHeader {
+		uint32_t sizes[UpdateTracker::STREAM_COUNT];
+	};
+
+	struct IndexEntry {
+		uint64_t frameCount;
+		uint64_t offset;          //!< Position of the RecordHeader in the data file
+		uint32_t length;          //!< Length of the record including its header
+		uint8_t  type;            //!< RecordType
+		uint8_t  framesPerUpdate; //!< Rate of a RECORD_FRAMES record
+		uint16_t reserved;
+	};
+
+	/*!
+	 * File name of a segment without extension.
+	 */
+	inline std::string getSegmentName(uint64_t keyframeFrameCount)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%012llu", static_cast<unsigned long long>(keyframeFrameCount));
+		return name;
+	}
+}
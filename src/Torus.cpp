@@ -0,0 +1,60 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Torus.h"
+
+void Torus::unwrapRelative(real_t *x, real_t *y, std::size_t n) const
+{
+	std::size_t i = 0;
+
+#ifdef __SSE2__
+	static_assert(sizeof(real_t) == sizeof(float), "SSE2 kernel requires real_t == float");
+
+	const __m128 width           = _mm_set1_ps(m_width);
+	const __m128 height          = _mm_set1_ps(m_height);
+	const __m128 invWidth        = _mm_set1_ps(m_invWidth);
+	const __m128 invHeight       = _mm_set1_ps(m_invHeight);
+	const __m128 halfWidth       = _mm_set1_ps(m_width / 2);
+	const __m128 halfHeight      = _mm_set1_ps(m_height / 2);
+	const __m128 minusHalfWidth  = _mm_set1_ps(-m_width / 2);
+	const __m128 minusHalfHeight = _mm_set1_ps(-m_height / 2);
+
+	for(; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(&x[i]);
+		__m128 vy = _mm_loadu_ps(&y[i]);
+
+		// v -= size * round(v / size)
+		vx = _mm_sub_ps(vx, _mm_mul_ps(width,  _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(vx, invWidth)))));
+		vy = _mm_sub_ps(vy, _mm_mul_ps(height, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(vy, invHeight)))));
+
+		// correct results just outside -size/2 .. +size/2
+		vx = _mm_sub_ps(vx, _mm_and_ps(_mm_cmpgt_ps(vx, halfWidth),  width));
+		vx = _mm_add_ps(vx, _mm_and_ps(_mm_cmplt_ps(vx, minusHalfWidth), width));
+		vy = _mm_sub_ps(vy, _mm_and_ps(_mm_cmpgt_ps(vy, halfHeight), height));
+		vy = _mm_add_ps(vy, _mm_and_ps(_mm_cmplt_ps(vy, minusHalfHeight), height));
+
+		_mm_storeu_ps(&x[i], vx);
+		_mm_storeu_ps(&y[i], vy);
+	}
+#endif
+
+	for(; i < n; i++) {
+		x[i] = unwrapRelative(x[i], m_width, m_invWidth);
+		y[i] = unwrapRelative(y[i], m_height, m_invHeight);
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "types.h"
+
+/*!
+ * \brief Coordinate arithmetic on the torus surface of the Field.
+ *
+ * \details
+ * The scalar functions are inline and free of loops: the number of field
+ * sizes to add or subtract is calculated by rounding the quotient, and a
+ * final comparison corrects the cases where the rounding of the quotient
+ * places the result just outside the target range. Their results are the
+ * same as those of repeatedly adding or subtracting the field size.
+ *
+ * unwrapRelative() is also available for arrays of coordinates (structure of
+ * arrays), vectorized using SSE2 where available.
+ */
+class Torus
+{
+	public:
+		Torus(real_t width, real_t height)
+			: m_width(width)
+			, m_height(height)
+			, m_invWidth(1 / width)
+			, m_invHeight(1 / height)
+		{
+		}
+
+		real_t getWidth(void) const { return m_width; }
+		real_t getHeight(void) const { return m_height; }
+
+		/*!
+		 * Wrap a coordinate into the range 0 to size (both inclusive).
+		 * Coordinates inside that range are returned unchanged.
+		 */
+		static real_t wrap(real_t v, real_t size, real_t invSize)
+		{
+			v -= size * roundToInt((v - size/2) * invSize);
+			v += (v < 0) ? size : 0;
+			v -= (v > size) ? size : 0;
+			return v;
+		}
+
+		/*!
+		 * Unwrap a relative coordinate (a difference of two coordinates) into
+		 * the range -size/2 to +size/2 (both inclusive). Coordinates inside
+		 * that range are returned unchanged.
+		 */
+		static real_t unwrapRelative(real_t v, real_t size, real_t invSize)
+		{
+			v -= size * roundToInt(v * invSize);
+			v -= (v > size/2) ? size : 0;
+			v += (v < -size/2) ? size : 0;
+			return v;
+		}
+
+		/*!
+		 * Move a coordinate by multiples of size such that it is at most
+		 * size/2 away from the reference coordinate. Coordinates that are
+		 * already close enough are returned unchanged.
+		 */
+		static real_t unwrap(real_t v, real_t ref, real_t size, real_t invSize)
+		{
+			v -= size * roundToInt((v - ref) * invSize);
+			v -= ((v - ref) > size/2) ? size : 0;
+			v += ((v - ref) < -size/2) ? size : 0;
+			return v;
+		}
+
+		/*!
+		 * Wrap the given position into the unique field area.
+		 */
+		Vector2D wrap(const Vector2D &v) const
+		{
+			return {wrap(v.x(), m_width, m_invWidth), wrap(v.y(), m_height, m_invHeight)};
+		}
+
+		/*!
+		 * Unwrap the given difference of two positions such that it is the
+		 * shortest one on the torus.
+		 */
+		Vector2D unwrapRelative(const Vector2D &v) const
+		{
+			return {unwrapRelative(v.x(), m_width, m_invWidth), unwrapRelative(v.y(), m_height, m_invHeight)};
+		}
+
+		/*!
+		 * Move the given position by multiples of the field size such that it
+		 * is at most half a field size away from the reference position.
+		 */
+		Vector2D unwrap(const Vector2D &v, const Vector2D &ref) const
+		{
+			return {unwrap(v.x(), ref.x(), m_width, m_invWidth), unwrap(v.y(), ref.y(), m_height, m_invHeight)};
+		}
+
+		/*!
+		 * unwrapRelative() for n relative positions, stored as separate
+		 * arrays of x and y coordinates. The arrays are modified in place.
+		 */
+		void unwrapRelative(real_t *x, real_t *y, std::size_t n) const;
+
+	private:
+		const real_t m_width;
+		const real_t m_height;
+		const real_t m_invWidth;
+		const real_t m_invHeight;
+
+		/*!
+		 * Round to the nearest integer, ties to even. The argument must be
+		 * within the range of int32_t.
+		 */
+		static real_t roundToInt(real_t v)
+		{
+#ifdef __SSE2__
+			return static_cast<real_t>(_mm_cvtss_si32(_mm_set_ss(v)));
+#else
+			return std::nearbyint(v);
+#endif
+		}
+};
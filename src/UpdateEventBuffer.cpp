@@ -0,0 +1,95 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "Bot.h"
+
+#include "UpdateEventBuffer.h"
+
+bool UpdateEventBuffer::OrderEntry::operator<(const OrderEntry &other) const
+{
+	if(key != other.key) {
+		return key < other.key;
+	}
+
+	if(worker != other.worker) {
+		return worker < other.worker;
+	}
+
+	return index < other.index;
+}
+
+void UpdateEventBuffer::begin(std::size_t workerCount)
+{
+	m_workers.resize(workerCount);
+
+	for(auto &worker: m_workers) {
+		worker.events.clear();
+		worker.food.clear();
+	}
+
+	m_order.clear();
+}
+
+void UpdateEventBuffer::botMoved(std::size_t worker, const std::shared_ptr<Bot> &bot, std::size_t steps)
+{
+	m_workers[worker].events.push_back({BOT_MOVED, bot->getSlot(), bot, steps});
+}
+
+void UpdateEventBuffer::foodConsumed(std::size_t worker, const Food &food, const std::shared_ptr<Bot> &by_bot)
+{
+	WorkerEvents &events = m_workers[worker];
+
+	events.events.push_back({FOOD_CONSUMED, by_bot->getSlot(), by_bot, events.food.size()});
+	events.food.push_back(food);
+}
+
+void UpdateEventBuffer::merge(void)
+{
+	m_order.clear();
+
+	for(std::size_t worker = 0; worker < m_workers.size(); worker++) {
+		const std::vector<Event> &events = m_workers[worker].events;
+
+		for(std::size_t i = 0; i < events.size(); i++) {
+			m_order.push_back({events[i].key, static_cast<uint32_t>(worker), static_cast<uint32_t>(i)});
+		}
+	}
+
+	std::sort(m_order.begin(), m_order.end());
+}
+
+void UpdateEventBuffer::replay(UpdateTracker &tracker) const
+{
+	for(auto &entry: m_order) {
+		const WorkerEvents &worker = m_workers[entry.worker];
+		const Event &event = worker.events[entry.index];
+
+		switch(event.type) {
+			case BOT_MOVED:
+				tracker.botMoved(event.bot, event.value);
+				break;
+
+			case FOOD_CONSUMED:
+				tracker.foodConsumed(worker.food[event.value], event.bot);
+				break;
+		}
+	}
+}
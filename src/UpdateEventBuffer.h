@@ -0,0 +1,93 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Food.h"
+#include "UpdateTracker.h"
+
+/*!
+ * \brief Events from parallel jobs, collected per worker and passed to
+ * UpdateTrackers later.
+ *
+ * \details
+ * Used by the UpdateTracker implementations that cannot process events
+ * concurrently: the *Parallel() functions store the events in the buffer of
+ * the calling worker, and replay() passes them to the serial functions of a
+ * tracker in the merged order (see UpdateTracker::endParallelEvents()).
+ *
+ * The buffers keep their capacity, so after a few frames no more allocations
+ * happen.
+ */
+class UpdateEventBuffer
+{
+	private:
+		enum EventType {
+			BOT_MOVED,
+			FOOD_CONSUMED
+		};
+
+		struct Event {
+			EventType            type;
+			uint32_t             key;
+			std::shared_ptr<Bot> bot;
+			std::size_t          value; //!< Steps for moves, index in WorkerEvents::food for consumption
+		};
+
+		struct WorkerEvents {
+			std::vector<Event> events;
+			std::vector<Food>  food;
+		};
+
+		struct OrderEntry {
+			uint32_t key;
+			uint32_t worker;
+			uint32_t index;
+
+			bool operator<(const OrderEntry &other) const;
+		};
+
+		std::vector<WorkerEvents> m_workers;
+		std::vector<OrderEntry> m_order;
+
+	public:
+		/*!
+		 * Remove all events and prepare the buffers for the given number of
+		 * workers.
+		 */
+		void begin(std::size_t workerCount);
+
+		void botMoved(std::size_t worker, const std::shared_ptr<Bot> &bot, std::size_t steps);
+		void foodConsumed(std::size_t worker, const Food &food, const std::shared_ptr<Bot> &by_bot);
+
+		/*!
+		 * Determine the merged order of all events. Call after the parallel
+		 * jobs are finished and before replay().
+		 */
+		void merge(void);
+
+		/*!
+		 * Pass all events to the given tracker in the merged order.
+		 */
+		void replay(UpdateTracker &tracker) const;
+};
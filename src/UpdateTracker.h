@@ -18,12 +18,16 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
+#include <string>
+#include <vector>
 
 // forward declarations
 class Food;
 class Bot;
 class Field;
+class WorldSnapshot;
 
 /*!
  * \brief Interface for a game state change tracker.
@@ -31,6 +35,31 @@ class Field;
 class UpdateTracker
 {
 	public:
+		/*!
+		 * Formats the events are serialized in. Each viewer receives one of
+		 * these streams.
+		 */
+		enum Stream {
+			STREAM_V1,           //!< Protocol version 1
+			STREAM_V2_MOVE,      //!< Protocol version 2 with full segment moves
+			STREAM_V2_MOVE_HEAD, //!< Protocol version 2 with head moves only
+
+			STREAM_COUNT
+		};
+
+		typedef std::shared_ptr<const std::string> Frame;
+		typedef std::array<Frame, STREAM_COUNT> FrameSet;
+
+		/*!
+		 * Log messages of all bots sharing one viewer key.
+		 */
+		struct LogFrame {
+			uint64_t viewerKey;
+			FrameSet frames;
+		};
+
+		typedef std::vector<LogFrame> LogFrameList;
+
 		virtual ~UpdateTracker() = default;
 
 		/*!
@@ -84,6 +113,15 @@ class UpdateTracker
 
 		virtual void botLogMessage(uint64_t viewerKey, const std::string& message) = 0;
 
+		/*!
+		 * Track a log message without creating a std::string first.
+		 *
+		 * \param viewerKey  Viewer key of the bot that sent the message.
+		 * \param message    Pointer to the message (not null-terminated).
+		 * \param length     Length of the message in bytes.
+		 */
+		virtual void botLogMessage(uint64_t viewerKey, const char *message, std::size_t length) = 0;
+
 		/*!
 		 * Add a serialized version of the world state to the stream.
 		 *
@@ -91,6 +129,15 @@ class UpdateTracker
 		 */
 		virtual void worldState(Field &field) = 0;
 
+		/*!
+		 * Add a serialized version of a previously captured world state to the
+		 * stream. The result is identical to worldState(Field&) at the time of
+		 * capture.
+		 *
+		 * \param snapshot   The captured world state.
+		 */
+		virtual void worldState(const WorldSnapshot &snapshot) = 0;
+
 		virtual void tick(uint64_t frame_num) = 0;
 
 		/*!
@@ -105,13 +152,60 @@ class UpdateTracker
 		 *
 		 * This also resets all internal state.
 		 *
-		 * \returns   A std::string containing the events in serialized form.
+		 * \returns   The events in serialized form, one buffer per Stream. The
+		 *            buffers are immutable and can be shared, e.g. by all viewer
+		 *            connections. Streams with identical content may share the
+		 *            same buffer.
 		 */
-		virtual std::string serialize(void) = 0;
+		virtual FrameSet serialize(void) = 0;
+
+		/*!
+		 * Log messages collected up to the last serialize() call, one entry
+		 * per viewer key. They are not part of the frames returned by
+		 * serialize(), as each viewer is only interested in its own bots.
+		 *
+		 * \returns   The log frames, valid until the next call to serialize().
+		 */
+		virtual const LogFrameList& getLogFrames(void) const = 0;
 
 		/*!
 		 * Reset the internal list of events. This is normally called once per
 		 * frame.
 		 */
 		virtual void reset(void) = 0;
+
+		/*!
+		 * Start tracking events from parallel jobs.
+		 *
+		 * Until endParallelEvents(), events may be tracked concurrently by the
+		 * *Parallel() functions, each worker thread passing its own index.
+		 * Every worker collects its events in separate buffers. No other
+		 * functions may be called in the meantime.
+		 *
+		 * \param workerCount   Number of worker threads.
+		 */
+		virtual void beginParallelEvents(std::size_t workerCount) = 0;
+
+		/*!
+		 * Parallel version of botMoved(). The bot must have been announced
+		 * by botSpawned() before. Ordered by the bot's slot.
+		 */
+		virtual void botMovedParallel(std::size_t worker,
+				const std::shared_ptr<Bot> &bot, std::size_t steps) = 0;
+
+		/*!
+		 * Parallel version of foodConsumed(). Ordered by the slot of the
+		 * consuming bot.
+		 */
+		virtual void foodConsumedParallel(std::size_t worker,
+				const Food &food, const std::shared_ptr<Bot> &by_bot) = 0;
+
+		/*!
+		 * Merge the events tracked since beginParallelEvents(), as if they
+		 * were tracked serially in the order of their keys. Events with the
+		 * same key keep the order they were tracked in. The result does not
+		 * depend on the thread timing, as long as all events with the same
+		 * key are tracked by the same worker.
+		 */
+		virtual void endParallelEvents(void) = 0;
 };
@@ -0,0 +1,1358 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <msgpack.hpp>
+
+#include "MsgPackProtocol.h"
+#include "MsgPackV2.h"
+#include "WebSocket.h"
+
+#include "ViewerServer.h"
+
+// maximum number of frames passed to one sendmsg() call
+static const std::size_t MAX_IOVECS = 64;
+
+// epoll event ids of the sockets that are not clients
+static const uint64_t LISTEN_EVENT_ID = 0;
+static const uint64_t WAKEUP_EVENT_ID = 1;
+static const uint64_t WEBSOCKET_LISTEN_EVENT_ID = 2;
+
+// maximum size of a WebSocket upgrade request
+static const std::size_t MAX_HANDSHAKE_SIZE = 8192;
+
+// maximum number of events handled per epoll_wait() call
+static const int MAX_EPOLL_EVENTS = 64;
+
+static MsgPackProtocol::MoveEncoding getMoveEncoding(UpdateTracker::Stream stream)
+{
+	return (stream == UpdateTracker::STREAM_V2_MOVE)
+		? MsgPackProtocol::MOVE_ENCODING_MOVE
+		: MsgPackProtocol::MOVE_ENCODING_MOVE_HEAD;
+}
+
+ViewerServer::ViewerServer()
+	: m_commands(config::VIEWER_COMMAND_QUEUE_SIZE)
+{
+}
+
+ViewerServer::~ViewerServer()
+{
+	if(m_thread.joinable()) {
+		m_shutdown = true;
+		wakeUp();
+
+		m_thread.join();
+	}
+
+	for(auto &entry: m_clients) {
+		close(entry.second.fd);
+	}
+
+	if(m_listenSocket != -1) {
+		close(m_listenSocket);
+	}
+
+	if(m_webSocketListenSocket != -1) {
+		close(m_webSocketListenSocket);
+	}
+
+	if(m_wakeupFd != -1) {
+		close(m_wakeupFd);
+	}
+
+	if(m_epoll != -1) {
+		close(m_epoll);
+	}
+}
+
+bool ViewerServer::listen(uint16_t port, uint16_t webSocketPort)
+{
+	m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if((m_epoll == -1) || (m_wakeupFd == -1)) {
+		std::cerr << "ViewerServer: cannot set up epoll: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLET;
+	event.data.u64 = WAKEUP_EVENT_ID;
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeupFd, &event);
+
+	m_listenSocket = openListenSocket(port, LISTEN_EVENT_ID);
+	if(m_listenSocket == -1) {
+		return false;
+	}
+
+	if(webSocketPort != 0) {
+		m_webSocketListenSocket = openListenSocket(webSocketPort, WEBSOCKET_LISTEN_EVENT_ID);
+		if(m_webSocketListenSocket == -1) {
+			return false;
+		}
+	}
+
+	m_thread = std::thread([this] () { run(); });
+
+	// remove this code if it does not compile on your system. It does not affect
+	// the program's functionality.
+	pthread_setname_np(m_thread.native_handle(), "viewer-io");
+
+	return true;
+}
+
+int ViewerServer::openListenSocket(uint16_t port, uint64_t eventId)
+{
+	// dual-stack socket: accepts IPv4 connections as well
+	int s = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(s == -1) {
+		std::cerr << "ViewerServer: socket() failed: " << strerror(errno) << std::endl;
+		return -1;
+	}
+
+	int one = 1;
+	int zero = 0;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+
+	struct sockaddr_in6 addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_addr = in6addr_any;
+	addr.sin6_port = htons(port);
+
+	if(bind(s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+		std::cerr << "ViewerServer: bind() to port " << port << " failed: " << strerror(errno) << std::endl;
+		close(s);
+		return -1;
+	}
+
+	if(::listen(s, SOMAXCONN) == -1) {
+		std::cerr << "ViewerServer: listen() failed: " << strerror(errno) << std::endl;
+		close(s);
+		return -1;
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLET;
+	event.data.u64 = eventId;
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, s, &event);
+
+	return s;
+}
+
+/* Game thread */
+
+void ViewerServer::broadcast(const FrameSet &frames)
+{
+	pushResync();
+
+	m_frameCount++;
+
+	Command command;
+	command.type = Command::FRAMES;
+	command.frames = frames;
+	command.framesPerUpdate = 1;
+
+	pushCommand(std::move(command));
+	wakeUp();
+}
+
+void ViewerServer::broadcastAggregated(const FrameSet &frames, std::size_t framesPerUpdate)
+{
+	Command command;
+	command.type = Command::FRAMES;
+	command.frames = frames;
+	command.framesPerUpdate = framesPerUpdate;
+
+	pushCommand(std::move(command));
+	wakeUp();
+}
+
+void ViewerServer::setKeyframe(const FrameSet &keyframe, uint64_t frameCount)
+{
+	Command command;
+	command.type = Command::KEYFRAME;
+	command.frames = keyframe;
+	command.frameCount = frameCount;
+
+	pushCommand(std::move(command));
+	wakeUp();
+}
+
+void ViewerServer::restart(const FrameSet &keyframe)
+{
+	m_frameCount = 0;
+
+	Command command;
+	command.type = Command::RESTART;
+	command.frames = keyframe;
+	command.frameCount = 0;
+
+	pushCommand(std::move(command));
+	wakeUp();
+}
+
+void ViewerServer::updateAreasOfInterest(Field &field)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_areaRequestMutex);
+		m_pendingAreaRequests.swap(m_areaRequests);
+	}
+
+	for(auto &request: m_pendingAreaRequests) {
+		applyAreaRequest(request);
+	}
+
+	m_pendingAreaRequests.clear();
+
+	for(auto &entry: m_areaClients) {
+		AreaClient &areaClient = entry.second;
+
+		// also in frames without an update, to keep the paths of the bots
+		areaClient.area.trackMoves();
+
+		if((m_frameCount % areaClient.framesPerUpdate) != 0) {
+			continue;
+		}
+
+		Command command;
+		command.type = Command::CLIENT_FRAME;
+		command.clientId = entry.first;
+		command.epoch = areaClient.epoch;
+		command.frame = areaClient.area.update(field, areaClient.moveEncoding);
+
+		pushCommand(std::move(command));
+	}
+
+	if(!m_areaClients.empty()) {
+		wakeUp();
+	}
+}
+
+void ViewerServer::sendLogFrames(const UpdateTracker::LogFrameList &logFrames, std::size_t framesPerUpdate)
+{
+	if(logFrames.empty()) {
+		return;
+	}
+
+	Command command;
+	command.type = Command::LOG_FRAMES;
+	command.framesPerUpdate = framesPerUpdate;
+	command.logFrames = std::make_shared<const UpdateTracker::LogFrameList>(logFrames);
+
+	pushCommand(std::move(command));
+	wakeUp();
+}
+
+void ViewerServer::pushCommand(Command &&command)
+{
+	if(!m_thread.joinable()) {
+		// not listening: nobody to send to
+		return;
+	}
+
+	if(m_commandsLost) {
+		// the streams are broken already, wait for pushResync()
+		m_lostCommandCount++;
+		return;
+	}
+
+	if(!m_commands.push(std::move(command))) {
+		std::cerr << "ViewerServer: command queue is full, dropping frames until the I/O thread catches up." << std::endl;
+
+		m_commandsLost = true;
+		m_lostCommandCount = 1;
+	}
+}
+
+void ViewerServer::pushResync(void)
+{
+	if(!m_commandsLost) {
+		return;
+	}
+
+	Command command;
+	command.type = Command::RESYNC;
+	command.frameCount = m_frameCount;
+
+	if(!m_commands.push(std::move(command))) {
+		m_lostCommandCount++; // still full, try again with the next frame
+		return;
+	}
+
+	std::cerr << "ViewerServer: dropped " << m_lostCommandCount << " commands, resyncing all clients." << std::endl;
+
+	m_commandsLost = false;
+	m_lostCommandCount = 0;
+}
+
+void ViewerServer::wakeUp(void)
+{
+	if(m_wakeupFd == -1) {
+		return;
+	}
+
+	uint64_t one = 1;
+	if(write(m_wakeupFd, &one, sizeof(one)) == -1) {
+		// EAGAIN: counter overflow, the I/O thread is woken up anyway
+	}
+}
+
+void ViewerServer::applyAreaRequest(const AreaRequest &request)
+{
+	if(request.type == AreaRequest::REMOVE) {
+		m_areaClients.erase(request.clientId);
+		return;
+	}
+
+	auto it = m_areaClients.find(request.clientId);
+	if(it == m_areaClients.end()) {
+		if(request.type == AreaRequest::RESET) {
+			return;
+		}
+
+		it = m_areaClients.emplace(request.clientId, AreaClient()).first;
+	}
+
+	AreaClient &areaClient = it->second;
+
+	if(areaClient.epoch != request.epoch) {
+		// the client dropped its backlog: start over with the initial state of the area
+		areaClient.area.reset();
+		areaClient.epoch = request.epoch;
+	}
+
+	areaClient.moveEncoding = request.moveEncoding;
+	areaClient.framesPerUpdate = request.framesPerUpdate;
+
+	switch(request.type) {
+		case AreaRequest::SUBSCRIBE_AREA:
+			areaClient.area.setArea(request.topLeft, request.size);
+			break;
+
+		case AreaRequest::SUBSCRIBE_BOT:
+			areaClient.area.setFollowedBot(request.botId, request.size);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* I/O thread */
+
+void ViewerServer::run(void)
+{
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+
+	while(!m_shutdown) {
+		int count = epoll_wait(m_epoll, events, MAX_EPOLL_EVENTS, -1);
+		if(count == -1) {
+			if(errno != EINTR) {
+				std::cerr << "ViewerServer: epoll_wait() failed: " << strerror(errno) << std::endl;
+			}
+			continue;
+		}
+
+		for(int i = 0; i < count; i++) {
+			uint64_t id = events[i].data.u64;
+
+			if(id == LISTEN_EVENT_ID) {
+				acceptClients(m_listenSocket, false);
+			} else if(id == WEBSOCKET_LISTEN_EVENT_ID) {
+				acceptClients(m_webSocketListenSocket, true);
+			} else if(id == WAKEUP_EVENT_ID) {
+				uint64_t value;
+				if(read(m_wakeupFd, &value, sizeof(value)) == -1) {
+					// EAGAIN: already reset
+				}
+			} else {
+				auto it = m_clients.find(static_cast<uint32_t>(id));
+				if(it == m_clients.end()) {
+					// closed while handling earlier events
+					continue;
+				}
+
+				if(!handleClientEvents(it->second, events[i].events)) {
+					closeClient(it->second);
+				}
+			}
+		}
+
+		processCommands();
+	}
+}
+
+void ViewerServer::processCommands(void)
+{
+	Command command;
+	bool hadCommands = false;
+
+	while(m_commands.pop(command)) {
+		hadCommands = true;
+
+		switch(command.type) {
+			case Command::FRAMES:
+				queueFrames(command.frames, command.framesPerUpdate);
+				break;
+
+			case Command::KEYFRAME:
+				if((m_ioFrameCount - command.frameCount) > m_recentFrames[0].size()) {
+					std::cerr << "ViewerServer: keyframe is outdated, ignoring it." << std::endl;
+				} else {
+					m_keyframe = BufferedFrames();
+					m_keyframe.frames = command.frames;
+					m_keyframeFrameCount = command.frameCount;
+
+					// relays pass it on to their joining viewers
+					Frame relayFrame;
+					for(auto &entry: m_clients) {
+						Client &client = entry.second;
+
+						if(!client.relay || client.resync) {
+							continue;
+						}
+
+						if(!relayFrame) {
+							relayFrame = encodeRelayFrame(MsgPackProtocol::RELAY_FRAME_KEYFRAME, 1,
+									m_keyframeFrameCount, m_keyframe.frames);
+						}
+
+						client.queue.push_back(relayFrame);
+					}
+				}
+				break;
+
+			case Command::RESTART:
+			case Command::RESYNC:
+				// for RESYNC, the frames in between were lost, so the buffered
+				// frames cannot be continued and there is no keyframe until the
+				// game sends the next one
+				m_ioFrameCount = command.frameCount;
+
+				for(auto &recentFrames: m_recentFrames) {
+					recentFrames.clear();
+				}
+
+				m_keyframe = BufferedFrames();
+				m_keyframe.frames = command.frames;
+				m_keyframeFrameCount = command.frameCount;
+
+				for(auto &entry: m_clients) {
+					Client &client = entry.second;
+
+					if(client.hasAreaOfInterest) {
+						resyncAreaOfInterest(client);
+					} else {
+						startResync(client);
+					}
+				}
+				break;
+
+			case Command::CLIENT_FRAME:
+				queueClientFrame(command);
+				break;
+
+			case Command::LOG_FRAMES:
+				queueLogFrames(*command.logFrames, command.framesPerUpdate);
+				break;
+		}
+	}
+
+	// release the last command's buffers
+	command = Command();
+
+	if(!hadCommands) {
+		return;
+	}
+
+	for(auto it = m_clients.begin(); it != m_clients.end();) {
+		Client &client = (it++)->second;
+
+		if(!serviceClient(client)) {
+			closeClient(client);
+		}
+	}
+}
+
+void ViewerServer::queueFrames(const FrameSet &frames, std::size_t framesPerUpdate)
+{
+	if(framesPerUpdate == 1) {
+		m_ioFrameCount++;
+	}
+
+	// buffer the same time span for all rates
+	std::deque<BufferedFrames> &recentFrames = m_recentFrames[framesPerUpdate - 1];
+
+	BufferedFrames buffered;
+	buffered.frames = frames;
+	buffered.frameCount = m_ioFrameCount;
+	buffered.framesPerUpdate = framesPerUpdate;
+
+	recentFrames.push_back(std::move(buffered));
+	if(recentFrames.size() > (config::VIEWER_MAX_BUFFERED_FRAMES + framesPerUpdate - 1) / framesPerUpdate) {
+		recentFrames.pop_front();
+	}
+
+	for(auto &entry: m_clients) {
+		Client &client = entry.second;
+
+		if((client.framesPerUpdate != framesPerUpdate) && !client.relay) {
+			continue;
+		}
+
+		if(client.resync || client.hasAreaOfInterest) {
+			// this client will get a keyframe or individual frames instead
+			continue;
+		}
+
+		if(isTooSlow(client)) {
+			std::cerr << "ViewerServer: " << client.peer << " is too slow, dropping "
+				<< client.queue.size() << " frames and resyncing." << std::endl;
+
+			startResync(client);
+			continue;
+		}
+
+		if(client.relay) {
+			client.queue.push_back(getRelayFrame(recentFrames.back()));
+		} else {
+			client.queue.push_back(getFrame(recentFrames.back(), client));
+		}
+	}
+}
+
+void ViewerServer::queueClientFrame(const Command &command)
+{
+	auto it = m_clients.find(command.clientId);
+	if(it == m_clients.end()) {
+		return;
+	}
+
+	Client &client = it->second;
+
+	if(!client.hasAreaOfInterest || (client.areaEpoch != command.epoch)) {
+		// built before the client changed or dropped its subscription
+		return;
+	}
+
+	if(isTooSlow(client)) {
+		std::cerr << "ViewerServer: " << client.peer << " is too slow, dropping "
+			<< client.queue.size() << " frames and resyncing." << std::endl;
+
+		resyncAreaOfInterest(client);
+		return;
+	}
+
+	client.queue.push_back(getFrame(command.frame, client));
+}
+
+void ViewerServer::queueLogFrames(const UpdateTracker::LogFrameList &logFrames, std::size_t framesPerUpdate)
+{
+	for(auto &logFrame: logFrames) {
+		auto it = m_logSubscribers.find(logFrame.viewerKey);
+		if(it == m_logSubscribers.end()) {
+			continue;
+		}
+
+		BufferedFrames buffered{logFrame.frames, FrameSet()};
+
+		for(Client *client: it->second) {
+			if(client->framesPerUpdate != framesPerUpdate) {
+				continue;
+			}
+
+			if(client->resync) {
+				// the frame these logs belong to was not sent either
+				continue;
+			}
+
+			client->queue.push_back(getFrame(buffered, *client));
+		}
+	}
+}
+
+void ViewerServer::acceptClients(int listenSocket, bool webSocket)
+{
+	while(true) {
+		struct sockaddr_in6 addr;
+		socklen_t addrLen = sizeof(addr);
+
+		int fd = accept4(listenSocket, reinterpret_cast<struct sockaddr*>(&addr), &addrLen,
+				SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd == -1) {
+			if((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				std::cerr << "ViewerServer: accept() failed: " << strerror(errno) << std::endl;
+			}
+			return;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		char addrString[INET6_ADDRSTRLEN] = "unknown";
+		inet_ntop(AF_INET6, &addr.sin6_addr, addrString, sizeof(addrString));
+
+		uint32_t id = m_nextClientId++;
+		if(m_nextClientId <= WEBSOCKET_LISTEN_EVENT_ID) {
+			m_nextClientId = WEBSOCKET_LISTEN_EVENT_ID + 1;
+		}
+
+		struct epoll_event event;
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.u64 = id;
+
+		if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+			std::cerr << "ViewerServer: cannot add client to epoll: " << strerror(errno) << std::endl;
+			close(fd);
+			continue;
+		}
+
+		Client &client = m_clients[id];
+		client.id = id;
+		client.fd = fd;
+		client.peer = std::string("[") + addrString + "]:" + std::to_string(ntohs(addr.sin6_port));
+		client.webSocket = webSocket;
+
+		m_clientCount = m_clients.size();
+
+		std::cerr << (webSocket ? "WebSocket connection" : "connection") << " established to " << client.peer << std::endl;
+	}
+}
+
+const ViewerServer::Frame& ViewerServer::getFrame(BufferedFrames &buffered, const Client &client)
+{
+	if(!client.compression) {
+		return buffered.frames[client.stream];
+	}
+
+	Frame &compressed = buffered.compressed[client.stream];
+	if(!compressed) {
+		compressed = m_compressor.compress(buffered.frames[client.stream]);
+	}
+
+	return compressed;
+}
+
+ViewerServer::Frame ViewerServer::getFrame(const Frame &frame, const Client &client)
+{
+	return client.compression ? m_compressor.compress(frame) : frame;
+}
+
+const ViewerServer::Frame& ViewerServer::getRelayFrame(BufferedFrames &buffered)
+{
+	if(!buffered.relay) {
+		buffered.relay = encodeRelayFrame(MsgPackProtocol::RELAY_FRAME_UPDATE, buffered.framesPerUpdate,
+				buffered.frameCount, buffered.frames);
+	}
+
+	return buffered.relay;
+}
+
+ViewerServer::Frame ViewerServer::encodeRelayFrame(MsgPackProtocol::RelayFrameKind kind, std::size_t framesPerUpdate,
+		uint64_t frameCount, const FrameSet &frames)
+{
+	MsgPackBuffer buffer;
+	buffer.data.append(sizeof(uint32_t), '\0');
+
+	msgpack::packer<MsgPackBuffer> packer(buffer);
+	packer.pack_array(6);
+	packer.pack(MsgPackProtocol::PROTOCOL_VERSION);
+	packer.pack(static_cast<int>(MsgPackProtocol::MESSAGE_TYPE_RELAY_FRAME));
+	packer.pack(static_cast<int>(kind));
+	packer.pack(static_cast<uint32_t>(framesPerUpdate));
+	packer.pack(frameCount);
+
+	packer.pack_array(frames.size());
+	for(auto &frame: frames) {
+		packer.pack_bin(frame->size());
+		packer.pack_bin_body(frame->data(), frame->size());
+	}
+
+	uint32_t length = htonl(static_cast<uint32_t>(buffer.data.size() - sizeof(uint32_t)));
+	memcpy(&buffer.data[0], &length, sizeof(length));
+
+	return std::make_shared<const std::string>(std::move(buffer.data));
+}
+
+bool ViewerServer::isTooSlow(const Client &client) const
+{
+	// a relay gets the updates of all rates
+	std::size_t limit = client.relay ? config::VIEWER_MAX_QUEUED_RELAY_FRAMES : config::VIEWER_MAX_QUEUED_FRAMES;
+
+	return client.queue.size() >= limit;
+}
+
+bool ViewerServer::handleClientEvents(Client &client, uint32_t events)
+{
+	if(events & (EPOLLERR | EPOLLHUP)) {
+		return false;
+	}
+
+	if(events & (EPOLLIN | EPOLLRDHUP)) {
+		if(!readIncoming(client)) {
+			return false;
+		}
+	}
+
+	if(events & EPOLLOUT) {
+		client.writable = true;
+	}
+
+	return serviceClient(client);
+}
+
+bool ViewerServer::serviceClient(Client &client)
+{
+	if(client.webSocket && !client.handshakeDone) {
+		return true;
+	}
+
+	if(client.resync && client.queue.empty() && !client.hasAreaOfInterest && queueKeyframe(client)) {
+		client.resync = false;
+	}
+
+	if(!client.writable || client.queue.empty()) {
+		return true;
+	}
+
+	return sendQueued(client);
+}
+
+bool ViewerServer::queueKeyframe(Client &client)
+{
+	if(client.relay) {
+		return queueRelayKeyframe(client);
+	}
+
+	if(!m_keyframe.frames[client.stream]) {
+		return false;
+	}
+
+	std::size_t deltaCount = m_ioFrameCount - m_keyframeFrameCount;
+	if(deltaCount > m_recentFrames[0].size()) {
+		// frames following the keyframe were already dropped
+		m_keyframe = BufferedFrames();
+		return false;
+	}
+
+	// updates at the client's rate since the keyframe
+	std::size_t rate = client.framesPerUpdate;
+	std::deque<BufferedFrames> &recentFrames = m_recentFrames[rate - 1];
+
+	std::size_t updateCount = m_ioFrameCount / rate - m_keyframeFrameCount / rate;
+	if(((m_keyframeFrameCount % rate) != 0) || (updateCount > recentFrames.size())) {
+		return false;
+	}
+
+	client.queue.push_back(getFrame(m_keyframe, client));
+
+	for(auto it = recentFrames.end() - updateCount; it != recentFrames.end(); it++) {
+		client.queue.push_back(getFrame(*it, client));
+	}
+
+	return true;
+}
+
+bool ViewerServer::queueRelayKeyframe(Client &client)
+{
+	if(!m_keyframe.frames[0]) {
+		return false;
+	}
+
+	std::size_t deltaCount = m_ioFrameCount - m_keyframeFrameCount;
+	if(deltaCount > m_recentFrames[0].size()) {
+		m_keyframe = BufferedFrames();
+		return false;
+	}
+
+	// first update of each rate following the keyframe
+	std::array<std::deque<BufferedFrames>::iterator, config::VIEWER_MAX_FRAMES_PER_UPDATE> next;
+
+	for(std::size_t rate = 1; rate <= config::VIEWER_MAX_FRAMES_PER_UPDATE; rate++) {
+		std::deque<BufferedFrames> &recentFrames = m_recentFrames[rate - 1];
+
+		std::size_t updateCount = m_ioFrameCount / rate - m_keyframeFrameCount / rate;
+		if(((m_keyframeFrameCount % rate) != 0) || (updateCount > recentFrames.size())) {
+			return false;
+		}
+
+		next[rate - 1] = recentFrames.end() - updateCount;
+	}
+
+	client.queue.push_back(encodeRelayFrame(MsgPackProtocol::RELAY_FRAME_RESYNC, 1,
+			m_keyframeFrameCount, m_keyframe.frames));
+
+	// the updates in the order they were broadcast
+	for(auto &it = next[0]; it != m_recentFrames[0].end(); it++) {
+		client.queue.push_back(getRelayFrame(*it));
+
+		for(std::size_t rate = 2; rate <= config::VIEWER_MAX_FRAMES_PER_UPDATE; rate++) {
+			auto &rateIt = next[rate - 1];
+
+			if((rateIt != m_recentFrames[rate - 1].end()) && (rateIt->frameCount == it->frameCount)) {
+				client.queue.push_back(getRelayFrame(*rateIt));
+				rateIt++;
+			}
+		}
+	}
+
+	return true;
+}
+
+void ViewerServer::dropBacklog(Client &client)
+{
+	// a partially sent frame must be completed to keep the stream intact
+	std::size_t keep = (client.offset > 0) ? 1 : 0;
+
+	// the dictionary is needed by the compressed frames queued afterwards
+	const FrameSet &dictionaryFrames = m_compressor.getDictionaryFrames();
+	bool dictionaryDropped = false;
+
+	if(client.compression && !client.relay) {
+		for(auto it = client.queue.begin() + keep; it != client.queue.end(); it++) {
+			if(std::find(dictionaryFrames.begin(), dictionaryFrames.end(), *it) != dictionaryFrames.end()) {
+				dictionaryDropped = true;
+			}
+		}
+	}
+
+	client.queue.erase(client.queue.begin() + keep, client.queue.end());
+
+	if(dictionaryDropped) {
+		client.queue.push_back(dictionaryFrames[client.stream]);
+	}
+}
+
+void ViewerServer::startResync(Client &client)
+{
+	dropBacklog(client);
+	client.resync = true;
+}
+
+void ViewerServer::resyncAreaOfInterest(Client &client)
+{
+	dropBacklog(client);
+	client.areaEpoch++;
+
+	AreaRequest request;
+	request.type = AreaRequest::RESET;
+	request.clientId = client.id;
+	request.epoch = client.areaEpoch;
+	request.framesPerUpdate = client.framesPerUpdate;
+	request.moveEncoding = getMoveEncoding(client.stream);
+
+	pushAreaRequest(request);
+}
+
+void ViewerServer::pushAreaRequest(const AreaRequest &request)
+{
+	std::lock_guard<std::mutex> guard(m_areaRequestMutex);
+	m_areaRequests.push_back(request);
+}
+
+bool ViewerServer::sendQueued(Client &client)
+{
+	while(!client.queue.empty()) {
+		struct iovec iov[MAX_IOVECS];
+		std::size_t count = 0;
+
+		// WebSocket frame headers, one per queued frame at most
+		uint8_t headers[MAX_IOVECS / 2][WebSocket::MAX_HEADER_SIZE];
+		std::size_t frameIndex = 0;
+
+		for(auto &frame: client.queue) {
+			if(count + 2 > MAX_IOVECS) {
+				break;
+			}
+
+			std::size_t offset = (frameIndex == 0) ? client.offset : 0;
+
+			if(client.webSocket) {
+				std::size_t headerLength = WebSocket::writeFrameHeader(headers[frameIndex], frame->size());
+
+				if(offset < headerLength) {
+					iov[count].iov_base = headers[frameIndex] + offset;
+					iov[count].iov_len = headerLength - offset;
+					count++;
+					offset = 0;
+				} else {
+					offset -= headerLength;
+				}
+			}
+
+			iov[count].iov_base = const_cast<char*>(frame->data() + offset);
+			iov[count].iov_len = frame->size() - offset;
+			count++;
+			frameIndex++;
+		}
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+
+		ssize_t sent = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(sent == -1) {
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				// wait for EPOLLOUT
+				client.writable = false;
+				return true;
+			}
+
+			std::cerr << "ViewerServer: send to " << client.peer << " failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+
+		// release completely sent frames
+		std::size_t remaining = sent;
+		while(remaining > 0) {
+			std::size_t frameRemaining = getWireSize(client, client.queue.front()) - client.offset;
+
+			if(remaining >= frameRemaining) {
+				remaining -= frameRemaining;
+				client.queue.pop_front();
+				client.offset = 0;
+			} else {
+				client.offset += remaining;
+				remaining = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+std::size_t ViewerServer::getWireSize(const Client &client, const Frame &frame)
+{
+	if(client.webSocket) {
+		return WebSocket::getHeaderLength(frame->size()) + frame->size();
+	}
+
+	return frame->size();
+}
+
+bool ViewerServer::decodeWebSocket(Client &client)
+{
+	if(!client.handshakeDone) {
+		std::size_t requestLength = WebSocket::getRequestLength(client.webSocketInbound);
+		if(requestLength == 0) {
+			if(client.webSocketInbound.size() > MAX_HANDSHAKE_SIZE) {
+				std::cerr << "ViewerServer: WebSocket handshake from " << client.peer << " is too long." << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+
+		std::string response;
+		if(!WebSocket::buildHandshakeResponse(client.webSocketInbound.substr(0, requestLength), response)) {
+			std::cerr << "ViewerServer: invalid WebSocket handshake from " << client.peer << std::endl;
+			return false;
+		}
+
+		// nothing else was sent yet, so the socket buffer takes the short response
+		if(send(client.fd, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT) != static_cast<ssize_t>(response.size())) {
+			std::cerr << "ViewerServer: cannot send WebSocket handshake to " << client.peer << std::endl;
+			return false;
+		}
+
+		client.webSocketInbound.erase(0, requestLength);
+		client.handshakeDone = true;
+	}
+
+	bool closed;
+	if(!WebSocket::decodeFrames(client.webSocketInbound, client.inbound, closed, config::VIEWER_MAX_MESSAGE_SIZE)) {
+		std::cerr << "ViewerServer: invalid WebSocket frame from " << client.peer << std::endl;
+		return false;
+	}
+
+	return !closed;
+}
+
+bool ViewerServer::readIncoming(Client &client)
+{
+	char buf[1024];
+
+	// edge-triggered: read until the socket is drained
+	while(true) {
+		ssize_t count = recv(client.fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if(count == 0) {
+			return false;
+		} else if(count == -1) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+		}
+
+		if(client.webSocket) {
+			client.webSocketInbound.append(buf, count);
+
+			if(!decodeWebSocket(client)) {
+				return false;
+			}
+		} else {
+			client.inbound.append(buf, count);
+		}
+
+		// messages are framed like the outgoing ones: 32 bit length, then MsgPack
+		std::size_t pos = 0;
+		while(client.inbound.size() - pos >= sizeof(uint32_t)) {
+			uint32_t length;
+			memcpy(&length, client.inbound.data() + pos, sizeof(length));
+			length = ntohl(length);
+
+			if(length > config::VIEWER_MAX_MESSAGE_SIZE) {
+				std::cerr << "ViewerServer: message from " << client.peer << " is too long (" << length << " bytes)." << std::endl;
+				return false;
+			}
+
+			if(client.inbound.size() - pos - sizeof(uint32_t) < length) {
+				break;
+			}
+
+			if(!handleMessage(client, client.inbound.data() + pos + sizeof(uint32_t), length)) {
+				return false;
+			}
+
+			pos += sizeof(uint32_t) + length;
+		}
+
+		client.inbound.erase(0, pos);
+	}
+}
+
+bool ViewerServer::handleMessage(Client &client, const char *data, std::size_t length)
+{
+	try {
+		msgpack::object_handle handle = msgpack::unpack(data, length);
+		const msgpack::object &message = handle.get();
+
+		if((message.type != msgpack::type::ARRAY) || (message.via.array.size < 1)) {
+			throw msgpack::type_error();
+		}
+
+		const msgpack::object *fields = message.via.array.ptr;
+		uint32_t fieldCount = message.via.array.size;
+
+		int messageType = fields[0].as<int>();
+
+		switch(messageType) {
+			case MsgPackProtocol::MESSAGE_TYPE_CLIENT_HELLO:
+				if(fieldCount < 3) {
+					throw msgpack::type_error();
+				}
+
+				handleHello(client, fields[1].as<int>(), fields[2].as<int>());
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_SUBSCRIBE_AREA:
+				if(fieldCount < 5) {
+					throw msgpack::type_error();
+				}
+
+				{
+					AreaRequest request;
+					request.type = AreaRequest::SUBSCRIBE_AREA;
+					request.topLeft = Vector2D(fields[1].as<real_t>(), fields[2].as<real_t>());
+					request.size = Vector2D(fields[3].as<real_t>(), fields[4].as<real_t>());
+
+					subscribe(client, request);
+				}
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_SUBSCRIBE_BOT:
+				if(fieldCount < 4) {
+					throw msgpack::type_error();
+				}
+
+				{
+					AreaRequest request;
+					request.type = AreaRequest::SUBSCRIBE_BOT;
+					request.botId = fields[1].as<uint32_t>();
+					request.size = Vector2D(fields[2].as<real_t>(), fields[3].as<real_t>());
+
+					subscribe(client, request);
+				}
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_UNSUBSCRIBE:
+				unsubscribe(client);
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_SET_RATE:
+				if(fieldCount < 2) {
+					throw msgpack::type_error();
+				}
+
+				setRate(client, fields[1].as<int>());
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_SET_COMPRESSION:
+				if(fieldCount < 2) {
+					throw msgpack::type_error();
+				}
+
+				setCompression(client, fields[1].as<int>());
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_RELAY_HELLO:
+				handleRelayHello(client);
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_SUBSCRIBE_LOG:
+				if(fieldCount < 2) {
+					throw msgpack::type_error();
+				}
+
+				subscribeLog(client, fields[1].as<uint64_t>());
+				break;
+
+			case MsgPackProtocol::MESSAGE_TYPE_UNSUBSCRIBE_LOG:
+				if(fieldCount < 2) {
+					throw msgpack::type_error();
+				}
+
+				unsubscribeLog(client, fields[1].as<uint64_t>());
+				break;
+
+			default:
+				std::cerr << "ViewerServer: ignoring message of unknown type " << messageType
+					<< " from " << client.peer << std::endl;
+				break;
+		}
+	} catch(std::exception &e) {
+		std::cerr << "ViewerServer: invalid message from " << client.peer << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void ViewerServer::handleHello(Client &client, int protocolVersion, int moveEncoding)
+{
+	UpdateTracker::Stream stream;
+
+	if(protocolVersion == MsgPackProtocol::PROTOCOL_VERSION) {
+		stream = UpdateTracker::STREAM_V1;
+	} else if((protocolVersion == MsgPackProtocol::PROTOCOL_VERSION_2)
+			&& (moveEncoding == MsgPackProtocol::MOVE_ENCODING_MOVE)) {
+		stream = UpdateTracker::STREAM_V2_MOVE;
+	} else if((protocolVersion == MsgPackProtocol::PROTOCOL_VERSION_2)
+			&& (moveEncoding == MsgPackProtocol::MOVE_ENCODING_MOVE_HEAD)) {
+		stream = UpdateTracker::STREAM_V2_MOVE_HEAD;
+	} else {
+		std::cerr << "ViewerServer: " << client.peer << " requested unsupported protocol version "
+			<< protocolVersion << " with move encoding " << moveEncoding << std::endl;
+		return;
+	}
+
+	std::cerr << "ViewerServer: " << client.peer << " selected protocol version "
+		<< protocolVersion << " with move encoding " << moveEncoding << std::endl;
+
+	client.stream = stream;
+
+	if(!client.hasAreaOfInterest) {
+		// the client starts over with a keyframe in the new format
+		startResync(client);
+	} else if(stream == UpdateTracker::STREAM_V1) {
+		unsubscribe(client);
+	} else {
+		resyncAreaOfInterest(client);
+	}
+}
+
+void ViewerServer::setRate(Client &client, int framesPerUpdate)
+{
+	if((framesPerUpdate < 1) || (static_cast<std::size_t>(framesPerUpdate) > config::VIEWER_MAX_FRAMES_PER_UPDATE)) {
+		std::cerr << "ViewerServer: " << client.peer << " requested unsupported rate of "
+			<< framesPerUpdate << " frames per update" << std::endl;
+		return;
+	}
+
+	if(client.framesPerUpdate == static_cast<std::size_t>(framesPerUpdate)) {
+		return;
+	}
+
+	std::cerr << "ViewerServer: " << client.peer << " selected " << framesPerUpdate << " frames per update" << std::endl;
+
+	client.framesPerUpdate = framesPerUpdate;
+
+	if(client.hasAreaOfInterest) {
+		resyncAreaOfInterest(client);
+	} else {
+		// the updates of the new rate start at a keyframe
+		startResync(client);
+	}
+}
+
+void ViewerServer::setCompression(Client &client, int compression)
+{
+	if((compression != MsgPackProtocol::COMPRESSION_NONE) && (compression != MsgPackProtocol::COMPRESSION_ZLIB)) {
+		std::cerr << "ViewerServer: " << client.peer << " requested unsupported compression " << compression << std::endl;
+		return;
+	}
+
+	bool enable = (compression == MsgPackProtocol::COMPRESSION_ZLIB);
+	if(enable && !client.compression && !client.relay) {
+		// queued before any compressed frame, which needs the dictionary
+		// (relays get uncompressed RelayFrames only)
+		client.queue.push_back(m_compressor.getDictionaryFrames()[client.stream]);
+	}
+
+	// already queued frames are sent as they are; the client tells them apart
+	// by the flag in the length prefix
+	client.compression = enable;
+}
+
+void ViewerServer::handleRelayHello(Client &client)
+{
+	if(client.relay) {
+		return;
+	}
+
+	std::cerr << "ViewerServer: " << client.peer << " registered as relay" << std::endl;
+
+	// relays only get the shared streams
+	if(client.hasAreaOfInterest) {
+		unsubscribe(client);
+	}
+
+	client.relay = true;
+	startResync(client);
+}
+
+void ViewerServer::subscribe(Client &client, AreaRequest request)
+{
+	if(client.relay) {
+		return;
+	}
+
+	if(client.stream == UpdateTracker::STREAM_V1) {
+		std::cerr << "ViewerServer: " << client.peer << " cannot subscribe to an area with protocol version 1." << std::endl;
+		return;
+	}
+
+	if(!client.hasAreaOfInterest) {
+		// replace the shared stream by individual frames
+		dropBacklog(client);
+		client.hasAreaOfInterest = true;
+		client.resync = false;
+		client.areaEpoch++;
+	}
+
+	request.clientId = client.id;
+	request.epoch = client.areaEpoch;
+	request.framesPerUpdate = client.framesPerUpdate;
+	request.moveEncoding = getMoveEncoding(client.stream);
+
+	pushAreaRequest(request);
+}
+
+void ViewerServer::unsubscribe(Client &client)
+{
+	if(!client.hasAreaOfInterest) {
+		return;
+	}
+
+	AreaRequest request;
+	request.type = AreaRequest::REMOVE;
+	request.clientId = client.id;
+	pushAreaRequest(request);
+
+	// back to the shared stream, starting with a keyframe
+	client.hasAreaOfInterest = false;
+	client.areaEpoch++;
+	startResync(client);
+}
+
+void ViewerServer::subscribeLog(Client &client, uint64_t viewerKey)
+{
+	if(std::find(client.viewerKeys.begin(), client.viewerKeys.end(), viewerKey) != client.viewerKeys.end()) {
+		return;
+	}
+
+	if(client.viewerKeys.size() >= config::VIEWER_MAX_LOG_SUBSCRIPTIONS) {
+		std::cerr << "ViewerServer: " << client.peer << " subscribed to too many bot logs, ignoring another one." << std::endl;
+		return;
+	}
+
+	client.viewerKeys.push_back(viewerKey);
+	m_logSubscribers[viewerKey].push_back(&client);
+}
+
+void ViewerServer::unsubscribeLog(Client &client, uint64_t viewerKey)
+{
+	auto keyIt = std::find(client.viewerKeys.begin(), client.viewerKeys.end(), viewerKey);
+	if(keyIt == client.viewerKeys.end()) {
+		return;
+	}
+
+	client.viewerKeys.erase(keyIt);
+
+	std::vector<Client*> &subscribers = m_logSubscribers[viewerKey];
+	subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), &client), subscribers.end());
+
+	if(subscribers.empty()) {
+		m_logSubscribers.erase(viewerKey);
+	}
+}
+
+void ViewerServer::closeClient(Client &client)
+{
+	std::cerr << "connection to " << client.peer << " closed." << std::endl;
+
+	// copy: unsubscribeLog() modifies the list
+	std::vector<uint64_t> viewerKeys = client.viewerKeys;
+	for(uint64_t viewerKey: viewerKeys) {
+		unsubscribeLog(client, viewerKey);
+	}
+
+	if(client.hasAreaOfInterest) {
+		AreaRequest request;
+		request.type = AreaRequest::REMOVE;
+		request.clientId = client.id;
+		pushAreaRequest(request);
+	}
+
+	// also removes it from the epoll set
+	close(client.fd);
+
+	m_clients.erase(client.id);
+	m_clientCount = m_clients.size();
+}
@@ -0,0 +1,486 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+
+#include "AreaOfInterest.h"
+#include "FrameCompressor.h"
+#include "SpscQueue.h"
+#include "UpdateTracker.h"
+
+class Field;
+
+/*!
+ * \brief TCP server distributing the update stream to the viewers.
+ *
+ * \details
+ * All socket handling runs in a dedicated I/O thread with an edge-triggered
+ * epoll loop, so viewer connections do not add to the frame time. The public
+ * methods are called by the game thread. They hand the frames over to the I/O
+ * thread through a lock-free SpscQueue and wake it up with an eventfd. The game
+ * thread never waits for the I/O thread: if the queue is full, the frames are
+ * dropped until there is room again, and then all clients resync.
+ *
+ * Every frame is serialized once into an immutable, reference-counted buffer.
+ * broadcast() only queues a reference to that buffer for each client, and the
+ * queued frames are sent with one sendmsg() call per client.
+ *
+ * The per-client queue is bounded by config::VIEWER_MAX_QUEUED_FRAMES. A client
+ * that falls further behind is switched to the resync state: its backlog is
+ * dropped and, as soon as its socket has caught up, it is sent the latest
+ * keyframe (the full world state) followed by the regular updates. New clients
+ * start in the resync state, too.
+ *
+ * Keyframes are not built on demand. The game supplies one periodically using
+ * setKeyframe(), and the server keeps the frames broadcast since then (at most
+ * config::VIEWER_MAX_BUFFERED_FRAMES). A resyncing client gets the keyframe
+ * followed by these frames.
+ *
+ * Frames and keyframes are provided in all UpdateTracker::Stream formats.
+ * Each client receives the stream it selected with a ClientHello message
+ * (protocol version 1 by default). Selecting a stream triggers a resync.
+ *
+ * Clients using protocol version 2 may subscribe to an AreaOfInterest. They
+ * do not receive the shared frames, but individual ones built by
+ * updateAreasOfInterest(). As this needs access to the Field, the areas are
+ * owned by the game thread. The I/O thread forwards subscription changes as
+ * AreaRequests and tags them with an epoch, so frames built for an outdated
+ * subscription can be recognized and dropped.
+ *
+ * Clients may select a lower update rate (frames per update). Updates for
+ * these rates are merged from several frames by MultiRateUpdateTracker and
+ * distributed with broadcastAggregated(), sharing one buffer per rate.
+ *
+ * Bot log messages are only sent to clients that subscribed to the bot's
+ * viewer key, see sendLogFrames().
+ *
+ * Browser viewers can connect through an optional WebSocket listener. After
+ * the handshake, WebSocket clients behave like TCP clients: each queued frame
+ * buffer is sent unchanged as the payload of one binary WebSocket frame (the
+ * header is passed as a separate iovec), and the payloads of their messages
+ * form the same length-prefixed stream a TCP client sends.
+ *
+ * Clients may request compressed frames. Compression runs in the I/O thread,
+ * lazily and once per frame and stream, so all compressed clients share the
+ * compressed buffers as well.
+ *
+ * A relay (see RelayServer) registers with a RelayHello message. It receives
+ * the frames of all streams and rates wrapped in RelayFrame messages, plus
+ * every keyframe, and feeds them to its own ViewerServer. Relays use the same
+ * backlog limit and resync logic as viewers; a resync starts with a keyframe
+ * marked accordingly, after which the relay restarts its stream with
+ * restart().
+ */
+class ViewerServer
+{
+	public:
+		typedef UpdateTracker::Frame Frame;
+		typedef UpdateTracker::FrameSet FrameSet;
+
+		ViewerServer();
+		~ViewerServer();
+
+		/*!
+		 * \brief Open the listening sockets and start the I/O thread.
+		 *
+		 * \param port           Port for raw TCP connections.
+		 * \param webSocketPort  Port for WebSocket connections, 0 to disable.
+		 *
+		 * \returns  Whether the sockets could be set up.
+		 */
+		bool listen(uint16_t port, uint16_t webSocketPort = 0);
+
+		/*!
+		 * \brief Queue a frame for all connected clients using the full rate.
+		 */
+		void broadcast(const FrameSet &frames);
+
+		/*!
+		 * \brief Queue an update merged from several frames for all clients
+		 * using the given rate.
+		 *
+		 * Must be called after broadcast() whenever getFrameCount() is a
+		 * multiple of framesPerUpdate.
+		 *
+		 * \param framesPerUpdate  2 to config::VIEWER_MAX_FRAMES_PER_UPDATE.
+		 */
+		void broadcastAggregated(const FrameSet &frames, std::size_t framesPerUpdate);
+
+		/*!
+		 * \brief Number of frames broadcast so far.
+		 */
+		uint64_t getFrameCount(void) const { return m_frameCount; }
+
+		/*!
+		 * \brief Set the keyframe for new and resyncing clients.
+		 *
+		 * \param keyframe    The serialized world state.
+		 * \param frameCount  Value of getFrameCount() when the world state was
+		 *                    captured, a multiple of config::VIEWER_RATE_ALIGNMENT.
+		 *                    The keyframe is ignored if the frames since then are
+		 *                    no longer buffered.
+		 */
+		void setKeyframe(const FrameSet &keyframe, uint64_t frameCount);
+
+		/*!
+		 * \brief Start the stream over with the given keyframe.
+		 *
+		 * All buffered frames are dropped, getFrameCount() is reset to 0 and
+		 * every client resyncs with the keyframe. Used by relays whose
+		 * upstream stream was interrupted.
+		 */
+		void restart(const FrameSet &keyframe);
+
+		/*!
+		 * \brief Queue individual frames for clients with an area of interest.
+		 *
+		 * Must be called once per frame after all updates to the Field.
+		 */
+		void updateAreasOfInterest(Field &field);
+
+		/*!
+		 * \brief Queue the log frames for the clients subscribed to their
+		 * viewer keys.
+		 *
+		 * Must be called after the frames of the same update were queued.
+		 *
+		 * \param framesPerUpdate  Rate of the clients to send the frames to.
+		 */
+		void sendLogFrames(const UpdateTracker::LogFrameList &logFrames, std::size_t framesPerUpdate);
+
+		std::size_t getClientCount(void) const { return m_clientCount; }
+
+		/*!
+		 * \brief Statistics of the frame compression, for all clients.
+		 */
+		FrameCompressor::Stats getCompressionStats(void) const { return m_compressor.getStats(); }
+
+	private:
+		/*!
+		 * Data passed from the game thread to the I/O thread.
+		 */
+		struct Command {
+			enum Type {
+				FRAMES,       //!< frames for all clients of a rate
+				KEYFRAME,     //!< new keyframe
+				CLIENT_FRAME, //!< frame of one client's area of interest
+				LOG_FRAMES,   //!< log frames for the subscribers of a rate
+				RESTART,      //!< drop everything, start over with the keyframe
+				RESYNC,       //!< commands were lost, resync all clients
+			};
+
+			Type        type = FRAMES;
+			FrameSet    frames;
+			std::size_t framesPerUpdate = 1;
+			uint64_t    frameCount = 0;
+			uint32_t    clientId = 0;
+			uint32_t    epoch = 0;
+			Frame       frame;
+
+			std::shared_ptr<const UpdateTracker::LogFrameList> logFrames;
+		};
+
+		/*!
+		 * Area of interest changes passed from the I/O thread to the game
+		 * thread.
+		 */
+		struct AreaRequest {
+			enum Type {
+				SUBSCRIBE_AREA, //!< set a fixed rectangle
+				SUBSCRIBE_BOT,  //!< follow a bot
+				RESET,          //!< start over with the full area (new epoch)
+				REMOVE,         //!< unsubscribed or disconnected
+			};
+
+			Type        type = RESET;
+			uint32_t    clientId = 0;
+			uint32_t    epoch = 0;
+			Vector2D    topLeft{0, 0};
+			Vector2D    size{0, 0};
+			uint32_t    botId = 0;
+			std::size_t framesPerUpdate = 1;
+
+			MsgPackProtocol::MoveEncoding moveEncoding = MsgPackProtocol::MOVE_ENCODING_MOVE;
+		};
+
+		/*!
+		 * A frame in all formats, with the compressed versions and the relay
+		 * message created on demand.
+		 */
+		struct BufferedFrames {
+			FrameSet    frames;
+			FrameSet    compressed;
+			uint64_t    frameCount = 0;
+			std::size_t framesPerUpdate = 1;
+			Frame       relay;
+		};
+
+		struct Client {
+			uint32_t          id;
+			int               fd;
+			std::string       peer;
+			std::deque<Frame> queue;
+			std::size_t       offset = 0;       //!< Bytes of queue.front() already sent
+			bool              resync = true;    //!< Client needs a keyframe before further updates
+			bool              writable = true;  //!< Socket did not report EAGAIN since the last EPOLLOUT
+			std::string       inbound;          //!< Incomplete incoming message
+
+			bool              webSocket = false;
+			bool              handshakeDone = false;
+			std::string       webSocketInbound; //!< Undecoded WebSocket data or handshake request
+
+			UpdateTracker::Stream stream = UpdateTracker::STREAM_V1;
+			std::size_t framesPerUpdate = 1;
+			bool        compression = false;
+			bool        relay = false;          //!< Gets all streams and rates as RelayFrames
+
+			bool              hasAreaOfInterest = false;
+			uint32_t          areaEpoch = 0;    //!< Frames of other epochs are outdated
+
+			std::vector<uint64_t> viewerKeys; //!< Subscribed bot logs
+		};
+
+		/*!
+		 * Area of interest of a client, owned by the game thread.
+		 */
+		struct AreaClient {
+			AreaOfInterest area;
+			uint32_t       epoch = 0;
+			std::size_t    framesPerUpdate = 1;
+
+			MsgPackProtocol::MoveEncoding moveEncoding = MsgPackProtocol::MOVE_ENCODING_MOVE;
+		};
+
+		// shared
+		SpscQueue<Command>       m_commands;
+		std::mutex               m_areaRequestMutex;
+		std::vector<AreaRequest> m_areaRequests;
+		std::atomic<std::size_t> m_clientCount{0};
+		std::atomic<bool>        m_shutdown{false};
+		std::thread              m_thread;
+
+		int m_listenSocket = -1;
+		int m_webSocketListenSocket = -1;
+		int m_epoll = -1;
+		int m_wakeupFd = -1;
+
+		// game thread
+		uint64_t m_frameCount = 0;
+		bool m_commandsLost = false;         //!< Commands were dropped since the last RESYNC
+		std::size_t m_lostCommandCount = 0;
+		std::vector<AreaRequest> m_pendingAreaRequests;
+		std::unordered_map<uint32_t, AreaClient> m_areaClients;
+
+		// I/O thread
+		std::unordered_map<uint32_t, Client> m_clients;
+		uint32_t m_nextClientId = 3; //!< 0 to 2 identify the listen sockets and the eventfd
+
+		uint64_t          m_ioFrameCount = 0;
+
+		//! The last broadcast frames by rate, index is framesPerUpdate - 1
+		std::array<std::deque<BufferedFrames>, config::VIEWER_MAX_FRAMES_PER_UPDATE> m_recentFrames;
+
+		BufferedFrames    m_keyframe;
+		uint64_t          m_keyframeFrameCount = 0;
+
+		//! Clients subscribed to the logs of each viewer key
+		std::unordered_map<uint64_t, std::vector<Client*>> m_logSubscribers;
+
+		FrameCompressor m_compressor;
+
+		/* game thread */
+
+		/*!
+		 * Pass a command to the I/O thread. If the queue is full, the command
+		 * is dropped, and so are all following ones until pushResync()
+		 * succeeds.
+		 */
+		void pushCommand(Command &&command);
+
+		/*!
+		 * If commands were dropped, let the I/O thread resync all clients.
+		 * Called at the start of every frame by broadcast().
+		 */
+		void pushResync(void);
+
+		/*!
+		 * Wake up the I/O thread to process the queued commands.
+		 */
+		void wakeUp(void);
+
+		void applyAreaRequest(const AreaRequest &request);
+
+		/* I/O thread */
+
+		void run(void);
+
+		void processCommands(void);
+
+		/*!
+		 * Queue a frame for all clients using the shared stream at the given
+		 * rate.
+		 */
+		void queueFrames(const FrameSet &frames, std::size_t framesPerUpdate);
+
+		void queueClientFrame(const Command &command);
+
+		void queueLogFrames(const UpdateTracker::LogFrameList &logFrames, std::size_t framesPerUpdate);
+
+		/*!
+		 * Open a non-blocking listening socket and add it to epoll.
+		 *
+		 * \returns  The socket, or -1 on error.
+		 */
+		int openListenSocket(uint16_t port, uint64_t eventId);
+
+		void acceptClients(int listenSocket, bool webSocket);
+
+		/*!
+		 * Get the frame in the format of the given client, compressing it if
+		 * necessary.
+		 */
+		const Frame& getFrame(BufferedFrames &buffered, const Client &client);
+		Frame getFrame(const Frame &frame, const Client &client);
+
+		/*!
+		 * Get the RelayFrame message of a buffered update.
+		 */
+		const Frame& getRelayFrame(BufferedFrames &buffered);
+
+		static Frame encodeRelayFrame(MsgPackProtocol::RelayFrameKind kind, std::size_t framesPerUpdate,
+				uint64_t frameCount, const FrameSet &frames);
+
+		/*!
+		 * Check whether the client's backlog exceeds the limit. Such a client
+		 * is resynced.
+		 */
+		bool isTooSlow(const Client &client) const;
+
+		/*!
+		 * Total bytes sent for a frame, including the WebSocket header.
+		 */
+		static std::size_t getWireSize(const Client &client, const Frame &frame);
+
+		/*!
+		 * Handle the WebSocket handshake and decode incoming WebSocket frames.
+		 * The decoded payload is appended to client.inbound.
+		 *
+		 * \returns  false if the connection must be closed.
+		 */
+		bool decodeWebSocket(Client &client);
+
+		/*!
+		 * Handle epoll events of a client.
+		 *
+		 * \returns  false if the connection failed or was closed.
+		 */
+		bool handleClientEvents(Client &client, uint32_t events);
+
+		/*!
+		 * Start a pending resync and send as much queued data as possible.
+		 *
+		 * \returns  false if the connection failed.
+		 */
+		bool serviceClient(Client &client);
+
+		/*!
+		 * Queue the keyframe and the frames since then for a resyncing client.
+		 *
+		 * \returns  false if no usable keyframe is available yet.
+		 */
+		bool queueKeyframe(Client &client);
+
+		/*!
+		 * Queue the keyframe and the updates of all rates since then for a
+		 * resyncing relay.
+		 *
+		 * \returns  false if no usable keyframe is available yet.
+		 */
+		bool queueRelayKeyframe(Client &client);
+
+		/*!
+		 * Send as much queued data as the socket accepts.
+		 *
+		 * \returns  false if the connection failed.
+		 */
+		bool sendQueued(Client &client);
+
+		/*!
+		 * Drop the client's backlog, keeping a partially sent frame.
+		 */
+		void dropBacklog(Client &client);
+
+		/*!
+		 * Drop the client's backlog and send it a keyframe as soon as possible.
+		 */
+		void startResync(Client &client);
+
+		/*!
+		 * Drop the client's backlog and let the game thread start over with
+		 * the full area of interest.
+		 */
+		void resyncAreaOfInterest(Client &client);
+
+		void pushAreaRequest(const AreaRequest &request);
+
+		/*!
+		 * Read incoming data and handle complete messages.
+		 *
+		 * \returns  false if the connection was closed or the client sent
+		 *           invalid data.
+		 */
+		bool readIncoming(Client &client);
+
+		/*!
+		 * Handle one message from a client.
+		 *
+		 * \returns  false if the message was invalid.
+		 */
+		bool handleMessage(Client &client, const char *data, std::size_t length);
+
+		void handleHello(Client &client, int protocolVersion, int moveEncoding);
+		void setRate(Client &client, int framesPerUpdate);
+		void setCompression(Client &client, int compression);
+		void handleRelayHello(Client &client);
+
+		/*!
+		 * Switch the client to individual frames of an area of interest, if
+		 * its protocol supports it, and pass the request to the game thread.
+		 */
+		void subscribe(Client &client, AreaRequest request);
+		void unsubscribe(Client &client);
+
+		void subscribeLog(Client &client, uint64_t viewerKey);
+		void unsubscribeLog(Client &client, uint64_t viewerKey);
+
+		void closeClient(Client &client);
+};
@@ -0,0 +1,315 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <array>
+#include <cctype>
+#include <cstring>
+
+#include <strings.h>
+
+#include "WebSocket.h"
+
+// magic value from RFC 6455, section 1.3
+static const char *HANDSHAKE_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static const uint8_t OPCODE_CONTINUATION = 0x0;
+static const uint8_t OPCODE_TEXT = 0x1;
+static const uint8_t OPCODE_BINARY = 0x2;
+static const uint8_t OPCODE_CLOSE = 0x8;
+
+static const uint8_t FLAG_FIN = 0x80;
+static const uint8_t FLAG_MASK = 0x80;
+
+static uint32_t rotateLeft(uint32_t value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+/*!
+ * SHA-1 as required by the handshake. Not used for anything security related.
+ */
+static std::array<uint8_t, 20> sha1(const std::string &message)
+{
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+	std::string data = message;
+	uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+
+	data.push_back(static_cast<char>(0x80));
+	while((data.size() % 64) != 56) {
+		data.push_back('\0');
+	}
+
+	for(int i = 7; i >= 0; i--) {
+		data.push_back(static_cast<char>((bitLength >> (i * 8)) & 0xFF));
+	}
+
+	for(std::size_t chunk = 0; chunk < data.size(); chunk += 64) {
+		uint32_t w[80];
+
+		for(int i = 0; i < 16; i++) {
+			const uint8_t *p = reinterpret_cast<const uint8_t*>(&data[chunk + i * 4]);
+			w[i] = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+		}
+
+		for(int i = 16; i < 80; i++) {
+			w[i] = rotateLeft(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+		}
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+		for(int i = 0; i < 80; i++) {
+			uint32_t f, k;
+
+			if(i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			} else if(i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			} else if(i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			} else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+
+			uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rotateLeft(b, 30);
+			b = a;
+			a = temp;
+		}
+
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	std::array<uint8_t, 20> digest;
+	for(int i = 0; i < 20; i++) {
+		digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+	}
+
+	return digest;
+}
+
+static std::string base64(const uint8_t *data, std::size_t length)
+{
+	static const char *ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string result;
+
+	for(std::size_t i = 0; i < length; i += 3) {
+		uint32_t value = data[i] << 16;
+		if(i + 1 < length) { value |= data[i+1] << 8; }
+		if(i + 2 < length) { value |= data[i+2]; }
+
+		result.push_back(ALPHABET[(value >> 18) & 0x3F]);
+		result.push_back(ALPHABET[(value >> 12) & 0x3F]);
+		result.push_back((i + 1 < length) ? ALPHABET[(value >> 6) & 0x3F] : '=');
+		result.push_back((i + 2 < length) ? ALPHABET[value & 0x3F] : '=');
+	}
+
+	return result;
+}
+
+/*!
+ * Find a header field (case insensitive name) and return its trimmed value.
+ */
+static bool findHeader(const std::string &request, const char *name, std::string &value)
+{
+	std::size_t nameLength = strlen(name);
+	std::size_t pos = request.find("\r\n");
+
+	while(pos != std::string::npos) {
+		std::size_t lineStart = pos + 2;
+		std::size_t lineEnd = request.find("\r\n", lineStart);
+		if(lineEnd == std::string::npos) {
+			break;
+		}
+
+		if((lineEnd - lineStart > nameLength) && (request[lineStart + nameLength] == ':')
+				&& (strncasecmp(&request[lineStart], name, nameLength) == 0)) {
+			std::size_t valueStart = lineStart + nameLength + 1;
+			while((valueStart < lineEnd) && isspace(static_cast<unsigned char>(request[valueStart]))) {
+				valueStart++;
+			}
+
+			std::size_t valueEnd = lineEnd;
+			while((valueEnd > valueStart) && isspace(static_cast<unsigned char>(request[valueEnd - 1]))) {
+				valueEnd--;
+			}
+
+			value = request.substr(valueStart, valueEnd - valueStart);
+			return true;
+		}
+
+		pos = lineEnd;
+	}
+
+	return false;
+}
+
+namespace WebSocket
+{
+
+std::size_t getRequestLength(const std::string &data)
+{
+	std::size_t end = data.find("\r\n\r\n");
+	return (end == std::string::npos) ? 0 : (end + 4);
+}
+
+bool buildHandshakeResponse(const std::string &request, std::string &response)
+{
+	std::string key;
+	std::string version;
+
+	if((request.compare(0, 4, "GET ") != 0)
+			|| !findHeader(request, "Sec-WebSocket-Key", key)
+			|| !findHeader(request, "Sec-WebSocket-Version", version)
+			|| (version != "13")) {
+		return false;
+	}
+
+	std::array<uint8_t, 20> digest = sha1(key + HANDSHAKE_GUID);
+
+	response =
+		"HTTP/1.1 101 Switching Protocols\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Accept: " + base64(digest.data(), digest.size()) + "\r\n"
+		"\r\n";
+
+	return true;
+}
+
+std::size_t getHeaderLength(std::size_t payloadLength)
+{
+	if(payloadLength < 126) {
+		return 2;
+	} else if(payloadLength <= 0xFFFF) {
+		return 4;
+	} else {
+		return 10;
+	}
+}
+
+std::size_t writeFrameHeader(uint8_t *out, std::size_t payloadLength)
+{
+	out[0] = FLAG_FIN | OPCODE_BINARY;
+
+	std::size_t length = getHeaderLength(payloadLength);
+
+	if(length == 2) {
+		out[1] = static_cast<uint8_t>(payloadLength);
+	} else if(length == 4) {
+		out[1] = 126;
+		out[2] = static_cast<uint8_t>(payloadLength >> 8);
+		out[3] = static_cast<uint8_t>(payloadLength);
+	} else {
+		out[1] = 127;
+		for(int i = 0; i < 8; i++) {
+			out[2 + i] = static_cast<uint8_t>(static_cast<uint64_t>(payloadLength) >> (56 - i * 8));
+		}
+	}
+
+	return length;
+}
+
+bool decodeFrames(std::string &data, std::string &payload, bool &closed, std::size_t maxSize)
+{
+	std::size_t pos = 0;
+	closed = false;
+
+	while(data.size() - pos >= 2) {
+		const uint8_t *header = reinterpret_cast<const uint8_t*>(data.data() + pos);
+
+		uint8_t opcode = header[0] & 0x0F;
+
+		// client frames must be masked
+		if(!(header[1] & FLAG_MASK)) {
+			return false;
+		}
+
+		uint64_t length = header[1] & 0x7F;
+		std::size_t headerLength = 2;
+
+		if(length == 126) {
+			headerLength = 4;
+		} else if(length == 127) {
+			headerLength = 10;
+		}
+
+		headerLength += 4; // masking key
+
+		if(data.size() - pos < headerLength) {
+			break;
+		}
+
+		if(length == 126) {
+			length = (header[2] << 8) | header[3];
+		} else if(length == 127) {
+			length = 0;
+			for(int i = 0; i < 8; i++) {
+				length = (length << 8) | header[2 + i];
+			}
+		}
+
+		if(length > maxSize) {
+			return false;
+		}
+
+		if(data.size() - pos - headerLength < length) {
+			break;
+		}
+
+		const uint8_t *mask = header + headerLength - 4;
+		const char *body = data.data() + pos + headerLength;
+
+		switch(opcode) {
+			case OPCODE_CONTINUATION:
+			case OPCODE_TEXT:
+			case OPCODE_BINARY:
+				for(std::size_t i = 0; i < length; i++) {
+					payload.push_back(static_cast<char>(body[i] ^ mask[i % 4]));
+				}
+				break;
+
+			case OPCODE_CLOSE:
+				closed = true;
+				break;
+
+			default:
+				// ping and pong: browsers do not send pings, so no pong is needed
+				break;
+		}
+
+		pos += headerLength + length;
+	}
+
+	data.erase(0, pos);
+	return true;
+}
+
+}
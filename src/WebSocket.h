@@ -0,0 +1,80 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*!
+ * \brief Minimal server side WebSocket (RFC 6455) support for the viewers.
+ *
+ * \details
+ * Only what the viewer stream needs is implemented: the opening handshake,
+ * unfragmented binary frames from the server and decoding of (possibly
+ * fragmented) masked frames from the client. No extensions are negotiated,
+ * so permessage-deflate is never used.
+ */
+namespace WebSocket
+{
+	//! Maximum size of a server frame header
+	static constexpr const std::size_t MAX_HEADER_SIZE = 10;
+
+	/*!
+	 * Check whether a complete HTTP upgrade request was received.
+	 *
+	 * \returns  Length of the request including the terminating empty line,
+	 *           or 0 if it is incomplete.
+	 */
+	std::size_t getRequestLength(const std::string &data);
+
+	/*!
+	 * Build the response to an upgrade request.
+	 *
+	 * \returns  false if the request is not a valid WebSocket upgrade.
+	 */
+	bool buildHandshakeResponse(const std::string &request, std::string &response);
+
+	/*!
+	 * Write the header of an unfragmented binary frame.
+	 *
+	 * \param out  Buffer of at least MAX_HEADER_SIZE bytes.
+	 *
+	 * \returns  Length of the header.
+	 */
+	std::size_t writeFrameHeader(uint8_t *out, std::size_t payloadLength);
+
+	/*!
+	 * Length of the header written by writeFrameHeader().
+	 */
+	std::size_t getHeaderLength(std::size_t payloadLength);
+
+	/*!
+	 * Decode complete client frames at the start of data. The unmasked
+	 * payloads of data frames are appended to payload, control frames are
+	 * handled (pings are ignored) and the decoded bytes are removed from data.
+	 *
+	 * \param closed   Set if the client sent a close frame.
+	 * \param maxSize  Maximum accepted payload size of a single frame.
+	 *
+	 * \returns  false if the data violates the protocol.
+	 */
+	bool decodeFrames(std::string &data, std::string &payload, bool &closed, std::size_t maxSize);
+}
@@ -0,0 +1,54 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Field.h"
+
+#include "WorldSnapshot.h"
+
+void WorldSnapshot::capture(Field &field)
+{
+	const Field::BotSet &bots = field.getBots();
+
+	// entries are overwritten in place to keep the allocated strings and vectors
+	m_bots.resize(bots.size());
+
+	std::size_t i = 0;
+	for(auto &bot: bots) {
+		BotEntry &entry = m_bots[i++];
+		std::shared_ptr<Snake> snake = bot->getSnake();
+
+		entry.guid              = bot->getGUID();
+		entry.info              = bot->getPackedInfo();
+		entry.mass              = snake->getMass();
+		entry.segmentRadius     = snake->getSegmentRadius();
+
+		entry.segments.clear();
+		for(auto &segment: snake->getSegments()) {
+			entry.segments.push_back(segment.pos());
+		}
+	}
+
+	Field::FoodMap &foodMap = field.getFoodMap();
+
+	m_food.clear();
+	m_food.reserve(foodMap.size());
+
+	for(auto &food: foodMap) {
+		m_food.push_back({food.getGUID(), food.pos().x(), food.pos().y(), food.getValue()});
+	}
+}
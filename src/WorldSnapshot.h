@@ -0,0 +1,66 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+class Field;
+
+/*!
+ * \brief Plain copy of the world state visible to viewers.
+ *
+ * \details
+ * The snapshot is captured on the game thread and can then be serialized on
+ * another thread while the game continues. capture() reuses the memory of the
+ * previous snapshot.
+ */
+class WorldSnapshot
+{
+	public:
+		struct BotEntry {
+			guid_t                guid;
+			std::string           info; //!< Copy of Bot::getPackedInfo()
+			real_t                mass;
+			real_t                segmentRadius;
+			std::vector<Vector2D> segments;
+		};
+
+		struct FoodEntry {
+			guid_t guid;
+			real_t x;
+			real_t y;
+			real_t value;
+		};
+
+		/*!
+		 * Copy the current state of the given Field.
+		 */
+		void capture(Field &field);
+
+		const std::vector<BotEntry>& getBots(void) const { return m_bots; }
+		const std::vector<FoodEntry>& getFood(void) const { return m_food; }
+
+	private:
+		std::vector<BotEntry>  m_bots;
+		std::vector<FoodEntry> m_food;
+};
@@ -27,6 +27,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 #include "types.h"
 
@@ -93,6 +94,19 @@ namespace config {
 	// mass to be successful.
 	static const real_t     KILLER_MIN_MASS_RATIO   = 0.001;
 
+	// Collision model. By default, the head of a Snake is tested against every
+	// segment of the other Snakes. With COLLISION_USE_CAPSULES, it is tested
+	// against capsules between every n-th segment instead, where n is chosen
+	// such that a capsule is about COLLISION_CAPSULE_LENGTH_FACTOR times the
+	// segment radius long. This fills the gaps between the segments and cuts
+	// curves: in the tightest possible turn, the capsules deviate from the
+	// segments by less than 10% of the segment radius. The capsules are built
+	// from the positions after the move, while the exact model uses the
+	// segment map of the previous frame. Define DEBUG_COLLISION_MODEL to print
+	// the differences to the exact model.
+	static const bool       COLLISION_USE_CAPSULES          = false;
+	static const real_t     COLLISION_CAPSULE_LENGTH_FACTOR = 1.0;
+
 	// Lua memory pool configuration
 	static const std::size_t LUA_MEM_POOL_SIZE_BYTES       = 25 * 1024*1024;
 	static const std::size_t LUA_MEM_POOL_BLOCK_SIZE_BYTES = 256;
@@ -109,6 +123,14 @@ namespace config {
 	// bot IPC directory location
 	static constexpr const char *BOT_IPC_DIRECTORY = "/mnt/spn_shm/";
 
+	// Bot shared memory: number of released regions kept mapped for respawning
+	// bots and the number of entries of each list that are prefaulted on
+	// startup. Entries beyond that are faulted in on first use.
+	static constexpr const size_t BOT_SHM_POOL_SIZE = 256;
+	static constexpr const size_t BOT_SHM_PREFAULT_FOOD_COUNT = 4096;
+	static constexpr const size_t BOT_SHM_PREFAULT_BOT_COUNT = 64;
+	static constexpr const size_t BOT_SHM_PREFAULT_SEGMENT_COUNT = 4096;
+
 	// script for launching new bots
 	static constexpr const char *BOT_LAUNCHER_SCRIPT = "docker4bots/2_run_spn_bot.sh";
 
@@ -123,4 +145,57 @@ namespace config {
 	// Thread pool size
 	static constexpr const size_t NTHREADS_BOT_THREAD_POOL = 4; // Main worker thread pool
 	static constexpr const size_t NTHREADS_BOT_STARTUP = 4; // Bot startup parallelism
+	static constexpr const size_t NTHREADS_FRAME_TASKS = 2; // Helpers running independent frame phases, see FrameTaskGraph
+
+	// Viewer connections: maximum number of frames queued per client. Clients
+	// falling further behind drop their backlog and get a fresh keyframe.
+	static constexpr const size_t VIEWER_MAX_QUEUED_FRAMES = 120;
+
+	// The same limit for relays, which get the updates of all rates
+	static constexpr const size_t VIEWER_MAX_QUEUED_RELAY_FRAMES = 4 * VIEWER_MAX_QUEUED_FRAMES;
+
+	// Viewer keyframes are built every VIEWER_KEYFRAME_INTERVAL frames. New
+	// clients get the latest keyframe and the frames since then, of which at
+	// most VIEWER_MAX_BUFFERED_FRAMES are kept.
+	static constexpr const size_t VIEWER_KEYFRAME_INTERVAL = 30;
+	static constexpr const size_t VIEWER_MAX_BUFFERED_FRAMES = 3 * VIEWER_KEYFRAME_INTERVAL;
+
+	// Port for browser viewers connecting via WebSocket (0 disables it). Raw
+	// TCP viewers use port 9010.
+	static constexpr const uint16_t VIEWER_WEBSOCKET_PORT = 9011;
+
+	// zlib compression level for viewers that requested compressed frames.
+	// Compression runs in the viewer I/O thread, so favour speed.
+	static constexpr const int VIEWER_COMPRESSION_LEVEL = 1;
+
+	// Capacity of the queue passing frames to the viewer I/O thread
+	static constexpr const size_t VIEWER_COMMAND_QUEUE_SIZE = 1024;
+
+	// Maximum size of a message sent by a viewer
+	static constexpr const size_t VIEWER_MAX_MESSAGE_SIZE = 4096;
+
+	// Viewers may select a lower update rate: one update every 1 to
+	// VIEWER_MAX_FRAMES_PER_UPDATE frames, with the events of these frames
+	// merged. Keyframes are only captured every VIEWER_RATE_ALIGNMENT frames
+	// (a multiple of all possible rates), so they fit every rate.
+	static constexpr const size_t VIEWER_MAX_FRAMES_PER_UPDATE = 4;
+	static constexpr const size_t VIEWER_RATE_ALIGNMENT = 12;
+
+	// Maximum number of viewer keys a viewer can subscribe to for bot logs
+	static constexpr const size_t VIEWER_MAX_LOG_SUBSCRIPTIONS = 16;
+
+	// Game recording: a keyframe is recorded every RECORDER_KEYFRAME_INTERVAL
+	// frames (the seek granularity of replays), and a new segment file is
+	// started every RECORDER_SEGMENT_FRAMES frames.
+	static constexpr const uint64_t RECORDER_KEYFRAME_INTERVAL = 600;
+	static constexpr const uint64_t RECORDER_SEGMENT_FRAMES = 18000;
+
+	// Capacity of the queue passing frames to the recorder's writer thread
+	static constexpr const size_t RECORDER_QUEUE_SIZE = 1024;
+
+	// Relay mode: seconds between attempts to (re)connect to the upstream
+	// server, and the maximum size of a message from it (keyframes in all
+	// stream formats).
+	static constexpr const double RELAY_RECONNECT_INTERVAL = 1.0;
+	static constexpr const size_t RELAY_MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
 }
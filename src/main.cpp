@@ -21,16 +21,28 @@
 #include <signal.h>
 
 #include "config.h"
+#include "Environment.h"
 #include "Game.h"
+#include "RelayServer.h"
+#include "ReplayServer.h"
 
 Game game;
+ReplayServer *replayServer = nullptr; //!< Only set in replay mode
+RelayServer *relayServer = nullptr;   //!< Only set in relay mode
 
 /*!
  * Signal handler for terminating signals such as SIGINT, SIGTERM, etc.
  */
 void sig_shutdown_handler(int sig)
 {
-	game.Shutdown();
+	if(replayServer) {
+		replayServer->Shutdown();
+	} else if(relayServer) {
+		relayServer->Shutdown();
+	} else {
+		game.Shutdown();
+	}
+
 	std::cerr << "Shutdown initiated on signal " << sig << std::endl;
 	std::cerr << "Send the same signal again to terminate immediately." << std::endl;
 
@@ -71,8 +83,55 @@ bool test_shm_writability(void)
 	return testfile.is_open() && testfile.good();
 }
 
+/*!
+ * Serve a recorded game to the viewers instead of running the game.
+ */
+int replay(const std::string &directory)
+{
+	double speed = strtod(Environment::GetDefault(Environment::ENV_REPLAY_SPEED, Environment::ENV_REPLAY_SPEED_DEFAULT), NULL);
+	uint64_t startFrame = strtoull(Environment::GetDefault(Environment::ENV_REPLAY_START_FRAME, Environment::ENV_REPLAY_START_FRAME_DEFAULT), NULL, 10);
+
+	ReplayServer server(directory, speed, startFrame);
+	replayServer = &server;
+
+	if(!setup_signal_handlers()) {
+		return 1;
+	}
+
+	return server.Main();
+}
+
+/*!
+ * Rebroadcast the viewer stream of another server instead of running the game.
+ */
+int relay(const std::string &upstreamHost)
+{
+	uint16_t upstreamPort = atoi(Environment::GetDefault(Environment::ENV_RELAY_UPSTREAM_PORT, Environment::ENV_RELAY_UPSTREAM_PORT_DEFAULT));
+	uint16_t port = atoi(Environment::GetDefault(Environment::ENV_RELAY_PORT, Environment::ENV_RELAY_PORT_DEFAULT));
+	uint16_t webSocketPort = atoi(Environment::GetDefault(Environment::ENV_RELAY_WEBSOCKET_PORT, Environment::ENV_RELAY_WEBSOCKET_PORT_DEFAULT));
+
+	RelayServer server(upstreamHost, upstreamPort, port, webSocketPort);
+	relayServer = &server;
+
+	if(!setup_signal_handlers()) {
+		return 1;
+	}
+
+	return server.Main();
+}
+
 int main(void)
 {
+	std::string replayDirectory = Environment::GetDefault(Environment::ENV_REPLAY_DIRECTORY, Environment::ENV_REPLAY_DIRECTORY_DEFAULT);
+	if(!replayDirectory.empty()) {
+		return replay(replayDirectory);
+	}
+
+	std::string relayUpstreamHost = Environment::GetDefault(Environment::ENV_RELAY_UPSTREAM_HOST, Environment::ENV_RELAY_UPSTREAM_HOST_DEFAULT);
+	if(!relayUpstreamHost.empty()) {
+		return relay(relayUpstreamHost);
+	}
+
 	if(!test_shm_writability()) {
 		std::cerr << "Cannot write to shared memory located at " << config::BOT_IPC_DIRECTORY << " !" << std::endl;
 		return 1;
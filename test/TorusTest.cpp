@@ -0,0 +1,176 @@
+/*
+ * Schlangenprogrammiernacht: A programming game for GPN18.
+ * Copyright (C) 2018  bytewerk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Compares the loop-free Torus functions with the loop based implementations
+ * they replaced, at the edges of the target ranges, their float neighbours
+ * and random values, and the SSE2 batch version of unwrapRelative() with the
+ * scalar one.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "config.h"
+#include "Torus.h"
+
+namespace {
+
+real_t oldWrap(real_t v, real_t size)
+{
+	while(v < 0) {
+		v += size;
+	}
+
+	while(v > size) {
+		v -= size;
+	}
+
+	return v;
+}
+
+real_t oldUnwrapRelative(real_t v, real_t size)
+{
+	v = std::fmod(v, size);
+
+	if(v > size/2) {
+		v -= size;
+	}
+
+	if(v < (-static_cast<int>(size)/2)) {
+		v += size;
+	}
+
+	return v;
+}
+
+real_t oldUnwrap(real_t v, real_t ref, real_t size)
+{
+	while((v - ref) < -size/2) {
+		v += size;
+	}
+
+	while((v - ref) > size/2) {
+		v -= size;
+	}
+
+	return v;
+}
+
+/*!
+ * 0, ±size/2 and size, each with its float neighbours.
+ */
+std::vector<real_t> edgeValues(real_t size)
+{
+	std::vector<real_t> result;
+
+	for(real_t v: {real_t(0), size/2, -size/2, size}) {
+		result.push_back(std::nextafter(v, -INFINITY));
+		result.push_back(v);
+		result.push_back(std::nextafter(v, INFINITY));
+	}
+
+	return result;
+}
+
+/*!
+ * The edge values followed by random values between -size and 2*size.
+ */
+std::vector<real_t> testValues(real_t size, std::size_t randomCount)
+{
+	std::vector<real_t> result = edgeValues(size);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<real_t> dist(-size, 2 * size);
+
+	for(std::size_t i = 0; i < randomCount; i++) {
+		result.push_back(dist(random));
+	}
+
+	return result;
+}
+
+int failures = 0;
+
+void check(const char *what, real_t size, real_t v, real_t ref, real_t expected, real_t actual)
+{
+	// exact comparison, but -0 and +0 are the same coordinate
+	if(expected != actual) {
+		std::cerr.precision(9);
+		std::cerr << what << "(" << v << ", ref " << ref << ", size " << size
+			<< "): expected " << expected << ", got " << actual << std::endl;
+		failures++;
+	}
+}
+
+void testScalar(real_t size)
+{
+	const real_t invSize = 1 / size;
+	const std::vector<real_t> edges = edgeValues(size);
+
+	for(real_t v: testValues(size, 100000)) {
+		check("wrap", size, v, 0, oldWrap(v, size), Torus::wrap(v, size, invSize));
+		check("unwrapRelative", size, v, 0, oldUnwrapRelative(v, size), Torus::unwrapRelative(v, size, invSize));
+	}
+
+	for(real_t ref: edges) {
+		for(real_t d: testValues(size, 1000)) {
+			real_t v = ref + d;
+			check("unwrap", size, v, ref, oldUnwrap(v, ref, size), Torus::unwrap(v, ref, size, invSize));
+		}
+	}
+}
+
+void testBatch(const Torus &torus)
+{
+	// the odd count also covers the scalar tail of the vectorized loop
+	std::vector<real_t> x = testValues(torus.getWidth(), 1001);
+	std::vector<real_t> y = testValues(torus.getHeight(), 1001);
+
+	std::vector<real_t> batchX = x;
+	std::vector<real_t> batchY = y;
+	torus.unwrapRelative(batchX.data(), batchY.data(), batchX.size());
+
+	for(std::size_t i = 0; i < x.size(); i++) {
+		Vector2D expected = torus.unwrapRelative(Vector2D(x[i], y[i]));
+
+		check("batch unwrapRelative x", torus.getWidth(), x[i], 0, expected.x(), batchX[i]);
+		check("batch unwrapRelative y", torus.getHeight(), y[i], 0, expected.y(), batchY[i]);
+	}
+}
+
+}
+
+int main(void)
+{
+	testScalar(config::FIELD_SIZE_X);
+	testScalar(config::FIELD_SIZE_Y);
+	testBatch(Torus(config::FIELD_SIZE_X, config::FIELD_SIZE_Y));
+
+	if(failures > 0) {
+		std::cerr << failures << " checks failed." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cerr << "All checks passed." << std::endl;
+	return EXIT_SUCCESS;
+}